@@ -0,0 +1,24 @@
+#!/bin/sh
+# gentree.sh - Makes a source tree of 10,000 small files in nested
+# directories for testing directory lookups: dirN/subN/fileN with ten
+# directories, ten subdirectories in each and a hundred files in each of
+# those. Every file has the same contents, so "mkrofs -d" stores one block.
+#
+# usage: gentree.sh <output dir>
+
+set -e
+
+out=${1:?usage: gentree.sh <output dir>}
+rm -rf "$out"
+
+for d in 0 1 2 3 4 5 6 7 8 9; do
+    for s in 0 1 2 3 4 5 6 7 8 9; do
+        dir="$out/dir$d/sub$s"
+        mkdir -p "$dir"
+        f=0
+        while [ $f -lt 100 ]; do
+            echo "rofs directory test file" > "$dir/file$f"
+            f=$((f + 1))
+        done
+    done
+done
@@ -0,0 +1,1106 @@
+/* mkrofs.c - Builds read only file system images from a flat directory
+ *
+ * Version 1 images use the original layout: a boot block, one 4KB inode
+ * per file holding a list of block numbers, then the data blocks.
+ *
+ * Version 2 images keep the same boot block but fill its reserved words
+ * with a versioned superblock, pack 32 inodes into each block and describe
+ * file data with extents. Every file is laid out contiguously, so each one
+ * normally needs a single extent.
+ *
+ * With -z, version 2 files are LZ4 compressed a block at a time whenever
+ * that makes them take fewer blocks. The stored data is a table of
+ * num_blocks + 1 offsets followed by the blocks, each compressed on its
+ * own so the kernel can decompress any one of them independently.
+ *
+ * A source tree with subdirectories, or with more files than the boot
+ * block directory holds, is written as a version 2 image with directory
+ * inodes. Each directory's data is a small header, a power of two number
+ * of hash buckets and an array of entries chained per bucket, so lookups
+ * stay short no matter how many files a directory has. The root is
+ * inode 0 and every directory starts with "." and "..".
+ *
+ * With -d, identical data blocks are stored once and shared by every
+ * inode that holds them. Version 1 block lists can point anywhere; a
+ * version 2 file with more extents than fit in its inode spills the rest
+ * into extent blocks after its data.
+ *
+ * With -c, a version 2 image carries a CRC32C of every data block in a
+ * table between the inodes and the data, which the kernel checks the
+ * first time it reads each block.
+ */
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define BLOCK_SIZE          4096
+#define FILE_NAME_LENGTH    32
+#define MAX_DIR_ENTRIES     63
+#define INODE_BLOCK_NUMS    1023
+#define INLINE_EXTENTS      14
+
+#define ROFS_MAGIC          0x32534F52  /* "ROS2" */
+#define ROFS_VERSION_1      1
+#define ROFS_VERSION_2      2
+
+#define ROFS_COMPRESSED     0x1
+#define ROFS_DIRECTORIES    0x2
+#define ROFS_CHECKSUMS      0x4
+#define INODE_COMPRESSED    0x1
+#define INODE_DIRECTORY     0x2
+#define INODE_INDIRECT      0x4
+
+#define DIR_END             0xFFFFFFFF
+
+#define LZ4_MIN_MATCH       4
+#define LZ4_HASH_BITS       12
+#define LZ4_MAX_OFFSET      65535
+#define LZ4_LAST_LITERALS   5       /* The block must end in literals */
+#define LZ4_MATCH_LIMIT     12      /* No match may start this close to the end */
+
+#define DEDUP_HASH_BITS     12
+
+#define CRC32C_POLY         0x82F63B78
+
+#define TYPE_RTC            0
+#define TYPE_DIR            1
+#define TYPE_FILE           2
+
+typedef struct dentry {
+    char file_name[FILE_NAME_LENGTH];
+    uint32_t file_type;
+    uint32_t inode_num;
+    uint8_t reserved[24];
+} dentry_t;
+
+typedef struct boot_block {
+    uint32_t num_dir_entries;
+    uint32_t num_inodes;
+    uint32_t num_data_blocks;
+    uint32_t magic;
+    uint32_t version;
+    uint32_t inode_blocks;
+    uint32_t flags;
+    uint32_t root_inode;
+    uint32_t checksum_blocks;
+    uint8_t reserved[28];
+    dentry_t dentries[MAX_DIR_ENTRIES];
+} boot_block_t;
+
+typedef struct dir_header {
+    uint32_t num_entries;
+    uint32_t num_buckets;
+} dir_header_t;
+
+typedef struct dir_entry {
+    char file_name[FILE_NAME_LENGTH];
+    uint32_t file_type;
+    uint32_t inode_num;
+    uint32_t next;
+    uint8_t reserved[20];
+} dir_entry_t;
+
+typedef struct inode {
+    uint32_t length;
+    uint32_t data_block_num[INODE_BLOCK_NUMS];
+} inode_t;
+
+typedef struct extent {
+    uint32_t start;
+    uint32_t length;
+} extent_t;
+
+typedef struct inode2 {
+    uint32_t length;
+    uint32_t flags;
+    uint32_t num_extents;
+    uint32_t reserved;
+    extent_t extents[INLINE_EXTENTS];
+} inode2_t;
+
+#define INODES_PER_BLOCK    (BLOCK_SIZE / sizeof(inode2_t))
+
+/* A file or directory picked up from the source tree */
+typedef struct source_file {
+    char name[FILE_NAME_LENGTH + 1];
+    int is_dir;
+    int parent;             /* Containing directory, -1 for the root */
+    int *children;          /* Directories only, in name order */
+    int num_children;
+    uint8_t *data;          /* Directory inode data for directories */
+    uint32_t length;
+    uint8_t *stored;        /* What goes in the image, data unless compressed */
+    uint32_t stored_length;
+    int compressed;
+    uint32_t num_blocks;
+    uint32_t *block_map;    /* Data region block holding each stored block */
+    uint32_t extent_block;  /* First block of spilled extents, version 2 only */
+    uint32_t extent_blocks; /* 0 when every extent fits in the inode */
+} source_file_t;
+
+/* A data block already placed in the image, for -d */
+typedef struct unique_block {
+    const uint8_t *data;
+    uint32_t length;        /* Bytes used, the rest of the block is zero */
+    uint32_t block;
+    struct unique_block *next;
+} unique_block_t;
+
+static source_file_t *files;
+static int num_files;
+static int max_files;
+static int directories;     /* Whether the image needs directory inodes */
+
+static unique_block_t *unique_blocks[1 << DEDUP_HASH_BITS];
+
+/*
+ * usage(prog)
+ *
+ * DESCRIPTION: Prints the command line help and exits
+ *
+ * INPUTS: prog - name the tool was run as
+ * OUTPUTS: none
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "usage: %s [-1 | -2] [-z] [-d] [-c] [-o image] <source dir>\n"
+        "  -1        write a version 1 image (block lists)\n"
+        "  -2        write a version 2 image (extents, default)\n"
+        "  -z        LZ4 compress files when it saves blocks (version 2)\n"
+        "  -d        store identical data blocks once\n"
+        "  -c        add a CRC32C of every data block (version 2)\n"
+        "  -o image  output file, default filesys_img\n",
+        prog);
+    exit(1);
+}
+
+/*
+ * read_whole_file(path, length)
+ *
+ * DESCRIPTION: Reads a host file into memory
+ *
+ * INPUTS: path - file to read
+ * OUTPUTS: length - size of the file
+ *
+ * RETURNS: malloc'd contents, or NULL on error
+ */
+static uint8_t *read_whole_file(const char *path, uint32_t *length)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    /* Keep at least one byte so empty files still get a buffer */
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    if (data == NULL || fread(data, 1, size, fp) != (size_t)size) {
+        free(data);
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+    *length = (uint32_t)size;
+    return data;
+}
+
+/*
+ * compare_names(a, b)
+ *
+ * DESCRIPTION: qsort comparator for directory listings, so images are
+ *              reproducible
+ */
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/*
+ * add_node(name, parent, is_dir)
+ *
+ * DESCRIPTION: Appends a file or directory to files; its inode number is
+ *              its index
+ *
+ * INPUTS: name - name within its directory
+ *         parent - index of the containing directory, -1 for the root
+ *         is_dir - whether it is a directory
+ *
+ * RETURNS: the new index, or -1 if out of memory
+ */
+static int add_node(const char *name, int parent, int is_dir)
+{
+    if (num_files == max_files) {
+        int grown = max_files ? max_files * 2 : 64;
+        source_file_t *more = realloc(files, grown * sizeof(source_file_t));
+        if (more == NULL) {
+            return -1;
+        }
+        files = more;
+        max_files = grown;
+    }
+
+    if (strlen(name) > FILE_NAME_LENGTH) {
+        fprintf(stderr, "warning: %s truncated to %d characters\n", name, FILE_NAME_LENGTH);
+    }
+
+    source_file_t *f = &files[num_files];
+    memset(f, 0, sizeof(*f));
+    snprintf(f->name, sizeof(f->name), "%.*s", FILE_NAME_LENGTH, name);
+    f->is_dir = is_dir;
+    f->parent = parent;
+
+    if (parent >= 0) {
+        source_file_t *p = &files[parent];
+        int *children = realloc(p->children, (p->num_children + 1) * sizeof(int));
+        if (children == NULL) {
+            return -1;
+        }
+        p->children = children;
+        p->children[p->num_children++] = num_files;
+    }
+
+    return num_files++;
+}
+
+/*
+ * load_tree(dir_name, index)
+ *
+ * DESCRIPTION: Reads every regular file and subdirectory of a directory,
+ *              depth first and in name order
+ *
+ * INPUTS: dir_name - host path of the directory
+ *         index - its node in files
+ * OUTPUTS: none
+ *
+ * RETURNS: -1 on error, 0 otherwise
+ * SIDE EFFECTS: Adds to files and num_files
+ */
+static int load_tree(const char *dir_name, int index)
+{
+    DIR *dir = opendir(dir_name);
+    if (dir == NULL) {
+        perror(dir_name);
+        return -1;
+    }
+
+    char **names = NULL;
+    int num_names = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+        char **more = realloc(names, (num_names + 1) * sizeof(char *));
+        if (more == NULL || (more[num_names] = strdup(ent->d_name)) == NULL) {
+            closedir(dir);
+            return -1;
+        }
+        names = more;
+        num_names++;
+    }
+    closedir(dir);
+    qsort(names, num_names, sizeof(char *), compare_names);
+
+    int ret = 0;
+    int i;
+    for (i = 0; i < num_names && ret == 0; i++) {
+        char path[4096];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir_name, names[i]);
+        if (stat(path, &st)) {
+            continue;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            int child = add_node(names[i], index, 1);
+            ret = child < 0 ? -1 : load_tree(path, child);
+        } else if (S_ISREG(st.st_mode)) {
+            int child = add_node(names[i], index, 0);
+            if (child < 0) {
+                ret = -1;
+                break;
+            }
+
+            source_file_t *f = &files[child];
+            f->data = read_whole_file(path, &f->length);
+            if (f->data == NULL) {
+                perror(path);
+                ret = -1;
+                break;
+            }
+            f->stored = f->data;
+            f->stored_length = f->length;
+            f->num_blocks = (f->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        }
+    }
+
+    for (i = 0; i < num_names; i++) {
+        free(names[i]);
+    }
+    free(names);
+    return ret;
+}
+
+/*
+ * load_source_dir(dir_name)
+ *
+ * DESCRIPTION: Reads the source tree. A flat directory with few enough
+ *              files keeps the boot block directory, anything else
+ *              needs directory inodes.
+ *
+ * INPUTS: dir_name - the source directory
+ * OUTPUTS: none
+ *
+ * RETURNS: -1 on error, 0 otherwise
+ * SIDE EFFECTS: Fills in files, num_files and directories
+ */
+static int load_source_dir(const char *dir_name)
+{
+    int i;
+
+    if (add_node("", -1, 1) < 0 || load_tree(dir_name, 0)) {
+        return -1;
+    }
+
+    /* Leave room for the "." and "rtc" entries */
+    directories = files[0].num_children > MAX_DIR_ENTRIES - 2;
+    for (i = 1; i < num_files; i++) {
+        directories |= files[i].is_dir;
+    }
+
+    if (!directories) {
+        /* Flat images have no root inode, files start at inode 0 */
+        free(files[0].children);
+        memmove(&files[0], &files[1], (num_files - 1) * sizeof(source_file_t));
+        num_files--;
+    }
+    return 0;
+}
+
+/*
+ * put_dir_entry(entry, name, type, inode)
+ *
+ * DESCRIPTION: Fills in one directory entry
+ */
+static void put_dir_entry(dir_entry_t *entry, const char *name, uint32_t type, uint32_t inode)
+{
+    /* Names exactly 32 characters long are not NUL terminated on disk */
+    memcpy(entry->file_name, name, strlen(name));
+    entry->file_type = type;
+    entry->inode_num = inode;
+}
+
+/*
+ * name_hash(name, length)
+ *
+ * DESCRIPTION: FNV-1a hash of a name, must match rofs_name_hash() in the
+ *              kernel
+ */
+static uint32_t name_hash(const char *name, uint32_t length)
+{
+    uint32_t hash = 2166136261u;
+    uint32_t i;
+
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * build_dir(index)
+ *
+ * DESCRIPTION: Turns a directory node into its inode data: the header,
+ *              a power of two number of hash buckets at least as large
+ *              as the entry count, then ".", "..", "rtc" in the root,
+ *              and the children
+ *
+ * INPUTS: index - the directory in files
+ * OUTPUTS: none
+ *
+ * RETURNS: -1 if out of memory, 0 otherwise
+ * SIDE EFFECTS: Sets the node's data
+ */
+static int build_dir(int index)
+{
+    source_file_t *d = &files[index];
+    uint32_t num_entries = d->num_children + (index == 0 ? 3 : 2);
+    uint32_t num_buckets = 1;
+    uint32_t i;
+
+    while (num_buckets < num_entries) {
+        num_buckets <<= 1;
+    }
+
+    uint32_t length = sizeof(dir_header_t) + num_buckets * sizeof(uint32_t)
+                      + num_entries * sizeof(dir_entry_t);
+    uint8_t *data = calloc(1, length);
+    if (data == NULL) {
+        return -1;
+    }
+
+    dir_header_t *header = (dir_header_t *)data;
+    uint32_t *buckets = (uint32_t *)(header + 1);
+    dir_entry_t *entries = (dir_entry_t *)(buckets + num_buckets);
+    header->num_entries = num_entries;
+    header->num_buckets = num_buckets;
+
+    uint32_t n = 0;
+    put_dir_entry(&entries[n++], ".", TYPE_DIR, index);
+    put_dir_entry(&entries[n++], "..", TYPE_DIR, d->parent < 0 ? index : d->parent);
+    if (index == 0) {
+        put_dir_entry(&entries[n++], "rtc", TYPE_RTC, 0);
+    }
+    for (i = 0; i < (uint32_t)d->num_children; i++) {
+        source_file_t *c = &files[d->children[i]];
+        put_dir_entry(&entries[n++], c->name, c->is_dir ? TYPE_DIR : TYPE_FILE, d->children[i]);
+    }
+
+    for (i = 0; i < num_buckets; i++) {
+        buckets[i] = DIR_END;
+    }
+    for (i = 0; i < num_entries; i++) {
+        uint32_t bucket = name_hash(entries[i].file_name, strnlen(entries[i].file_name,
+                                    FILE_NAME_LENGTH)) % num_buckets;
+        entries[i].next = buckets[bucket];
+        buckets[bucket] = i;
+    }
+
+    d->data = data;
+    d->length = length;
+    d->stored = data;
+    d->stored_length = length;
+    d->num_blocks = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    return 0;
+}
+
+/*
+ * put_length(op, oend, length)
+ *
+ * DESCRIPTION: Writes the extra bytes of an LZ4 length that did not fit
+ *              in its token nibble
+ *
+ * RETURNS: pointer past the bytes, or NULL if out of room
+ */
+static uint8_t *put_length(uint8_t *op, uint8_t *oend, uint32_t length)
+{
+    while (length >= 0xFF) {
+        if (op >= oend) {
+            return NULL;
+        }
+        *op++ = 0xFF;
+        length -= 0xFF;
+    }
+    if (op >= oend) {
+        return NULL;
+    }
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+/*
+ * put_sequence(op, oend, literals, num_literals, offset, match_length)
+ *
+ * DESCRIPTION: Writes one LZ4 sequence. A match_length of 0 writes the
+ *              final literals-only sequence.
+ *
+ * RETURNS: pointer past the sequence, or NULL if out of room
+ */
+static uint8_t *put_sequence(uint8_t *op, uint8_t *oend, const uint8_t *literals,
+                             uint32_t num_literals, uint32_t offset, uint32_t match_length)
+{
+    uint32_t match_code = match_length ? match_length - LZ4_MIN_MATCH : 0;
+    uint8_t *token = op++;
+
+    if (token >= oend) {
+        return NULL;
+    }
+
+    *token = (num_literals >= 0xF ? 0xF : num_literals) << 4;
+    if (num_literals >= 0xF && (op = put_length(op, oend, num_literals - 0xF)) == NULL) {
+        return NULL;
+    }
+    if (num_literals > (uint32_t)(oend - op)) {
+        return NULL;
+    }
+    memcpy(op, literals, num_literals);
+    op += num_literals;
+
+    if (match_length == 0) {
+        return op;
+    }
+
+    if (oend - op < 2) {
+        return NULL;
+    }
+    *op++ = offset & 0xFF;
+    *op++ = offset >> 8;
+
+    *token |= match_code >= 0xF ? 0xF : match_code;
+    if (match_code >= 0xF && (op = put_length(op, oend, match_code - 0xF)) == NULL) {
+        return NULL;
+    }
+    return op;
+}
+
+/*
+ * lz4_compress(src, length, dst, capacity)
+ *
+ * DESCRIPTION: Greedy LZ4 block compressor using a hash of the next four
+ *              bytes to find earlier matches
+ *
+ * INPUTS: src - data to compress
+ *         length - bytes of data
+ *         capacity - room in dst
+ * OUTPUTS: dst - the compressed block
+ *
+ * RETURNS: compressed size, or 0 if it would not fit in capacity
+ */
+static uint32_t lz4_compress(const uint8_t *src, uint32_t length, uint8_t *dst, uint32_t capacity)
+{
+    uint32_t table[1 << LZ4_HASH_BITS];     /* Position + 1 of the last hit */
+    uint32_t match_limit = length > LZ4_MATCH_LIMIT ? length - LZ4_MATCH_LIMIT : 0;
+    uint32_t anchor = 0;
+    uint32_t ip = 0;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + capacity;
+
+    memset(table, 0, sizeof(table));
+
+    while (ip < match_limit) {
+        uint32_t seq;
+        memcpy(&seq, src + ip, sizeof(seq));
+        uint32_t hash = (seq * 2654435761u) >> (32 - LZ4_HASH_BITS);
+        uint32_t ref = table[hash];
+        table[hash] = ip + 1;
+
+        if (ref == 0 || ip - (ref - 1) > LZ4_MAX_OFFSET || memcmp(src + ref - 1, src + ip, LZ4_MIN_MATCH)) {
+            ip++;
+            continue;
+        }
+        ref--;
+
+        uint32_t match_length = LZ4_MIN_MATCH;
+        while (ip + match_length < length - LZ4_LAST_LITERALS
+               && src[ref + match_length] == src[ip + match_length]) {
+            match_length++;
+        }
+
+        op = put_sequence(op, oend, src + anchor, ip - anchor, ip - ref, match_length);
+        if (op == NULL) {
+            return 0;
+        }
+        ip += match_length;
+        anchor = ip;
+    }
+
+    op = put_sequence(op, oend, src + anchor, length - anchor, 0, 0);
+    return op == NULL ? 0 : (uint32_t)(op - dst);
+}
+
+/*
+ * compress_file(f)
+ *
+ * DESCRIPTION: Compresses a file block by block, keeping the result only
+ *              if it takes fewer blocks than the raw data. Blocks that do
+ *              not shrink are stored raw.
+ *
+ * INPUTS: f - the file
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: may replace f->stored and f->num_blocks
+ */
+static void compress_file(source_file_t *f)
+{
+    uint32_t num_blocks = (f->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint32_t table_length = (num_blocks + 1) * sizeof(uint32_t);
+    uint8_t *stored = malloc(table_length + (size_t)num_blocks * BLOCK_SIZE);
+    uint32_t *table = (uint32_t *)stored;
+    uint32_t end = table_length;
+    uint32_t b;
+
+    if (stored == NULL || num_blocks == 0) {
+        free(stored);
+        return;
+    }
+
+    for (b = 0; b < num_blocks; b++) {
+        uint32_t block_length = f->length - b * BLOCK_SIZE;
+        if (block_length > BLOCK_SIZE) {
+            block_length = BLOCK_SIZE;
+        }
+
+        table[b] = end;
+        uint32_t size = lz4_compress(f->data + b * BLOCK_SIZE, block_length,
+                                     stored + end, block_length - 1);
+        if (size == 0) {
+            memcpy(stored + end, f->data + b * BLOCK_SIZE, block_length);
+            size = block_length;
+        }
+        end += size;
+    }
+    table[num_blocks] = end;
+
+    uint32_t stored_blocks = (end + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (stored_blocks >= num_blocks) {
+        free(stored);
+        return;
+    }
+
+    f->stored = stored;
+    f->stored_length = end;
+    f->compressed = 1;
+    f->num_blocks = stored_blocks;
+}
+
+/*
+ * hash_block(data, length)
+ *
+ * DESCRIPTION: FNV-1a hash of a data block for the dedup table
+ *
+ * RETURNS: bucket in unique_blocks
+ */
+static uint32_t hash_block(const uint8_t *data, uint32_t length)
+{
+    uint32_t hash = 2166136261u;
+    uint32_t i;
+
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash >> (32 - DEDUP_HASH_BITS);
+}
+
+/*
+ * find_block(data, length)
+ *
+ * DESCRIPTION: Looks for a block with the same contents already placed
+ *
+ * RETURNS: the placed block, or NULL if there is none
+ */
+static unique_block_t *find_block(const uint8_t *data, uint32_t length)
+{
+    unique_block_t *u;
+
+    for (u = unique_blocks[hash_block(data, length)]; u != NULL; u = u->next) {
+        if (u->length == length && memcmp(u->data, data, length) == 0) {
+            return u;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * add_block(data, length, block)
+ *
+ * DESCRIPTION: Records a newly placed block so later copies can share it
+ *
+ * SIDE EFFECTS: allocates a table entry
+ */
+static void add_block(const uint8_t *data, uint32_t length, uint32_t block)
+{
+    uint32_t bucket = hash_block(data, length);
+    unique_block_t *u = malloc(sizeof(*u));
+
+    if (u == NULL) {
+        return;
+    }
+    u->data = data;
+    u->length = length;
+    u->block = block;
+    u->next = unique_blocks[bucket];
+    unique_blocks[bucket] = u;
+}
+
+/*
+ * count_runs(f)
+ *
+ * DESCRIPTION: Counts the extents needed to describe a file's block map
+ *
+ * RETURNS: number of runs of consecutive blocks
+ */
+static uint32_t count_runs(const source_file_t *f)
+{
+    uint32_t runs = 0;
+    uint32_t b;
+
+    for (b = 0; b < f->num_blocks; b++) {
+        if (b == 0 || f->block_map[b] != f->block_map[b - 1] + 1) {
+            runs++;
+        }
+    }
+    return runs;
+}
+
+/*
+ * layout_file(f, version, dedup, data_blocks)
+ *
+ * DESCRIPTION: Picks the data block for each stored block of a file.
+ *              Without dedup the file gets fresh consecutive blocks. With
+ *              it, blocks seen before are shared. A version 2 file with
+ *              more extents than fit in its inode gets blocks after its
+ *              data to hold the rest.
+ *
+ * INPUTS: f - the file
+ *         version - ROFS_VERSION_1 or ROFS_VERSION_2
+ *         dedup - whether to share identical blocks
+ *         data_blocks - blocks used so far
+ * OUTPUTS: data_blocks - blocks used including this file
+ *
+ * RETURNS: 0 on success, -1 if out of memory
+ */
+static int layout_file(source_file_t *f, int version, int dedup, uint32_t *data_blocks)
+{
+    uint32_t next = *data_blocks;
+    uint32_t b;
+
+    f->block_map = malloc((f->num_blocks + 1) * sizeof(uint32_t));
+    if (f->block_map == NULL) {
+        return -1;
+    }
+
+    for (b = 0; b < f->num_blocks; b++) {
+        const uint8_t *block = f->stored + (size_t)b * BLOCK_SIZE;
+        uint32_t length = f->stored_length - b * BLOCK_SIZE;
+        if (length > BLOCK_SIZE) {
+            length = BLOCK_SIZE;
+        }
+
+        unique_block_t *u = dedup ? find_block(block, length) : NULL;
+        f->block_map[b] = u != NULL ? u->block : next++;
+    }
+
+    uint32_t runs = count_runs(f);
+    if (version == ROFS_VERSION_2 && runs > INLINE_EXTENTS) {
+        /* The last inline extent points at the spilled ones instead */
+        uint32_t spilled = runs - (INLINE_EXTENTS - 1);
+        f->extent_block = next;
+        f->extent_blocks = (spilled * sizeof(extent_t) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        next += f->extent_blocks;
+    }
+
+    /* Only blocks that got a new home can be shared later */
+    if (dedup) {
+        for (b = 0; b < f->num_blocks; b++) {
+            if (f->block_map[b] >= *data_blocks) {
+                uint32_t length = f->stored_length - b * BLOCK_SIZE;
+                add_block(f->stored + (size_t)b * BLOCK_SIZE,
+                          length > BLOCK_SIZE ? BLOCK_SIZE : length, f->block_map[b]);
+            }
+        }
+    }
+
+    *data_blocks = next;
+    return 0;
+}
+
+/*
+ * fill_dentries(boot)
+ *
+ * DESCRIPTION: Writes a flat directory into the boot block. The directory
+ *              itself and the RTC device come first, then one entry per
+ *              file whose inode number is its position in files.
+ *
+ * INPUTS: none
+ * OUTPUTS: boot - boot block to fill
+ */
+static void fill_dentries(boot_block_t *boot)
+{
+    int i;
+
+    strncpy(boot->dentries[0].file_name, ".", FILE_NAME_LENGTH);
+    boot->dentries[0].file_type = TYPE_DIR;
+    strncpy(boot->dentries[1].file_name, "rtc", FILE_NAME_LENGTH);
+    boot->dentries[1].file_type = TYPE_RTC;
+
+    for (i = 0; i < num_files; i++) {
+        /* Names exactly 32 characters long are not NUL terminated on disk */
+        memcpy(boot->dentries[i + 2].file_name, files[i].name, strlen(files[i].name));
+        boot->dentries[i + 2].file_type = TYPE_FILE;
+        boot->dentries[i + 2].inode_num = i;
+    }
+
+    boot->num_dir_entries = num_files + 2;
+    boot->num_inodes = num_files;
+}
+
+/*
+ * crc32c(data, length)
+ *
+ * DESCRIPTION: Bit at a time CRC32C, matching the kernel's
+ *
+ * RETURNS: the CRC
+ */
+static uint32_t crc32c(const uint8_t *data, size_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    int k;
+
+    while (length--) {
+        crc ^= *data++;
+        for (k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0);
+        }
+    }
+    return ~crc;
+}
+
+/*
+ * put_extents(node, f, data)
+ *
+ * DESCRIPTION: Describes a version 2 file's block map with extents. When
+ *              they do not all fit in the inode, the last inline extent
+ *              covers the file's extent blocks and the rest go there.
+ *
+ * INPUTS: f - the file, already laid out
+ *         data - start of the image's data region
+ * OUTPUTS: node - inode to fill in
+ */
+static void put_extents(inode2_t *node, const source_file_t *f, uint8_t *data)
+{
+    extent_t *spilled = (extent_t *)(data + (size_t)f->extent_block * BLOCK_SIZE);
+    extent_t *extent = NULL;
+    uint32_t b;
+
+    if (f->extent_blocks > 0) {
+        node->flags |= INODE_INDIRECT;
+        node->extents[INLINE_EXTENTS - 1].start = f->extent_block;
+        node->extents[INLINE_EXTENTS - 1].length = f->extent_blocks;
+    }
+
+    for (b = 0; b < f->num_blocks; b++) {
+        if (b > 0 && f->block_map[b] == f->block_map[b - 1] + 1) {
+            extent->length++;
+            continue;
+        }
+
+        if (f->extent_blocks > 0 && node->num_extents >= INLINE_EXTENTS - 1) {
+            extent = &spilled[node->num_extents - (INLINE_EXTENTS - 1)];
+        } else {
+            extent = &node->extents[node->num_extents];
+        }
+        extent->start = f->block_map[b];
+        extent->length = 1;
+        node->num_extents++;
+    }
+}
+
+/*
+ * build_image(version, dedup, checksums, size)
+ *
+ * DESCRIPTION: Lays out the image in memory. Data blocks are handed out
+ *              in file order, so every file is contiguous apart from the
+ *              blocks it shares when dedup is on.
+ *
+ * INPUTS: version - ROFS_VERSION_1 or ROFS_VERSION_2
+ *         dedup - whether to share identical blocks
+ *         checksums - whether to add the CRC32C table
+ * OUTPUTS: size - bytes in the image
+ *
+ * RETURNS: malloc'd image, or NULL on error
+ */
+static uint8_t *build_image(int version, int dedup, int checksums, size_t *size)
+{
+    uint32_t inode_blocks;
+    uint32_t checksum_blocks = 0;
+    uint32_t data_blocks = 0;
+    int i;
+
+    for (i = 0; i < num_files; i++) {
+        if (version == ROFS_VERSION_1 && files[i].num_blocks > INODE_BLOCK_NUMS) {
+            fprintf(stderr, "%s is too large for a version 1 image\n", files[i].name);
+            return NULL;
+        }
+        if (layout_file(&files[i], version, dedup, &data_blocks)) {
+            fprintf(stderr, "out of memory\n");
+            return NULL;
+        }
+    }
+
+    if (version == ROFS_VERSION_1) {
+        inode_blocks = num_files;
+    } else {
+        inode_blocks = (num_files + INODES_PER_BLOCK - 1) / INODES_PER_BLOCK;
+    }
+
+    if (checksums) {
+        checksum_blocks = (data_blocks * sizeof(uint32_t) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    }
+
+    *size = (size_t)(1 + inode_blocks + checksum_blocks + data_blocks) * BLOCK_SIZE;
+    uint8_t *image = calloc(1, *size);
+    if (image == NULL) {
+        return NULL;
+    }
+
+    boot_block_t *boot = (boot_block_t *)image;
+    if (directories) {
+        /* Names live in the directory inodes, the root is inode 0 */
+        boot->num_inodes = num_files;
+        boot->flags |= ROFS_DIRECTORIES;
+        boot->root_inode = 0;
+    } else {
+        fill_dentries(boot);
+    }
+    boot->num_data_blocks = data_blocks;
+    if (version == ROFS_VERSION_2) {
+        boot->magic = ROFS_MAGIC;
+        boot->version = ROFS_VERSION_2;
+        boot->inode_blocks = inode_blocks;
+    }
+
+    uint8_t *inode_table = image + BLOCK_SIZE;
+    uint32_t *checksum_table = (uint32_t *)(inode_table + (size_t)inode_blocks * BLOCK_SIZE);
+    uint8_t *data = (uint8_t *)checksum_table + (size_t)checksum_blocks * BLOCK_SIZE;
+
+    for (i = 0; i < num_files; i++) {
+        source_file_t *f = &files[i];
+        uint32_t b;
+
+        /* Shared blocks get written once per owner with the same bytes */
+        for (b = 0; b < f->num_blocks; b++) {
+            uint32_t length = f->stored_length - b * BLOCK_SIZE;
+            memcpy(data + (size_t)f->block_map[b] * BLOCK_SIZE, f->stored + (size_t)b * BLOCK_SIZE,
+                   length > BLOCK_SIZE ? BLOCK_SIZE : length);
+        }
+
+        if (version == ROFS_VERSION_1) {
+            inode_t *node = (inode_t *)inode_table + i;
+            node->length = f->length;
+            for (b = 0; b < f->num_blocks; b++) {
+                node->data_block_num[b] = f->block_map[b];
+            }
+        } else {
+            inode2_t *node = (inode2_t *)inode_table + i;
+            node->length = f->length;
+            if (f->compressed) {
+                node->flags |= INODE_COMPRESSED;
+                boot->flags |= ROFS_COMPRESSED;
+            }
+            if (f->is_dir) {
+                node->flags |= INODE_DIRECTORY;
+            }
+            put_extents(node, f, data);
+        }
+    }
+
+    /* Extent blocks are data blocks too, so this waits until they are written */
+    if (checksums) {
+        uint32_t b;
+        boot->flags |= ROFS_CHECKSUMS;
+        boot->checksum_blocks = checksum_blocks;
+        for (b = 0; b < data_blocks; b++) {
+            checksum_table[b] = crc32c(data + (size_t)b * BLOCK_SIZE, BLOCK_SIZE);
+        }
+    }
+
+    return image;
+}
+
+int main(int argc, char **argv)
+{
+    int version = ROFS_VERSION_2;
+    int compress = 0;
+    int dedup = 0;
+    int checksums = 0;
+    const char *output = "filesys_img";
+    const char *source = NULL;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-1") == 0) {
+            version = ROFS_VERSION_1;
+        } else if (strcmp(argv[i], "-2") == 0) {
+            version = ROFS_VERSION_2;
+        } else if (strcmp(argv[i], "-z") == 0) {
+            compress = 1;
+        } else if (strcmp(argv[i], "-d") == 0) {
+            dedup = 1;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            checksums = 1;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (argv[i][0] == '-' || source != NULL) {
+            usage(argv[0]);
+        } else {
+            source = argv[i];
+        }
+    }
+
+    if (source == NULL) {
+        usage(argv[0]);
+    }
+
+    if (compress && version == ROFS_VERSION_1) {
+        fprintf(stderr, "compression needs a version 2 image\n");
+        return 1;
+    }
+
+    if (checksums && version == ROFS_VERSION_1) {
+        fprintf(stderr, "checksums need a version 2 image\n");
+        return 1;
+    }
+
+    if (load_source_dir(source)) {
+        return 1;
+    }
+
+    if (directories && version == ROFS_VERSION_1) {
+        fprintf(stderr, "version 1 images hold at most %d files and no directories\n",
+            MAX_DIR_ENTRIES - 2);
+        return 1;
+    }
+
+    for (i = 0; i < num_files; i++) {
+        if (files[i].is_dir && build_dir(i)) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    }
+
+    if (compress) {
+        uint64_t logical = 0;
+        uint64_t stored = 0;
+        for (i = 0; i < num_files; i++) {
+            compress_file(&files[i]);
+            logical += files[i].length;
+            stored += files[i].stored_length;
+        }
+        printf("compression: %llu -> %llu bytes (%.2fx)\n",
+            (unsigned long long)logical, (unsigned long long)stored,
+            stored ? (double)logical / stored : 1.0);
+    }
+
+    size_t size;
+    uint8_t *image = build_image(version, dedup, checksums, &size);
+    if (image == NULL) {
+        return 1;
+    }
+
+    FILE *fp = fopen(output, "wb");
+    if (fp == NULL || fwrite(image, 1, size, fp) != size) {
+        perror(output);
+        return 1;
+    }
+    fclose(fp);
+
+    uint32_t logical = 0;
+    int num_dirs = 0;
+    for (i = 0; i < num_files; i++) {
+        logical += files[i].num_blocks;
+        num_dirs += files[i].is_dir;
+    }
+    printf("%s: version %d, %d files, %d directories, %zu blocks (%u logical data blocks in %u)\n",
+        output, version, num_files - num_dirs, num_dirs, size / BLOCK_SIZE, logical,
+        ((boot_block_t *)image)->num_data_blocks);
+    return 0;
+}
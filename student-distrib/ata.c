@@ -0,0 +1,561 @@
+#include "ata.h"
+
+#include "i8259.h"
+#include "lib.h"
+#include "paging.h"
+
+static ata_drive_t drives[ATA_DRIVES];
+
+// The channel runs one command at a time, for whichever drive is active
+static ata_drive_t *active;
+static uint32_t dma_active;
+
+// Bus master I/O base, 0 without a controller that does DMA
+static uint32_t bm_base;
+
+// Read by the controller, so it lives in the identity mapped kernel page
+static prd_t prd_table[ATA_PRD_ENTRIES] __attribute__((aligned(32)));
+
+/*
+ * pci_read(device, function, reg)
+ *
+ * DESCRIPTION: Reads a register from a bus 0 device's configuration space
+ *
+ * INPUTS: 	device - slot number
+ *          function - function number
+ *          reg - register offset
+ * OUTPUTS: none
+ *
+ * RETURNS: the register, all ones if nothing is there
+ * SIDE EFFECTS: none
+ */
+static uint32_t pci_read(uint32_t device, uint32_t function, uint32_t reg) {
+    outl(PCI_ENABLE | (device << 11) | (function << 8) | (reg & 0xFC), PCI_CONFIG_ADDRESS);
+    return inl(PCI_CONFIG_DATA);
+}
+
+/*
+ * pci_write(device, function, reg, value)
+ *
+ * DESCRIPTION: Writes a register in a bus 0 device's configuration space
+ *
+ * INPUTS: 	device - slot number
+ *          function - function number
+ *          reg - register offset
+ *          value - new value
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: reconfigures the device
+ */
+static void pci_write(uint32_t device, uint32_t function, uint32_t reg, uint32_t value) {
+    outl(PCI_ENABLE | (device << 11) | (function << 8) | (reg & 0xFC), PCI_CONFIG_ADDRESS);
+    outl(value, PCI_CONFIG_DATA);
+}
+
+/*
+ * find_bus_master()
+ *
+ * DESCRIPTION: Looks for the IDE controller behind the primary channel
+ *              and lets it master the bus if it can
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * RETURNS: the bus master I/O base, or 0 if there is no way to do DMA
+ * SIDE EFFECTS: enables bus mastering on the controller
+ */
+static uint32_t find_bus_master(void) {
+    uint32_t device, function;
+
+    for (device = 0; device < PCI_DEVICES; device++) {
+        for (function = 0; function < PCI_FUNCTIONS; function++) {
+            uint32_t class, prog_if, bar, command;
+
+            if ((pci_read(device, function, PCI_ID) & 0xFFFF) == 0xFFFF) {
+                continue;
+            }
+
+            class = pci_read(device, function, PCI_CLASS);
+            if (class >> 16 != PCI_CLASS_IDE) {
+                continue;
+            }
+
+            // A channel in native mode is not the one at 0x1F0
+            prog_if = (class >> 8) & 0xFF;
+            bar = pci_read(device, function, PCI_BAR4);
+            if ((prog_if & PCI_IDE_PRIMARY_NATIVE) || !(prog_if & PCI_IDE_BUS_MASTER) || !(bar & 1)) {
+                return 0;
+            }
+
+            command = pci_read(device, function, PCI_COMMAND) & 0xFFFF;
+            pci_write(device, function, PCI_COMMAND, command | PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+            return bar & 0xFFFC;
+        }
+    }
+    return 0;
+}
+
+/*
+ * wait_idle()
+ *
+ * DESCRIPTION: Spins until the channel is not busy
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * RETURNS: the status, or -1 if it stayed busy
+ * SIDE EFFECTS: none
+ */
+static int32_t wait_idle(void) {
+    uint32_t i;
+    for (i = 0; i < ATA_POLL_LIMIT; i++) {
+        uint32_t status = inb(ATA_CONTROL_PORT);
+        if (!(status & ATA_STATUS_BSY)) {
+            return status;
+        }
+    }
+    return -1;
+}
+
+/*
+ * wait_data()
+ *
+ * DESCRIPTION: Spins until the drive is ready to move a sector through
+ *              the data port
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * RETURNS: 0 when it is, -1 on an error or if it never is
+ * SIDE EFFECTS: none
+ */
+static int32_t wait_data(void) {
+    uint32_t i;
+    for (i = 0; i < ATA_POLL_LIMIT; i++) {
+        uint32_t status = inb(ATA_CONTROL_PORT);
+        if (status & ATA_STATUS_BSY) {
+            continue;
+        }
+        if (status & (ATA_STATUS_ERR | ATA_STATUS_DF)) {
+            return -1;
+        }
+        if (status & ATA_STATUS_DRQ) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * select_drive(drive, sector)
+ *
+ * DESCRIPTION: Points the channel at a drive and the top bits of a sector
+ *
+ * INPUTS: 	drive - the drive
+ *          sector - LBA of the command about to go out
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: waits the 400ns the drive needs to answer
+ */
+static void select_drive(ata_drive_t *drive, uint32_t sector) {
+    uint32_t i;
+
+    outb(ATA_DRIVE_LBA | (drive->slave ? ATA_DRIVE_SLAVE : 0) | ((sector >> 24) & 0x0F), ATA_DRIVE_PORT);
+    for (i = 0; i < 4; i++) {
+        inb(ATA_CONTROL_PORT);
+    }
+}
+
+/*
+ * dma_capable(buf, length)
+ *
+ * DESCRIPTION: The bus master takes physical addresses, so only buffers
+ *              in the identity mapped kernel page and frame pool can use it
+ *
+ * INPUTS: 	buf - the buffer
+ *          length - bytes
+ * OUTPUTS: none
+ *
+ * RETURNS: 1 if the controller can reach all of it, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+static uint32_t dma_capable(const uint8_t *buf, uint32_t length) {
+    uint32_t start = (uint32_t) buf;
+    uint32_t end = start + length;
+
+    if (start & 1) {
+        return 0;
+    }
+
+    return (start >= KERNEL_PAGE_START && end <= KERNEL_PAGE_END)
+        || (start >= FRAME_POOL_START && end <= FRAME_POOL_END);
+}
+
+/*
+ * fill_prd_table(buf, length)
+ *
+ * DESCRIPTION: Describes a buffer to the bus master, splitting it where
+ *              it crosses a 64KB boundary
+ *
+ * INPUTS: 	buf - a dma_capable() buffer
+ *          length - bytes, at most ATA_MAX_SECTORS sectors
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: fills prd_table
+ */
+static void fill_prd_table(const uint8_t *buf, uint32_t length) {
+    uint32_t addr = (uint32_t) buf;
+    uint32_t i = 0;
+
+    while (length > 0) {
+        uint32_t piece = ATA_DMA_BOUNDARY - addr % ATA_DMA_BOUNDARY;
+        if (piece > length) {
+            piece = length;
+        }
+
+        prd_table[i].addr = addr;
+        prd_table[i].bytes = piece & 0xFFFF;
+        prd_table[i].flags = 0;
+        addr += piece;
+        length -= piece;
+        i++;
+    }
+    prd_table[i - 1].flags = ATA_PRD_LAST;
+}
+
+static void ata_issue(ata_drive_t *drive);
+
+/*
+ * ata_finish(drive, status)
+ *
+ * DESCRIPTION: Ends a drive's request and hands the channel on. A drive
+ *              that was waiting goes first, so neither one can keep the
+ *              channel to itself.
+ *
+ * INPUTS: 	drive - the active drive
+ *          status - 0 on success, -1 on an error
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: completes the request, may start the next command
+ */
+static void ata_finish(ata_drive_t *drive, int32_t status) {
+    uint32_t i;
+
+    drive->req = NULL;
+    active = NULL;
+    for (i = 0; i < ATA_DRIVES && active == NULL; i++) {
+        if (drives[i].req != NULL) {
+            ata_issue(&drives[i]);
+        }
+    }
+
+    block_complete(drive->dev, status);
+}
+
+/*
+ * ata_issue(drive)
+ *
+ * DESCRIPTION: Sends the command for the next piece of a drive's request,
+ *              by DMA when the buffer allows it. A PIO write also sends
+ *              its first sector, the rest go from the interrupt handler.
+ *
+ * INPUTS: 	drive - a drive with sectors left, the channel idle
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: makes the drive active, may fail the request
+ */
+static void ata_issue(ata_drive_t *drive) {
+    uint32_t count = drive->left < ATA_MAX_SECTORS ? drive->left : ATA_MAX_SECTORS;
+    uint32_t write = drive->req->write;
+    uint32_t direction = write ? 0 : BM_CMD_READ;
+    uint32_t command;
+
+    active = drive;
+    drive->chunk = count;
+    drive->chunk_left = count;
+    dma_active = drive->use_dma && dma_capable(drive->buf, count * ATA_SECTOR_SIZE);
+
+    if (wait_idle() < 0) {
+        ata_finish(drive, -1);
+        return;
+    }
+
+    select_drive(drive, drive->sector);
+    if (dma_active) {
+        fill_prd_table(drive->buf, count * ATA_SECTOR_SIZE);
+        outl((uint32_t) prd_table, bm_base + BM_PRD_TABLE);
+        outb(direction, bm_base + BM_COMMAND);
+        outb(inb(bm_base + BM_STATUS) | BM_STATUS_ERROR | BM_STATUS_IRQ, bm_base + BM_STATUS);
+        command = write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA;
+    } else {
+        command = write ? ATA_CMD_WRITE : ATA_CMD_READ;
+    }
+
+    outb(count, ATA_COUNT_PORT);
+    outb(drive->sector & 0xFF, ATA_LBA_LOW_PORT);
+    outb((drive->sector >> 8) & 0xFF, ATA_LBA_MID_PORT);
+    outb((drive->sector >> 16) & 0xFF, ATA_LBA_HIGH_PORT);
+    outb(command, ATA_COMMAND_PORT);
+
+    if (dma_active) {
+        outb(direction | BM_CMD_START, bm_base + BM_COMMAND);
+    } else if (write) {
+        if (wait_data()) {
+            ata_finish(drive, -1);
+            return;
+        }
+        outsw(ATA_DATA_PORT, drive->buf, ATA_SECTOR_SIZE / 2);
+        drive->buf += ATA_SECTOR_SIZE;
+        drive->chunk_left--;
+    }
+}
+
+/*
+ * ata_start(dev, req)
+ *
+ * DESCRIPTION: Takes a request from the block layer. It goes out now if
+ *              the channel is idle, otherwise when the other drive is done.
+ *
+ * INPUTS: 	dev - the drive
+ *          req - the head request, already checked against the size
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: may start a command
+ */
+static void ata_start(block_device_t *dev, block_request_t *req) {
+    ata_drive_t *drive = (ata_drive_t *) dev->driver;
+
+    drive->req = req;
+    drive->sector = req->block;
+    drive->left = req->count;
+    drive->buf = req->buf;
+    if (active == NULL) {
+        ata_issue(drive);
+    }
+}
+
+static const block_ops_t ata_ops = {ata_start};
+
+/*
+ * ata_handler()
+ *
+ * DESCRIPTION: Handles IRQ14. A DMA command interrupts once when it is
+ *              done; PIO interrupts once per sector, which is moved here.
+ *              Requests longer than a command go on to the next piece.
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: moves sectors, completes requests
+ */
+void ata_handler(void) {
+    ata_drive_t *drive = active;
+    uint32_t status = inb(ATA_STATUS_PORT);
+
+    send_eoi(ATA_IRQ_LINE);
+    if (drive == NULL) {
+        return;
+    }
+
+    if (dma_active) {
+        uint32_t bm_status = inb(bm_base + BM_STATUS);
+        outb(0, bm_base + BM_COMMAND);
+        outb(bm_status | BM_STATUS_ERROR | BM_STATUS_IRQ, bm_base + BM_STATUS);
+        if ((status & (ATA_STATUS_ERR | ATA_STATUS_DF)) || (bm_status & BM_STATUS_ERROR)) {
+            ata_finish(drive, -1);
+            return;
+        }
+
+        drive->buf += drive->chunk * ATA_SECTOR_SIZE;
+        drive->chunk_left = 0;
+    } else {
+        if (status & (ATA_STATUS_ERR | ATA_STATUS_DF)) {
+            ata_finish(drive, -1);
+            return;
+        }
+
+        if (!drive->req->write) {
+            if (!(status & ATA_STATUS_DRQ)) {
+                ata_finish(drive, -1);
+                return;
+            }
+            insw(ATA_DATA_PORT, drive->buf, ATA_SECTOR_SIZE / 2);
+            drive->buf += ATA_SECTOR_SIZE;
+            drive->chunk_left--;
+        } else if (drive->chunk_left > 0) {
+            // The drive took the last sector, send it the next
+            outsw(ATA_DATA_PORT, drive->buf, ATA_SECTOR_SIZE / 2);
+            drive->buf += ATA_SECTOR_SIZE;
+            drive->chunk_left--;
+            return;
+        }
+
+        if (drive->chunk_left > 0) {
+            return;
+        }
+    }
+
+    drive->sector += drive->chunk;
+    drive->left -= drive->chunk;
+    if (drive->left > 0) {
+        ata_issue(drive);
+    } else {
+        ata_finish(drive, 0);
+    }
+}
+
+/*
+ * ata_identify(drive, id)
+ *
+ * DESCRIPTION: Asks a drive to describe itself, polling since the
+ *              interrupt is still masked
+ *
+ * INPUTS: 	drive - the drive
+ * OUTPUTS: id - the IDENTIFY words
+ *
+ * RETURNS: 0 for an ATA drive, -1 if there is none or it is something else
+ * SIDE EFFECTS: none
+ */
+static int32_t ata_identify(ata_drive_t *drive, uint16_t *id) {
+    select_drive(drive, 0);
+    outb(0, ATA_COUNT_PORT);
+    outb(0, ATA_LBA_LOW_PORT);
+    outb(0, ATA_LBA_MID_PORT);
+    outb(0, ATA_LBA_HIGH_PORT);
+    outb(ATA_CMD_IDENTIFY, ATA_COMMAND_PORT);
+
+    if (inb(ATA_STATUS_PORT) == 0 || wait_idle() < 0) {
+        return -1;
+    }
+
+    // ATAPI and SATA devices put their signature here instead
+    if (inb(ATA_LBA_MID_PORT) || inb(ATA_LBA_HIGH_PORT)) {
+        return -1;
+    }
+
+    if (wait_data()) {
+        return -1;
+    }
+
+    insw(ATA_DATA_PORT, id, ATA_ID_WORDS);
+    return 0;
+}
+
+/*
+ * ata_init()
+ *
+ * DESCRIPTION: Finds the drives on the primary IDE channel and registers
+ *              them with the block layer as hda and hdb, then unmasks
+ *              IRQ14. Drives whose controller can master the bus use DMA.
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Enables the primary IDE PIC line, prints the drives
+ */
+void ata_init(void) {
+    uint16_t id[ATA_ID_WORDS];
+    int8_t name[] = "hda";
+    uint32_t flags;
+    uint32_t i;
+
+    // Nothing drives the bus without a controller
+    if (inb(ATA_STATUS_PORT) == 0xFF) {
+        return;
+    }
+
+    outb(ATA_CONTROL_NIEN, ATA_CONTROL_PORT);
+    bm_base = find_bus_master();
+
+    for (i = 0; i < ATA_DRIVES; i++) {
+        ata_drive_t *drive = &drives[i];
+        uint32_t sectors;
+
+        drive->slave = i;
+        if (ata_identify(drive, id)) {
+            continue;
+        }
+
+        sectors = id[ATA_ID_LBA_SECTORS] | (id[ATA_ID_LBA_SECTORS + 1] << 16);
+        if (sectors == 0) {
+            continue;
+        }
+
+        name[2] = 'a' + i;
+        drive->dev = register_block_device(name, ATA_SECTOR_SIZE, sectors, &ata_ops, drive);
+        if (drive->dev == NULL) {
+            continue;
+        }
+
+        drive->dma = bm_base != 0 && (id[ATA_ID_CAPABILITIES] & ATA_CAP_DMA);
+        drive->use_dma = drive->dma;
+        drive->present = 1;
+        printf("%s: %d MB, %s\n", name, sectors / (0x100000 / ATA_SECTOR_SIZE), drive->dma ? "DMA" : "PIO");
+    }
+
+    cli_and_save(flags);
+    inb(ATA_STATUS_PORT);
+    outb(0, ATA_CONTROL_PORT);
+    enable_irq(ATA_IRQ_LINE);
+    restore_flags(flags);
+}
+
+/*
+ * find_drive(dev)
+ *
+ * DESCRIPTION: Maps a block device back to its drive
+ *
+ * INPUTS: 	dev - a block device
+ * OUTPUTS: none
+ *
+ * RETURNS: the drive, or NULL if dev is not one
+ * SIDE EFFECTS: none
+ */
+static ata_drive_t *find_drive(block_device_t *dev) {
+    uint32_t i;
+    for (i = 0; i < ATA_DRIVES; i++) {
+        if (drives[i].present && drives[i].dev == dev) {
+            return &drives[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * ata_set_dma(dev, enable)
+ *
+ * DESCRIPTION: Switches a drive between DMA and PIO, taking effect from
+ *              its next command
+ *
+ * INPUTS: 	dev - the drive
+ *          enable - 1 for DMA, 0 for PIO
+ * OUTPUTS: none
+ *
+ * RETURNS: 0 on success, -1 if dev is not a drive or cannot do DMA
+ * SIDE EFFECTS: none
+ */
+int32_t ata_set_dma(block_device_t *dev, uint32_t enable) {
+    ata_drive_t *drive = find_drive(dev);
+    if (drive == NULL || (enable && !drive->dma)) {
+        return -1;
+    }
+
+    drive->use_dma = enable;
+    return 0;
+}
+
+/*
+ * ata_uses_dma(dev)
+ *
+ * DESCRIPTION: Says how a drive moves data
+ *
+ * INPUTS: 	dev - a block device
+ * OUTPUTS: none
+ *
+ * RETURNS: 1 if it is a drive using DMA, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+uint32_t ata_uses_dma(block_device_t *dev) {
+    ata_drive_t *drive = find_drive(dev);
+    return drive != NULL && drive->use_dma;
+}
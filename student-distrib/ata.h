@@ -0,0 +1,113 @@
+#ifndef ATA_H_
+#define ATA_H_
+
+#include "types.h"
+#include "block.h"
+
+// Primary IDE channel in compatibility mode
+#define ATA_DATA_PORT       0x1F0
+#define ATA_ERROR_PORT      0x1F1
+#define ATA_COUNT_PORT      0x1F2
+#define ATA_LBA_LOW_PORT    0x1F3
+#define ATA_LBA_MID_PORT    0x1F4
+#define ATA_LBA_HIGH_PORT   0x1F5
+#define ATA_DRIVE_PORT      0x1F6
+#define ATA_STATUS_PORT     0x1F7   // Reading it acknowledges the interrupt
+#define ATA_COMMAND_PORT    0x1F7
+#define ATA_CONTROL_PORT    0x3F6   // Alternate status when read
+
+// Status bits
+#define ATA_STATUS_ERR      0x01
+#define ATA_STATUS_DRQ      0x08
+#define ATA_STATUS_DF       0x20
+#define ATA_STATUS_BSY      0x80
+
+// Drive register, LBA addressing plus bits 24-27 of the sector
+#define ATA_DRIVE_LBA       0xE0
+#define ATA_DRIVE_SLAVE     0x10
+
+// Control register
+#define ATA_CONTROL_NIEN    0x02    // Mask the drive's interrupt
+
+#define ATA_CMD_READ        0x20
+#define ATA_CMD_WRITE       0x30
+#define ATA_CMD_READ_DMA    0xC8
+#define ATA_CMD_WRITE_DMA   0xCA
+#define ATA_CMD_IDENTIFY    0xEC
+
+// IDENTIFY words
+#define ATA_ID_WORDS        256
+#define ATA_ID_CAPABILITIES 49
+#define ATA_ID_LBA_SECTORS  60      // 32 bits over words 60 and 61
+#define ATA_CAP_DMA         0x100
+
+#define ATA_SECTOR_SIZE     512
+// Sectors per command, requests bigger than this take several
+#define ATA_MAX_SECTORS     128
+// Spins while waiting on the status register before giving up
+#define ATA_POLL_LIMIT      0x100000
+
+// PCI configuration space, for the bus master registers
+#define PCI_CONFIG_ADDRESS  0xCF8
+#define PCI_CONFIG_DATA     0xCFC
+#define PCI_ENABLE          0x80000000
+#define PCI_DEVICES         32
+#define PCI_FUNCTIONS       8
+#define PCI_ID              0x00
+#define PCI_COMMAND         0x04
+#define PCI_CLASS           0x08
+#define PCI_BAR4            0x20
+#define PCI_COMMAND_IO      0x1
+#define PCI_COMMAND_MASTER  0x4
+#define PCI_CLASS_IDE       0x0101  // Mass storage, IDE
+#define PCI_IDE_PRIMARY_NATIVE 0x01 // Prog IF bit, primary not at 0x1F0
+#define PCI_IDE_BUS_MASTER  0x80    // Prog IF bit
+
+// Bus master registers for the primary channel, from BAR4
+#define BM_COMMAND          0x0
+#define BM_STATUS           0x2
+#define BM_PRD_TABLE        0x4
+#define BM_CMD_START        0x01
+#define BM_CMD_READ         0x08    // The device writes memory
+#define BM_STATUS_ERROR     0x02
+#define BM_STATUS_IRQ       0x04
+
+// Physical region descriptors, each one inside a 64KB region
+#define ATA_PRD_ENTRIES     4
+#define ATA_PRD_LAST        0x8000
+#define ATA_DMA_BOUNDARY    0x10000
+
+#define ATA_DRIVES          2
+
+/* One entry of the bus master's scatter list */
+typedef struct prd {
+    uint32_t addr;
+    uint16_t bytes;             // 0 means 64KB
+    uint16_t flags;
+} prd_t;
+
+/* A drive on the primary channel */
+typedef struct ata_drive {
+    uint32_t present;
+    uint32_t slave;
+    uint32_t dma;               // The drive and the controller both do DMA
+    uint32_t use_dma;           // Transfers go through the bus master when they can
+    block_device_t *dev;
+    block_request_t *req;       // Being worked on or waiting for the channel
+    uint32_t sector;            // Next sector the request moves
+    uint32_t left;              // Sectors the request still moves
+    uint8_t *buf;               // Where they go
+    uint32_t chunk;             // Sectors in the command on the channel
+    uint32_t chunk_left;        // Of those, still to go through the data port
+} ata_drive_t;
+
+/* Finds the drives on the primary channel and registers them */
+void ata_init(void);
+/* Finishes the command on the channel, called from the IRQ14 handler */
+void ata_handler(void);
+/* Turns DMA off or back on for a drive, for comparing the two */
+int32_t ata_set_dma(block_device_t *dev, uint32_t enable);
+/* Says whether a drive's transfers use DMA */
+uint32_t ata_uses_dma(block_device_t *dev);
+
+#endif
@@ -0,0 +1,440 @@
+#include "bcache.h"
+
+#include "lib.h"
+#include "paging.h"
+#include "pit.h"
+
+static buffer_t buffers[NUM_BUFFERS];
+static uint32_t buffer_clock;
+static bcache_stats_t bcache_stats;
+
+// The flusher runs off the timer tick, never inside itself
+static uint32_t last_flush;
+static uint32_t flushing;
+
+/*
+ * write_back(buf)
+ *
+ * DESCRIPTION: Writes a dirty buffer to its device. Called with
+ *              interrupts off, they come back on while waiting for a
+ *              driver that completes from its interrupt handler.
+ *
+ * INPUTS: 	buf - a dirty buffer nobody is transferring
+ * OUTPUTS: none
+ *
+ * RETURNS: -1 if the device failed, 0 otherwise
+ * SIDE EFFECTS: the buffer is busy until the write is done
+ */
+static int32_t write_back(buffer_t *buf) {
+    uint32_t per_buffer = BUFFER_SIZE / buf->dev->block_size;
+    int32_t status;
+
+    // Writes into the buffer while it is out redirty it
+    buf->flags = (buf->flags | BUFFER_BUSY) & ~BUFFER_DIRTY;
+    status = block_transfer(buf->dev, buf->block * per_buffer, per_buffer, buf->data, 1);
+    buf->flags &= ~BUFFER_BUSY;
+    if (status) {
+        buf->flags |= BUFFER_DIRTY;
+        return -1;
+    }
+
+    bcache_stats.writebacks++;
+    return 0;
+}
+
+/*
+ * wait_buffer(buf)
+ *
+ * DESCRIPTION: Sleeps until a transfer using a buffer is over. Called
+ *              with interrupts off.
+ *
+ * INPUTS: 	buf - a busy buffer
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: halts with interrupts on until then
+ */
+static void wait_buffer(buffer_t *buf) {
+    while (buf->flags & BUFFER_BUSY) {
+        asm volatile ("sti; hlt; cli" : : : "memory");
+    }
+}
+
+/*
+ * get_buffer(dev, block, fill)
+ *
+ * DESCRIPTION: Finds the buffer for a block, or takes over the least
+ *              recently used one nobody holds, writing it back first if
+ *              it is dirty
+ *
+ * INPUTS: 	dev - the device
+ *          block - block number in BUFFER_SIZE units
+ *          fill - 1 to read the block in on a miss
+ * OUTPUTS: none
+ *
+ * RETURNS: the buffer with a reference taken, or NULL if every buffer is
+ *          held, the pool is out of frames or the device failed
+ * SIDE EFFECTS: may read and write the device
+ */
+static buffer_t *get_buffer(block_device_t *dev, uint32_t block, uint32_t fill) {
+    uint32_t per_buffer = BUFFER_SIZE / dev->block_size;
+    uint32_t flags;
+    uint32_t i;
+
+    if (block >= dev->num_blocks / per_buffer) {
+        return NULL;
+    }
+
+    cli_and_save(flags);
+    for (;;) {
+        buffer_t *victim = NULL;
+        buffer_t *found = NULL;
+
+        for (i = 0; i < NUM_BUFFERS; i++) {
+            buffer_t *buf = &buffers[i];
+            if (buf->dev == dev && buf->block == block && (buf->flags & (BUFFER_VALID | BUFFER_BUSY))) {
+                found = buf;
+                break;
+            }
+
+            if (buf->refs == 0 && !(buf->flags & BUFFER_BUSY)
+                && (victim == NULL || buf->last_used < victim->last_used)) {
+                victim = buf;
+            }
+        }
+
+        if (found != NULL) {
+            if (found->flags & BUFFER_BUSY) {
+                // Being read in or written out, look again once it is done
+                wait_buffer(found);
+                continue;
+            }
+
+            found->refs++;
+            found->last_used = ++buffer_clock;
+            bcache_stats.hits++;
+            restore_flags(flags);
+            return found;
+        }
+
+        if (victim == NULL) {
+            break;
+        }
+
+        if (victim->flags & BUFFER_DIRTY) {
+            // Anything can happen while the write is out, so start over
+            if (write_back(victim)) {
+                break;
+            }
+            continue;
+        }
+
+        if (victim->data == NULL && (victim->data = (uint8_t *) alloc_frame()) == NULL) {
+            break;
+        }
+
+        victim->dev = dev;
+        victim->block = block;
+        victim->refs = 1;
+        victim->last_used = ++buffer_clock;
+        bcache_stats.misses++;
+
+        if (fill) {
+            victim->flags = BUFFER_BUSY;
+            if (block_transfer(dev, block * per_buffer, per_buffer, victim->data, 0)) {
+                victim->flags = 0;
+                victim->refs = 0;
+                victim->dev = NULL;
+                break;
+            }
+        }
+
+        victim->flags = BUFFER_VALID;
+        restore_flags(flags);
+        return victim;
+    }
+
+    restore_flags(flags);
+    return NULL;
+}
+
+/*
+ * readahead_done(req)
+ *
+ * DESCRIPTION: Completion of a read ahead. The buffer becomes valid, or
+ *              free again if the device failed.
+ *
+ * INPUTS: 	req - the buffer's request
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: runs from block_complete() with interrupts off
+ */
+static void readahead_done(block_request_t *req) {
+    buffer_t *buf = (buffer_t *) req->owner;
+
+    if (req->status == 0) {
+        buf->flags = BUFFER_VALID;
+    } else {
+        buf->flags = 0;
+        buf->dev = NULL;
+        buf->last_used = 0;
+    }
+}
+
+/*
+ * read_ahead(dev, block)
+ *
+ * DESCRIPTION: Starts reading the BCACHE_READAHEAD buffers after a block
+ *              that are not cached yet, without waiting for them. Only
+ *              buffers that can be taken without a write-back are used,
+ *              so this never blocks. Called with interrupts off.
+ *
+ * INPUTS: 	dev - the device
+ *          block - block just read, in BUFFER_SIZE units
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: submits reads, the buffers are busy until they finish
+ */
+static void read_ahead(block_device_t *dev, uint32_t block) {
+    uint32_t per_buffer = BUFFER_SIZE / dev->block_size;
+    uint32_t limit = dev->num_blocks / per_buffer;
+    uint32_t next;
+    uint32_t i;
+
+    for (next = block + 1; next <= block + BCACHE_READAHEAD && next < limit; next++) {
+        buffer_t *victim = NULL;
+        uint32_t cached = 0;
+
+        for (i = 0; i < NUM_BUFFERS; i++) {
+            buffer_t *buf = &buffers[i];
+            if (buf->dev == dev && buf->block == next && (buf->flags & (BUFFER_VALID | BUFFER_BUSY))) {
+                cached = 1;
+                break;
+            }
+
+            if (buf->refs == 0 && !(buf->flags & (BUFFER_BUSY | BUFFER_DIRTY))
+                && (victim == NULL || buf->last_used < victim->last_used)) {
+                victim = buf;
+            }
+        }
+
+        if (cached) {
+            continue;
+        }
+
+        if (victim == NULL || (victim->data == NULL && (victim->data = (uint8_t *) alloc_frame()) == NULL)) {
+            return;
+        }
+
+        victim->dev = dev;
+        victim->block = next;
+        victim->flags = BUFFER_BUSY;
+        victim->last_used = ++buffer_clock;
+        victim->req.dev = dev;
+        victim->req.block = next * per_buffer;
+        victim->req.count = per_buffer;
+        victim->req.buf = victim->data;
+        victim->req.write = 0;
+        victim->req.done = readahead_done;
+        victim->req.owner = victim;
+        bcache_stats.readaheads++;
+        block_submit(&victim->req);
+    }
+}
+
+/*
+ * bread(dev, block)
+ *
+ * DESCRIPTION: Gets a buffer holding a block of a device, reading it in
+ *              if it is not cached. Reading the block after the last one
+ *              read also starts reading ahead of it.
+ *
+ * INPUTS: 	dev - the device
+ *          block - block number in BUFFER_SIZE units
+ * OUTPUTS: none
+ *
+ * RETURNS: the buffer, release it with brelse(); NULL on failure
+ * SIDE EFFECTS: may read and write the device
+ */
+buffer_t *bread(block_device_t *dev, uint32_t block) {
+    buffer_t *buf = get_buffer(dev, block, 1);
+    uint32_t flags;
+
+    if (buf != NULL) {
+        cli_and_save(flags);
+        if (block == dev->next_read) {
+            read_ahead(dev, block);
+        }
+        dev->next_read = block + 1;
+        restore_flags(flags);
+    }
+    return buf;
+}
+
+/*
+ * bgrab(dev, block)
+ *
+ * DESCRIPTION: Gets a buffer for a block without reading it in, for a
+ *              caller that is going to overwrite all of it
+ *
+ * INPUTS: 	dev - the device
+ *          block - block number in BUFFER_SIZE units
+ * OUTPUTS: none
+ *
+ * RETURNS: the buffer, release it with brelse(); NULL on failure
+ * SIDE EFFECTS: may write the device
+ */
+buffer_t *bgrab(block_device_t *dev, uint32_t block) {
+    return get_buffer(dev, block, 0);
+}
+
+/*
+ * bdirty(buf)
+ *
+ * DESCRIPTION: Marks a held buffer as changed. It reaches the device when
+ *              it is evicted, synced or picked up by the flusher.
+ *
+ * INPUTS: 	buf - a buffer from bread() or bgrab()
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: none
+ */
+void bdirty(buffer_t *buf) {
+    buf->flags |= BUFFER_DIRTY;
+}
+
+/*
+ * brelse(buf)
+ *
+ * DESCRIPTION: Drops a reference taken by bread() or bgrab()
+ *
+ * INPUTS: 	buf - the buffer
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: the buffer may be reused once nobody holds it
+ */
+void brelse(buffer_t *buf) {
+    uint32_t flags;
+    cli_and_save(flags);
+    buf->refs--;
+    restore_flags(flags);
+}
+
+/*
+ * bcache_sync(dev)
+ *
+ * DESCRIPTION: Writes back every dirty buffer of a device
+ *
+ * INPUTS: 	dev - the device, NULL for all of them
+ * OUTPUTS: none
+ *
+ * RETURNS: -1 if a write failed, 0 otherwise
+ * SIDE EFFECTS: writes the device
+ */
+int32_t bcache_sync(block_device_t *dev) {
+    int32_t status = 0;
+    uint32_t flags;
+    uint32_t i;
+
+    cli_and_save(flags);
+    for (i = 0; i < NUM_BUFFERS; i++) {
+        buffer_t *buf = &buffers[i];
+        if (dev != NULL && buf->dev != dev) {
+            continue;
+        }
+
+        wait_buffer(buf);
+        if ((buf->flags & BUFFER_DIRTY) && write_back(buf)) {
+            status = -1;
+        }
+    }
+    restore_flags(flags);
+    return status;
+}
+
+/*
+ * bcache_invalidate(dev)
+ *
+ * DESCRIPTION: Syncs a device, then forgets its buffers nobody holds so
+ *              the next reads go to the device
+ *
+ * INPUTS: 	dev - the device
+ * OUTPUTS: none
+ *
+ * RETURNS: -1 if a write failed, 0 otherwise
+ * SIDE EFFECTS: writes the device
+ */
+int32_t bcache_invalidate(block_device_t *dev) {
+    uint32_t flags;
+    uint32_t i;
+
+    if (bcache_sync(dev)) {
+        return -1;
+    }
+
+    cli_and_save(flags);
+    for (i = 0; i < NUM_BUFFERS; i++) {
+        buffer_t *buf = &buffers[i];
+        if (buf->dev == dev && buf->refs == 0 && buf->flags == BUFFER_VALID) {
+            buf->flags = 0;
+            buf->dev = NULL;
+            buf->last_used = 0;
+        }
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ * bcache_flush_tick()
+ *
+ * DESCRIPTION: The background flusher. Called on every timer tick after
+ *              the PIC is acknowledged; every BCACHE_FLUSH_MS it writes
+ *              back dirty buffers nobody holds with interrupts on, so
+ *              drivers can complete and the clock keeps running while
+ *              the interrupted code waits.
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: writes devices, enables interrupts while it runs
+ */
+void bcache_flush_tick(void) {
+    uint32_t flags;
+    uint32_t i;
+
+    if (flushing || pit_ticks - last_flush < BCACHE_FLUSH_MS) {
+        return;
+    }
+
+    flushing = 1;
+    last_flush = pit_ticks;
+    bcache_stats.flushes++;
+    sti();
+
+    for (i = 0; i < NUM_BUFFERS; i++) {
+        buffer_t *buf = &buffers[i];
+        cli_and_save(flags);
+        // Held buffers may be half written, they go next time
+        if ((buf->flags & (BUFFER_DIRTY | BUFFER_BUSY)) == BUFFER_DIRTY && buf->refs == 0) {
+            write_back(buf);
+        }
+        restore_flags(flags);
+    }
+
+    cli();
+    flushing = 0;
+}
+
+/*
+ * bcache_get_stats(stats)
+ *
+ * DESCRIPTION: Reports how the buffer cache is doing
+ *
+ * INPUTS: 	none
+ * OUTPUTS: stats - hits, misses and write counts since boot
+ *
+ * SIDE EFFECTS: none
+ */
+void bcache_get_stats(bcache_stats_t *stats) {
+    *stats = bcache_stats;
+}
@@ -0,0 +1,52 @@
+#ifndef BCACHE_H_
+#define BCACHE_H_
+
+#include "types.h"
+#include "block.h"
+
+// Bytes cached per buffer, a multiple of every device's block size
+#define BUFFER_SIZE         4096
+#define NUM_BUFFERS         64
+
+// Buffer flags
+#define BUFFER_VALID        0x1     // data matches the device or is newer
+#define BUFFER_DIRTY        0x2     // data is newer than the device
+#define BUFFER_BUSY         0x4     // a transfer is using data
+
+// How often the flusher writes dirty buffers back
+#define BCACHE_FLUSH_MS     1000
+
+// Buffers read ahead of a sequential reader
+#define BCACHE_READAHEAD    4
+
+/* One cached BUFFER_SIZE piece of a device, data is a frame from the pool */
+typedef struct buffer {
+    block_device_t *dev;
+    uint32_t block;             // In BUFFER_SIZE units
+    uint32_t flags;
+    uint32_t refs;              // Holders between bread() and brelse()
+    uint32_t last_used;         // LRU clock value, 0 if never used
+    uint8_t *data;
+    block_request_t req;        // For reads ahead, which nobody waits on
+} buffer_t;
+
+typedef struct bcache_stats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t writebacks;        // Buffers written to their device
+    uint32_t flushes;           // Times the flusher ran
+    uint32_t readaheads;        // Buffers read before anyone asked
+} bcache_stats_t;
+
+/* Gets a buffer holding a block, reading it in on a miss */
+buffer_t *bread(block_device_t *dev, uint32_t block);
+/* Gets a buffer for a block the caller is about to overwrite entirely */
+buffer_t *bgrab(block_device_t *dev, uint32_t block);
+void bdirty(buffer_t *buf);
+void brelse(buffer_t *buf);
+int32_t bcache_sync(block_device_t *dev);
+int32_t bcache_invalidate(block_device_t *dev);
+void bcache_flush_tick(void);
+void bcache_get_stats(bcache_stats_t *stats);
+
+#endif
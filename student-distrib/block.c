@@ -0,0 +1,568 @@
+#include "block.h"
+
+#include "bcache.h"
+#include "lib.h"
+#include "mount.h"
+#include "printk.h"
+#include "serial.h"
+#include "syscalls.h"
+
+static block_device_t block_devices[MAX_BLOCK_DEVICES];
+
+/*
+ * register_block_device(name, block_size, num_blocks, ops, driver)
+ *
+ * DESCRIPTION: Adds a device to the block layer. It shows up as a file
+ *              of the same name under DEV_MOUNT.
+ *
+ * INPUTS: 	name - device name
+ *          block_size - bytes per device block, must divide BUFFER_SIZE
+ *          num_blocks - size of the device in blocks
+ *          ops - the driver's operations
+ *          driver - the driver's state for this device
+ * OUTPUTS: none
+ *
+ * RETURNS: the device, or NULL if the name is bad, taken or the table is full
+ * SIDE EFFECTS: none
+ */
+block_device_t *register_block_device(const int8_t *name, uint32_t block_size,
+                                      uint32_t num_blocks, const block_ops_t *ops, void *driver) {
+    block_device_t *slot = NULL;
+    uint32_t i;
+
+    if (strlen(name) >= BLOCK_NAME_LENGTH || block_size == 0 || BUFFER_SIZE % block_size
+        || find_block_device(name) != NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < MAX_BLOCK_DEVICES && slot == NULL; i++) {
+        if (!block_devices[i].in_use) {
+            slot = &block_devices[i];
+        }
+    }
+
+    if (slot != NULL) {
+        memset(slot, 0, sizeof(block_device_t));
+        strncpy(slot->name, name, BLOCK_NAME_LENGTH);
+        slot->block_size = block_size;
+        slot->num_blocks = num_blocks;
+        slot->ops = ops;
+        slot->driver = driver;
+        slot->in_use = 1;
+    }
+    return slot;
+}
+
+/*
+ * get_block_device(index)
+ *
+ * DESCRIPTION: Walks the device table
+ *
+ * INPUTS: 	index - slot number
+ * OUTPUTS: none
+ *
+ * RETURNS: the device, or NULL if the slot is empty or out of range
+ * SIDE EFFECTS: none
+ */
+block_device_t *get_block_device(uint32_t index) {
+    if (index >= MAX_BLOCK_DEVICES || !block_devices[index].in_use) {
+        return NULL;
+    }
+
+    return &block_devices[index];
+}
+
+/*
+ * find_block_device(name)
+ *
+ * DESCRIPTION: Looks up a device by name
+ *
+ * INPUTS: 	name - device name
+ * OUTPUTS: none
+ *
+ * RETURNS: the device, or NULL if there is none
+ * SIDE EFFECTS: none
+ */
+block_device_t *find_block_device(const int8_t *name) {
+    uint32_t i;
+    for (i = 0; i < MAX_BLOCK_DEVICES; i++) {
+        if (block_devices[i].in_use && !strncmp(block_devices[i].name, name, BLOCK_NAME_LENGTH)) {
+            return &block_devices[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * start_queue(dev)
+ *
+ * DESCRIPTION: Hands the head request to the driver whenever it is idle.
+ *              Drivers that finish inside start come back through
+ *              block_complete(), which lands here again, so the loop
+ *              keeps that from recursing. Called with interrupts off.
+ *
+ * INPUTS: 	dev - the device
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: starts transfers
+ */
+static void start_queue(block_device_t *dev) {
+    if (dev->starting) {
+        return;
+    }
+
+    dev->starting = 1;
+    while (!dev->busy && dev->head != NULL) {
+        dev->busy = 1;
+        dev->ops->start(dev, dev->head);
+    }
+    dev->starting = 0;
+}
+
+/*
+ * block_submit(req)
+ *
+ * DESCRIPTION: Queues a request behind any the device is already working
+ *              on. Requests outside the device fail right away, without
+ *              running done.
+ *
+ * INPUTS: 	req - the request, dev, block, count, buf, write and done
+ *                filled in
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: may start the transfer
+ */
+void block_submit(block_request_t *req) {
+    block_device_t *dev = req->dev;
+    uint32_t flags;
+
+    if (req->count == 0 || req->block >= dev->num_blocks || req->count > dev->num_blocks - req->block) {
+        req->status = -1;
+        return;
+    }
+
+    req->status = BLOCK_PENDING;
+    req->next = NULL;
+
+    cli_and_save(flags);
+    if (dev->head == NULL) {
+        dev->head = req;
+    } else {
+        dev->tail->next = req;
+    }
+    dev->tail = req;
+    start_queue(dev);
+    restore_flags(flags);
+}
+
+/*
+ * block_complete(dev, status)
+ *
+ * DESCRIPTION: Called by a driver when the head request is done. Wakes
+ *              its submitter or runs its done callback, then starts the
+ *              next one.
+ *
+ * INPUTS: 	dev - the device
+ *          status - 0 on success, -1 on an error
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: must run with interrupts off, as it does in a handler
+ */
+void block_complete(block_device_t *dev, int32_t status) {
+    block_request_t *req = dev->head;
+
+    dev->head = req->next;
+    if (dev->head == NULL) {
+        dev->tail = NULL;
+    }
+    dev->busy = 0;
+
+    if (status == 0) {
+        if (req->write) {
+            dev->writes += req->count;
+        } else {
+            dev->reads += req->count;
+        }
+    }
+
+    req->status = status;
+    if (req->done != NULL) {
+        req->done(req);
+    }
+    start_queue(dev);
+}
+
+/*
+ * block_wait(req)
+ *
+ * DESCRIPTION: Sleeps until a submitted request is done. Interrupts are
+ *              on while halted so the driver can complete it.
+ *
+ * INPUTS: 	req - a submitted request
+ * OUTPUTS: none
+ *
+ * RETURNS: 0 on success, -1 on an error
+ * SIDE EFFECTS: none
+ */
+int32_t block_wait(block_request_t *req) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    while (req->status == BLOCK_PENDING) {
+        // sti holds off interrupts for one instruction, so none is missed before hlt
+        asm volatile ("sti; hlt; cli" : : : "memory");
+    }
+    restore_flags(flags);
+    return req->status;
+}
+
+/*
+ * block_transfer(dev, block, count, buf, write)
+ *
+ * DESCRIPTION: Moves blocks to or from a device and waits for it,
+ *              bypassing the buffer cache
+ *
+ * INPUTS: 	dev - the device
+ *          block - first device block
+ *          count - device blocks
+ *          buf - data
+ *          write - 1 to write, 0 to read
+ * OUTPUTS: none
+ *
+ * RETURNS: 0 on success, -1 on an error
+ * SIDE EFFECTS: none
+ */
+int32_t block_transfer(block_device_t *dev, uint32_t block, uint32_t count, uint8_t *buf, uint32_t write) {
+    block_request_t req;
+    req.dev = dev;
+    req.block = block;
+    req.count = count;
+    req.buf = buf;
+    req.write = write;
+    req.done = NULL;
+    block_submit(&req);
+    return block_wait(&req);
+}
+
+/*
+ * dev_name(filename)
+ *
+ * DESCRIPTION: Resolves a path through the mount table
+ *
+ * INPUTS: 	filename - full path
+ * OUTPUTS: none
+ *
+ * RETURNS: the device name, "." for the directory, or NULL if the path
+ *          is not under DEV_MOUNT
+ * SIDE EFFECTS: none
+ */
+static const int8_t *dev_name(const int8_t *filename) {
+    const int8_t *name;
+    mount_t *mount = resolve_path(filename, &name);
+    if (mount == NULL || mount->type != MOUNT_DEV) {
+        return NULL;
+    }
+
+    return name;
+}
+
+/*
+ * fill_stat(index, buf)
+ *
+ * DESCRIPTION: Describes a device, the serial port, the kernel log, or
+ *              the directory for any other index past the table
+ *
+ * INPUTS: 	index - device slot
+ * OUTPUTS: buf - type, slot, size and BUFFER_SIZE blocks
+ *
+ * SIDE EFFECTS: none
+ */
+static void fill_stat(uint32_t index, stat_t *buf) {
+    block_device_t *dev = get_block_device(index);
+
+    buf->inode_num = index;
+    if (dev == NULL) {
+        buf->file_type = index == DEV_SERIAL_INODE || index == DEV_KMSG_INODE ? tty : dir;
+        buf->length = 0;
+        buf->num_blocks = 0;
+        return;
+    }
+
+    buf->file_type = block;
+    buf->length = dev->num_blocks * dev->block_size;
+    buf->num_blocks = buf->length / BUFFER_SIZE;
+}
+
+/*
+ * dev_read_dentry(filename, dentry)
+ *
+ * DESCRIPTION: Looks up a device file. The inode number is the device's
+ *              slot, the directory itself is DEV_DIR_INODE, the serial
+ *              port, a tty, DEV_SERIAL_INODE, and the kernel log, read
+ *              like one, DEV_KMSG_INODE.
+ *
+ * INPUTS: 	filename - full path
+ * OUTPUTS: dentry - the entry
+ *
+ * RETURNS: -1 if there is no such device, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+int32_t dev_read_dentry(const int8_t *filename, dentry_t *dentry) {
+    const int8_t *name = dev_name(filename);
+    uint32_t i;
+
+    if (name == NULL) {
+        return -1;
+    }
+
+    strncpy(dentry->file_name, name, FILE_NAME_LENGTH);
+    if (!strncmp(name, ".", 2)) {
+        dentry->file_type = dir;
+        dentry->inode_num = DEV_DIR_INODE;
+        return 0;
+    }
+
+    if (serial_present() && !strncmp(name, SERIAL_NAME, sizeof(SERIAL_NAME))) {
+        dentry->file_type = tty;
+        dentry->inode_num = DEV_SERIAL_INODE;
+        return 0;
+    }
+
+    if (!strncmp(name, KMSG_NAME, sizeof(KMSG_NAME))) {
+        dentry->file_type = tty;
+        dentry->inode_num = DEV_KMSG_INODE;
+        return 0;
+    }
+
+    for (i = 0; i < MAX_BLOCK_DEVICES; i++) {
+        if (block_devices[i].in_use && !strncmp(block_devices[i].name, name, BLOCK_NAME_LENGTH)) {
+            dentry->file_type = block;
+            dentry->inode_num = i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * dev_stat_name(filename, buf)
+ *
+ * DESCRIPTION: Gets information about a device file by path
+ *
+ * INPUTS: 	filename - full path
+ * OUTPUTS: buf - the information
+ *
+ * RETURNS: -1 if there is no such device, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+int32_t dev_stat_name(const int8_t *filename, stat_t *buf) {
+    dentry_t dentry;
+    if (dev_read_dentry(filename, &dentry)) {
+        return -1;
+    }
+
+    fill_stat(dentry.inode_num, buf);
+    return 0;
+}
+
+/*
+ * dev_dir_open(filename)
+ *
+ * DESCRIPTION: Opens the device directory
+ *
+ * INPUTS: 	filename - ignored
+ * OUTPUTS: none
+ *
+ * RETURNS: 0
+ * SIDE EFFECTS: none
+ */
+int32_t dev_dir_open(const int8_t *filename) {
+    return 0;
+}
+
+/*
+ * dev_dir_read(fd, buf, nbytes)
+ *
+ * DESCRIPTION: Reads the next device name, the serial port and then the
+ *              kernel log coming after the block devices
+ *
+ * INPUTS: 	fd - the open directory
+ *          nbytes - most bytes to copy
+ * OUTPUTS: buf - the name
+ *
+ * RETURNS: length of the name, 0 after the last one
+ * SIDE EFFECTS: advances the directory position
+ */
+int32_t dev_dir_read(int32_t fd, void *buf, int32_t nbytes) {
+    file_t *file = get_file(fd);
+
+    while (file->pos < MAX_BLOCK_DEVICES && !block_devices[file->pos].in_use) {
+        file->pos++;
+    }
+
+    if (file->pos == MAX_BLOCK_DEVICES) {
+        file->pos++;
+        if (serial_present()) {
+            strncpy((int8_t *) buf, SERIAL_NAME, nbytes > BLOCK_NAME_LENGTH ? BLOCK_NAME_LENGTH : nbytes);
+            return strlen(SERIAL_NAME);
+        }
+    }
+
+    if (file->pos == MAX_BLOCK_DEVICES + 1) {
+        file->pos++;
+        strncpy((int8_t *) buf, KMSG_NAME, nbytes > BLOCK_NAME_LENGTH ? BLOCK_NAME_LENGTH : nbytes);
+        return strlen(KMSG_NAME);
+    }
+
+    if (file->pos >= MAX_BLOCK_DEVICES) {
+        return 0;
+    }
+
+    int8_t *name = block_devices[file->pos].name;
+    strncpy((int8_t *) buf, name, nbytes > BLOCK_NAME_LENGTH ? BLOCK_NAME_LENGTH : nbytes);
+    file->pos++;
+    return strlen(name);
+}
+
+/*
+ * blockdev_open(filename)
+ *
+ * DESCRIPTION: Opens a device file, the lookup already found the device
+ *
+ * INPUTS: 	filename - ignored
+ * OUTPUTS: none
+ *
+ * RETURNS: 0
+ * SIDE EFFECTS: none
+ */
+int32_t blockdev_open(const int8_t *filename) {
+    return 0;
+}
+
+/*
+ * blockdev_close(fd)
+ *
+ * DESCRIPTION: Closes a device file. Dirty buffers stay cached until
+ *              the flusher gets to them.
+ *
+ * INPUTS: 	fd - the open device
+ * OUTPUTS: none
+ *
+ * RETURNS: 0
+ * SIDE EFFECTS: none
+ */
+int32_t blockdev_close(int32_t fd) {
+    return 0;
+}
+
+/*
+ * blockdev_io(fd, buf, nbytes, write)
+ *
+ * DESCRIPTION: Moves bytes between a device and memory through the
+ *              buffer cache, starting at the file position. Whole
+ *              buffers being written are not read in first.
+ *
+ * INPUTS: 	fd - the open device
+ *          buf - data
+ *          nbytes - bytes to move
+ *          write - 1 to write, 0 to read
+ * OUTPUTS: none
+ *
+ * RETURNS: bytes moved, 0 at the end of the device, -1 on an error
+ *          before anything moved
+ * SIDE EFFECTS: advances the file position
+ */
+static int32_t blockdev_io(int32_t fd, uint8_t *buf, int32_t nbytes, uint32_t write) {
+    file_t *file = get_file(fd);
+    block_device_t *dev = get_block_device(file->inode);
+    int32_t done = 0;
+
+    if (dev == NULL || nbytes < 0) {
+        return -1;
+    }
+
+    uint32_t size = dev->num_blocks * dev->block_size;
+    while (done < nbytes && (uint32_t) file->pos < size) {
+        uint32_t offset = file->pos % BUFFER_SIZE;
+        uint32_t length = BUFFER_SIZE - offset;
+        if (length > (uint32_t) (nbytes - done)) {
+            length = nbytes - done;
+        }
+        if (length > size - file->pos) {
+            length = size - file->pos;
+        }
+
+        buffer_t *b;
+        if (write && length == BUFFER_SIZE) {
+            b = bgrab(dev, file->pos / BUFFER_SIZE);
+        } else {
+            b = bread(dev, file->pos / BUFFER_SIZE);
+        }
+        if (b == NULL) {
+            return done ? done : -1;
+        }
+
+        if (write) {
+            memcpy(b->data + offset, buf + done, length);
+            bdirty(b);
+        } else {
+            memcpy(buf + done, b->data + offset, length);
+        }
+        brelse(b);
+
+        done += length;
+        file->pos += length;
+    }
+
+    return done;
+}
+
+/*
+ * blockdev_read(fd, buf, nbytes)
+ *
+ * DESCRIPTION: Reads from a device file
+ *
+ * INPUTS: 	fd - the open device
+ *          nbytes - bytes to read
+ * OUTPUTS: buf - the data
+ *
+ * RETURNS: bytes read, 0 at the end of the device, -1 on an error
+ * SIDE EFFECTS: advances the file position
+ */
+int32_t blockdev_read(int32_t fd, void *buf, int32_t nbytes) {
+    return blockdev_io(fd, (uint8_t *) buf, nbytes, 0);
+}
+
+/*
+ * blockdev_write(fd, buf, nbytes)
+ *
+ * DESCRIPTION: Writes to a device file, the data is written back later
+ *
+ * INPUTS: 	fd - the open device
+ *          buf - the data
+ *          nbytes - bytes to write
+ * OUTPUTS: none
+ *
+ * RETURNS: bytes written, 0 at the end of the device, -1 on an error
+ * SIDE EFFECTS: advances the file position
+ */
+int32_t blockdev_write(int32_t fd, const void *buf, int32_t nbytes) {
+    return blockdev_io(fd, (uint8_t *) buf, nbytes, 1);
+}
+
+/*
+ * blockdev_stat(fd, buf)
+ *
+ * DESCRIPTION: Gets information about an open device file
+ *
+ * INPUTS: 	fd - the open device
+ * OUTPUTS: buf - the information
+ *
+ * RETURNS: 0
+ * SIDE EFFECTS: none
+ */
+int32_t blockdev_stat(int32_t fd, stat_t *buf) {
+    fill_stat(get_file(fd)->inode, buf);
+    return 0;
+}
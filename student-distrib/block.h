@@ -0,0 +1,85 @@
+#ifndef BLOCK_H_
+#define BLOCK_H_
+
+#include "types.h"
+#include "rofs.h"
+
+#define MAX_BLOCK_DEVICES   4
+#define BLOCK_NAME_LENGTH   16
+
+// Where block devices show up as files
+#define DEV_MOUNT           "dev"
+// Inode numbers under DEV_MOUNT past the device slots
+#define DEV_DIR_INODE       MAX_BLOCK_DEVICES
+#define DEV_SERIAL_INODE    (MAX_BLOCK_DEVICES + 1)
+#define DEV_KMSG_INODE      (MAX_BLOCK_DEVICES + 2)
+
+// Request status while the driver still owns it
+#define BLOCK_PENDING       1
+
+struct block_device;
+
+/*
+ * One transfer of whole device blocks. The submitter owns the memory and
+ * waits for status to leave BLOCK_PENDING: 0 when done, -1 on an error,
+ * or sets done to hear about it from block_complete() without waiting.
+ */
+typedef struct block_request {
+    struct block_device *dev;
+    uint32_t block;             // First device block
+    uint32_t count;             // Device blocks to move
+    uint8_t *buf;
+    uint32_t write;             // 1 to write buf to the device
+    volatile int32_t status;
+    void (*done) (struct block_request *req);  // Runs with interrupts off, or NULL
+    void *owner;                // For done
+    struct block_request *next; // Queue link
+} block_request_t;
+
+/*
+ * What a driver provides. start begins the request at the head of the
+ * queue and the driver calls block_complete() when it finishes, either
+ * right away or from its interrupt handler.
+ */
+typedef struct block_ops {
+    void (*start) (struct block_device *dev, block_request_t *req);
+} block_ops_t;
+
+typedef struct block_device {
+    int8_t name[BLOCK_NAME_LENGTH];
+    uint32_t in_use;
+    uint32_t block_size;        // Bytes per device block, divides BUFFER_SIZE
+    uint32_t num_blocks;
+    const block_ops_t *ops;
+    void *driver;               // Driver's own state
+    block_request_t *head;      // Request the driver is working on
+    block_request_t *tail;
+    uint32_t busy;              // The driver has the head request
+    uint32_t starting;          // Inside block_start_queue()
+    uint32_t next_read;         // Buffer after the last one bread() read
+    uint32_t reads;             // Device blocks moved, for the benchmarks
+    uint32_t writes;
+} block_device_t;
+
+block_device_t *register_block_device(const int8_t *name, uint32_t block_size,
+                                      uint32_t num_blocks, const block_ops_t *ops, void *driver);
+block_device_t *get_block_device(uint32_t index);
+block_device_t *find_block_device(const int8_t *name);
+
+void block_submit(block_request_t *req);
+void block_complete(block_device_t *dev, int32_t status);
+int32_t block_wait(block_request_t *req);
+int32_t block_transfer(block_device_t *dev, uint32_t block, uint32_t count, uint8_t *buf, uint32_t write);
+
+// Block devices as files under DEV_MOUNT
+int32_t dev_read_dentry(const int8_t *filename, dentry_t *dentry);
+int32_t dev_stat_name(const int8_t *filename, stat_t *buf);
+int32_t dev_dir_open(const int8_t *filename);
+int32_t dev_dir_read(int32_t fd, void *buf, int32_t nbytes);
+int32_t blockdev_open(const int8_t *filename);
+int32_t blockdev_close(int32_t fd);
+int32_t blockdev_read(int32_t fd, void *buf, int32_t nbytes);
+int32_t blockdev_write(int32_t fd, const void *buf, int32_t nbytes);
+int32_t blockdev_stat(int32_t fd, stat_t *buf);
+
+#endif
@@ -0,0 +1,157 @@
+#include "crc32c.h"
+
+#include "lib.h"
+
+// table[k][b] is the CRC of byte b followed by k zero bytes
+static uint32_t table[8][256];
+static uint32_t has_sse42;
+
+/*
+ * crc32c_init()
+ *
+ * DESCRIPTION: Builds the slice-by-8 tables and asks CPUID whether the
+ *              SSE4.2 crc32 instruction is there. Must run before the
+ *              first crc32c() call.
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: fills the tables
+ */
+void crc32c_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t b, k;
+
+    for (b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0);
+        }
+        table[0][b] = crc;
+    }
+
+    for (b = 0; b < 256; b++) {
+        for (k = 1; k < 8; k++) {
+            table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xFF];
+        }
+    }
+
+    asm volatile ("cpuid"
+                  : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                  : "a" (1));
+    has_sse42 = (ecx & CPUID_SSE42) != 0;
+}
+
+/*
+ * crc32c_slice8(crc, buf, length)
+ *
+ * DESCRIPTION: Table driven CRC32C that folds in eight bytes per step
+ *
+ * INPUTS: 	crc - CRC of the data before buf, 0 to start
+ *          buf - data
+ *          length - bytes of data
+ * OUTPUTS: none
+ *
+ * RETURNS: CRC of everything so far
+ * SIDE EFFECTS: none
+ */
+uint32_t crc32c_slice8(uint32_t crc, const uint8_t *buf, uint32_t length) {
+    crc = ~crc;
+
+    // Single bytes until buf is aligned for the word loads
+    while (length > 0 && ((uint32_t) buf & 3)) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *buf++) & 0xFF];
+        length--;
+    }
+
+    while (length >= 8) {
+        uint32_t low = *(const uint32_t *) buf ^ crc;
+        uint32_t high = *(const uint32_t *) (buf + 4);
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF]
+            ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24]
+            ^ table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF]
+            ^ table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+        buf += 8;
+        length -= 8;
+    }
+
+    while (length > 0) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *buf++) & 0xFF];
+        length--;
+    }
+
+    return ~crc;
+}
+
+/*
+ * crc32c_sse42(crc, buf, length)
+ *
+ * DESCRIPTION: CRC32C using the SSE4.2 crc32 instruction, four bytes at
+ *              a time. Only call it when crc32c_has_sse42() says so.
+ *
+ * INPUTS: 	crc - CRC of the data before buf, 0 to start
+ *          buf - data
+ *          length - bytes of data
+ * OUTPUTS: none
+ *
+ * RETURNS: CRC of everything so far
+ * SIDE EFFECTS: none
+ */
+uint32_t crc32c_sse42(uint32_t crc, const uint8_t *buf, uint32_t length) {
+    crc = ~crc;
+
+    while (length > 0 && ((uint32_t) buf & 3)) {
+        asm ("crc32b %1, %0" : "+r" (crc) : "rm" (*buf));
+        buf++;
+        length--;
+    }
+
+    while (length >= 4) {
+        asm ("crc32l %1, %0" : "+r" (crc) : "rm" (*(const uint32_t *) buf));
+        buf += 4;
+        length -= 4;
+    }
+
+    while (length > 0) {
+        asm ("crc32b %1, %0" : "+r" (crc) : "rm" (*buf));
+        buf++;
+        length--;
+    }
+
+    return ~crc;
+}
+
+/*
+ * crc32c_has_sse42()
+ *
+ * DESCRIPTION: Says whether crc32c() uses the crc32 instruction
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * RETURNS: 1 with SSE4.2, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+uint32_t crc32c_has_sse42(void) {
+    return has_sse42;
+}
+
+/*
+ * crc32c(crc, buf, length)
+ *
+ * DESCRIPTION: CRC32C with whichever implementation the CPU runs fastest
+ *
+ * INPUTS: 	crc - CRC of the data before buf, 0 to start
+ *          buf - data
+ *          length - bytes of data
+ * OUTPUTS: none
+ *
+ * RETURNS: CRC of everything so far
+ * SIDE EFFECTS: none
+ */
+uint32_t crc32c(uint32_t crc, const uint8_t *buf, uint32_t length) {
+    if (has_sse42) {
+        return crc32c_sse42(crc, buf, length);
+    }
+    return crc32c_slice8(crc, buf, length);
+}
@@ -0,0 +1,21 @@
+#ifndef CRC32C_H_
+#define CRC32C_H_
+
+#include "types.h"
+
+// Castagnoli polynomial, bit reversed
+#define CRC32C_POLY     0x82F63B78
+
+// CPUID leaf 1 ECX bit for the SSE4.2 crc32 instruction
+#define CPUID_SSE42     0x00100000
+
+/* Builds the tables and picks the fastest implementation */
+void crc32c_init(void);
+/* Extends a CRC32C, start with 0 */
+uint32_t crc32c(uint32_t crc, const uint8_t *buf, uint32_t length);
+/* The two implementations, for benchmarking */
+uint32_t crc32c_slice8(uint32_t crc, const uint8_t *buf, uint32_t length);
+uint32_t crc32c_sse42(uint32_t crc, const uint8_t *buf, uint32_t length);
+uint32_t crc32c_has_sse42(void);
+
+#endif
@@ -0,0 +1,335 @@
+/* format.c - printf-style formatting for the kernel and the user library
+ * vim:ts=4 noexpandtab
+ */
+
+#include "format.h"
+
+/* Flags a conversion can have */
+#define FMT_LEFT	0x1		/* '-': pad on the right */
+#define FMT_ZERO	0x2		/* '0': pad numbers with zeros */
+#define FMT_ALT		0x4		/* '#': see format_into */
+
+/*
+* void emit(format_buf_t* fb, char c);
+*   Inputs: format_buf_t* fb = where the text goes
+*			char c = next character
+*   Return Value: none
+*	Function: Adds a character, flushing the buffer first if it is full
+*			  and after it if it is a line break and fb flushes lines
+*/
+
+static void
+emit(format_buf_t* fb, char c)
+{
+	if (fb->len == fb->size && fb->flush != 0) {
+		fb->flush(fb);
+	}
+	if (fb->len < fb->size) {
+		fb->buf[fb->len++] = c;
+	}
+	fb->total++;
+
+	if (c == '\n' && fb->line_flush && fb->flush != 0) {
+		fb->flush(fb);
+	}
+}
+
+/*
+* void pad(format_buf_t* fb, char c, int n);
+*   Inputs: format_buf_t* fb = where the text goes
+*			char c = padding character
+*			int n = how many, nothing if not positive
+*   Return Value: none
+*	Function: Adds padding
+*/
+
+static void
+pad(format_buf_t* fb, char c, int n)
+{
+	for (; n > 0; n--) {
+		emit(fb, c);
+	}
+}
+
+/*
+* void emit_string(format_buf_t* fb, const char* s, int flags, int width, int precision);
+*   Inputs: format_buf_t* fb = where the text goes
+*			const char* s = the string, "(null)" if NULL
+*			int flags, width = from the conversion
+*			int precision = most characters to take, -1 for all
+*   Return Value: none
+*	Function: Adds a string padded with spaces to width
+*/
+
+static void
+emit_string(format_buf_t* fb, const char* s, int flags, int width, int precision)
+{
+	int n;
+
+	if (s == 0) {
+		s = "(null)";
+	}
+	for (n = 0; s[n] != '\0' && (precision < 0 || n < precision); n++);
+
+	if (!(flags & FMT_LEFT)) {
+		pad(fb, ' ', width - n);
+	}
+	for (; n > 0; n--) {
+		emit(fb, *s++);
+	}
+	if (flags & FMT_LEFT) {
+		pad(fb, ' ', width - n);
+	}
+}
+
+/*
+* void emit_number(format_buf_t* fb, unsigned int value, const char* prefix,
+*				   unsigned int base, int upper, int flags, int width, int precision);
+*   Inputs: format_buf_t* fb = where the text goes
+*			unsigned int value = magnitude of the number
+*			const char* prefix = sign or "0x" to go before the digits
+*			unsigned int base = 8, 10 or 16
+*			int upper = 1 for uppercase hex digits
+*			int flags, width = from the conversion
+*			int precision = fewest digits, -1 for at least one
+*   Return Value: none
+*	Function: Adds a number, padded to width with spaces, or with zeros
+*			  between the prefix and the digits for '0' without a
+*			  precision
+*/
+
+static void
+emit_number(format_buf_t* fb, unsigned int value, const char* prefix,
+			unsigned int base, int upper, int flags, int width, int precision)
+{
+	const char* lookup = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	char digits[32];
+	int num_digits = 0;
+	int zeros;
+	int length;
+	int i;
+
+	/* A precision of 0 prints nothing for 0 */
+	while (value != 0 || (num_digits == 0 && precision != 0)) {
+		digits[num_digits++] = lookup[value % base];
+		value /= base;
+	}
+
+	zeros = precision > num_digits ? precision - num_digits : 0;
+	for (i = 0; prefix[i] != '\0'; i++);
+	length = i + zeros + num_digits;
+
+	if ((flags & (FMT_ZERO | FMT_LEFT)) == FMT_ZERO && precision < 0 && width > length) {
+		zeros += width - length;
+		length = width;
+	}
+
+	if (!(flags & FMT_LEFT)) {
+		pad(fb, ' ', width - length);
+	}
+	for (; *prefix != '\0'; prefix++) {
+		emit(fb, *prefix);
+	}
+	pad(fb, '0', zeros);
+	while (num_digits > 0) {
+		emit(fb, digits[--num_digits]);
+	}
+	if (flags & FMT_LEFT) {
+		pad(fb, ' ', width - length);
+	}
+}
+
+/*
+* int format_into(format_buf_t* fb, const char* format, va_list args);
+*   Inputs: format_buf_t* fb = where the text goes
+*			const char* format = format string
+*			va_list args = the arguments
+*   Return Value: number of characters formatted, even those dropped
+*	Function: Formats like the C library's printf. A conversion is '%',
+*			  then any of the flags '-' (pad on the right), '0' (pad
+*			  numbers with zeros) and '#', a width, a precision after
+*			  '.', either of which can be '*' to take it from the
+*			  arguments, then one of:
+* %%  - a literal '%' character
+* %d, %i - a signed integer
+* %u  - an unsigned integer
+* %x, %X - an unsigned integer in lower or uppercase hexadecimal; with
+*       '#' zero-padded to 8 digits, without "0x", the way the kernel's
+*       printf always did it. The kernel's printf only had uppercase
+*       digits, so kernel code uses %X and %#X.
+* %o  - an unsigned integer in octal
+* %p  - a pointer, as "0x" and 8 hexadecimal digits
+* %c  - a character
+* %s  - a string; the precision is the most characters taken from it
+*/
+
+int
+format_into(format_buf_t* fb, const char* format, va_list args)
+{
+	unsigned int start = fb->total;
+
+	for (; *format != '\0'; format++) {
+		int flags = 0;
+		int width = 0;
+		int precision = -1;
+		int value;
+
+		if (*format != '%') {
+			emit(fb, *format);
+			continue;
+		}
+
+		/* Flags */
+		for (format++; ; format++) {
+			if (*format == '-') {
+				flags |= FMT_LEFT;
+			} else if (*format == '0') {
+				flags |= FMT_ZERO;
+			} else if (*format == '#') {
+				flags |= FMT_ALT;
+			} else {
+				break;
+			}
+		}
+
+		/* Width, a negative one from '*' pads on the right */
+		if (*format == '*') {
+			width = va_arg(args, int);
+			if (width < 0) {
+				flags |= FMT_LEFT;
+				width = -width;
+			}
+			format++;
+		} else {
+			for (; *format >= '0' && *format <= '9'; format++) {
+				width = width * 10 + *format - '0';
+			}
+		}
+
+		/* Precision, a negative one from '*' counts as none */
+		if (*format == '.') {
+			format++;
+			if (*format == '*') {
+				precision = va_arg(args, int);
+				format++;
+			} else {
+				for (precision = 0; *format >= '0' && *format <= '9'; format++) {
+					precision = precision * 10 + *format - '0';
+				}
+			}
+			if (precision < 0) {
+				precision = -1;
+			}
+		}
+
+		switch (*format) {
+			case '%':
+				emit(fb, '%');
+				break;
+
+			case 'd':
+			case 'i':
+				value = va_arg(args, int);
+				if (value < 0) {
+					emit_number(fb, -(unsigned int)value, "-", 10, 0, flags, width, precision);
+				} else {
+					emit_number(fb, value, "", 10, 0, flags, width, precision);
+				}
+				break;
+
+			case 'u':
+				emit_number(fb, va_arg(args, unsigned int), "", 10, 0, flags, width, precision);
+				break;
+
+			case 'x':
+			case 'X':
+				if ((flags & FMT_ALT) && precision < 0) {
+					precision = 8;
+				}
+				emit_number(fb, va_arg(args, unsigned int), "", 16, *format == 'X', flags, width, precision);
+				break;
+
+			case 'o':
+				emit_number(fb, va_arg(args, unsigned int), "", 8, 0, flags, width, precision);
+				break;
+
+			case 'p':
+				emit_number(fb, (unsigned int) va_arg(args, void*), "0x", 16, 0, flags, width, 8);
+				break;
+
+			case 'c':
+				{
+					char c[2];
+					c[0] = (char) va_arg(args, int);
+					c[1] = '\0';
+					emit_string(fb, c, flags, width, 1);
+				}
+				break;
+
+			case 's':
+				emit_string(fb, va_arg(args, const char*), flags, width, precision);
+				break;
+
+			/* A '%' ending the string */
+			case '\0':
+				format--;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	return fb->total - start;
+}
+
+/*
+* int vsnprintf(char* buf, unsigned int size, const char* format, va_list args);
+*   Inputs: char* buf = where the text goes
+*			unsigned int size = bytes buf has room for, the NUL included
+*			const char* format = format string, see format_into
+*			va_list args = the arguments
+*   Return Value: length of the whole text, even the part that did not fit
+*	Function: Formats into a buffer, cutting the text short if it does
+*			  not fit. buf ends with a NUL unless size is 0.
+*/
+
+int
+vsnprintf(char* buf, unsigned int size, const char* format, va_list args)
+{
+	format_buf_t fb;
+
+	fb.buf = buf;
+	fb.size = size > 0 ? size - 1 : 0;
+	fb.len = 0;
+	fb.total = 0;
+	fb.line_flush = 0;
+	fb.flush = 0;
+
+	format_into(&fb, format, args);
+	if (size > 0) {
+		buf[fb.len] = '\0';
+	}
+	return fb.total;
+}
+
+/*
+* int snprintf(char* buf, unsigned int size, const char* format, ...);
+*   Inputs: char* buf = where the text goes
+*			unsigned int size = bytes buf has room for, the NUL included
+*			const char* format = format string, see format_into
+*   Return Value: length of the whole text, even the part that did not fit
+*	Function: vsnprintf with the arguments passed directly
+*/
+
+int
+snprintf(char* buf, unsigned int size, const char* format, ...)
+{
+	va_list args;
+	int length;
+
+	va_start(args, format);
+	length = vsnprintf(buf, size, format, args);
+	va_end(args);
+	return length;
+}
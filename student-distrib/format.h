@@ -0,0 +1,32 @@
+/* format.h - printf-style formatting for the kernel and the user library
+ * vim:ts=4 noexpandtab
+ *
+ * The user library in syscalls/ builds format.c too. It has <stdint.h>,
+ * whose int8_t is not types.h's, so this header sticks to plain C types.
+ */
+
+#ifndef _FORMAT_H
+#define _FORMAT_H
+
+/* Variable arguments, from the compiler since neither side has <stdarg.h> */
+typedef __builtin_va_list va_list;
+#define va_start(ap, last)	__builtin_va_start(ap, last)
+#define va_arg(ap, type)	__builtin_va_arg(ap, type)
+#define va_end(ap)			__builtin_va_end(ap)
+
+/* Where formatted text goes. Text collects in buf; once buf is full,
+ * flush is called to empty it, or with no flush the rest is dropped. */
+typedef struct format_buf {
+	char* buf;
+	unsigned int size;			/* bytes buf holds */
+	unsigned int len;			/* bytes in it now */
+	unsigned int total;			/* bytes formatted since it was set up */
+	int line_flush;				/* 1 to call flush after every '\n' too */
+	void (*flush)(struct format_buf* fb);	/* sends buf on and sets len to 0 */
+} format_buf_t;
+
+int format_into(format_buf_t* fb, const char* format, va_list args);
+int vsnprintf(char* buf, unsigned int size, const char* format, va_list args);
+int snprintf(char* buf, unsigned int size, const char* format, ...);
+
+#endif /* _FORMAT_H */
@@ -27,15 +27,24 @@
  * to declare the interrupt finished */
 #define EOI             0x60
 
+/* Timer line constant */
+#define PIT_IRQ_LINE        0
+
 /* Keyboard line constant */
 #define KEYBOARD_IRQ_LINE   1
 
 /* Slave line constant */
 #define SLAVE_IRQ_LINE      2
 
+/* COM1 line constant */
+#define COM1_IRQ_LINE       4
+
 /* RTC line constant */
 #define RTC_IRQ_LINE        8
 
+/* Primary IDE channel line constant */
+#define ATA_IRQ_LINE        14
+
 /* Externally-visible functions */
 
 /* Initialize both PICs */
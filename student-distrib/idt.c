@@ -2,6 +2,7 @@
 
 #include "interrupt_handlers.h"
 #include "lib.h"
+#include "printk.h"
 #include "x86_desc.h"
 #include "syscalls.h"
 
@@ -29,7 +30,9 @@ CREATE_EXCEPTION(EX_FLOATING_POINT,                 (XM) SIMD Floating Point Exc
 
 void EX_GENERIC() {
     cli();
-    printf("An unknown interrupt occured!\n");
+    printk(KERN_ERR, "An unknown interrupt occured!\n");
+    console_reset();
+    log_flush();
     halt(-1);
     sti();
 }
@@ -108,8 +111,11 @@ void init_idt() {
     SET_IDT_ENTRY(idt[0x13], EX_FLOATING_POINT);
 
     // Special entries
+    SET_IDT_ENTRY(idt[INT_PIT], handle_pit);
     SET_IDT_ENTRY(idt[INT_RTC], handle_rtc);
     SET_IDT_ENTRY(idt[INT_KEYBOARD], handle_keyboard);
+    SET_IDT_ENTRY(idt[INT_COM1], handle_com1);
+    SET_IDT_ENTRY(idt[INT_ATA], handle_ata);
     SET_IDT_ENTRY(idt[INT_SYSCALL], handle_syscall);
 
     lidt(idt_desc_ptr);
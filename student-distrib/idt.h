@@ -6,7 +6,9 @@
 // Vectors with special purpose
 #define INT_PIT         0x20
 #define INT_KEYBOARD    0x21
+#define INT_COM1        0x24
 #define INT_RTC         0x28
+#define INT_ATA         0x2E
 #define INT_SYSCALL     0x80
 
 /* Initialize the IDT */
@@ -15,7 +17,9 @@ extern void init_idt();
 // Marco to create generic exception handler
 #define CREATE_EXCEPTION(type, message) \
 void type() {                           \
-    printf("%s\n", #message);           \
+    printk(KERN_ERR, "%s\n", #message); \
+    console_reset();                    \
+    log_flush();                        \
     halt(-1);                           \
 }
 
@@ -1,13 +1,27 @@
 #ifndef INTERRUPT_HANDLERS_H_
 #define INTERRUPT_HANDLERS_H_
 
+#include "types.h"
+
+/* Handler for timer interrupts */
+void handle_pit();
+
 /* Handler for Real Time Clock interrupts */
 void handle_rtc();
 
 /* Handler for Keyboard interrupts */
 void handle_keyboard();
 
+/* Handler for COM1 interrupts */
+void handle_com1();
+
+/* Handler for primary IDE channel interrupts */
+void handle_ata();
+
 /* Handler for Syscalls */
 void handle_syscall();
 
+/* Saves this kernel stack's esp and resumes the one at new_esp */
+void switch_context(uint32_t *save_esp, uint32_t new_esp);
+
 #endif
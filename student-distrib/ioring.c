@@ -0,0 +1,263 @@
+#include "ioring.h"
+
+#include "lib.h"
+#include "poll.h"
+#include "syscalls.h"
+
+/*
+ * would_block(sqe)
+ *
+ * DESCRIPTION: Checks whether running a submission now would wait, for
+ *              a read the file's readiness callback does not report
+ *              readable: the RTC before its next interrupt, a terminal
+ *              or the serial port before a line is finished, an empty
+ *              pipe
+ *
+ * INPUTS: 	sqe - the submission
+ * OUTPUTS: none
+ *
+ * RETURNS: 1 if it would wait, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+static uint32_t would_block(const io_sqe_t *sqe) {
+    file_t *file = get_file(sqe->fd);
+
+    if (sqe->opcode != IORING_OP_READ || file == NULL || (file->flags & FILE_NONBLOCK)) {
+        return 0;
+    }
+
+    return !file_readable(sqe->fd);
+}
+
+/*
+ * post(ctx, user_data, result)
+ *
+ * DESCRIPTION: Adds a completion to the ring. The caller made sure there
+ *              is room.
+ *
+ * INPUTS: 	ctx - the process's ring state
+ *          user_data - from the submission
+ *          result - what the operation returned
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: the process sees the completion once cq_tail moves
+ */
+static void post(io_context_t *ctx, uint32_t user_data, int32_t result) {
+    io_ring_t *ring = ctx->ring;
+    io_cqe_t *cqe = &ctx->cqes[ring->cq_tail & (ctx->entries - 1)];
+
+    cqe->user_data = user_data;
+    cqe->result = result;
+    ring->cq_tail++;
+}
+
+/*
+ * run(ctx, sqe)
+ *
+ * DESCRIPTION: Does what a submission asks through the file's fileops,
+ *              as read() or write() would, and posts the result. One with
+ *              an offset works there like pread()/pwrite(), leaving the
+ *              file position where it was, and fails on a file without a
+ *              position to seek.
+ *
+ * INPUTS: 	ctx - the process's ring state
+ *          sqe - the submission
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: moves the file position unless an offset is given
+ */
+static void run(io_context_t *ctx, const io_sqe_t *sqe) {
+    file_t *file = get_file(sqe->fd);
+    int32_t result = -1;
+    int32_t saved_pos;
+    uint32_t at_offset = sqe->offset != IORING_OFFSET_CURRENT;
+
+    if (file != NULL && sqe->buf != NULL && (!at_offset || file_seekable(file))) {
+        saved_pos = file->pos;
+        if (at_offset) {
+            file->pos = sqe->offset;
+        }
+
+        if (sqe->opcode == IORING_OP_READ) {
+            result = file->fileops.read(sqe->fd, sqe->buf, sqe->nbytes);
+        } else if (sqe->opcode == IORING_OP_WRITE) {
+            result = file->fileops.write(sqe->fd, sqe->buf, sqe->nbytes);
+        }
+
+        if (at_offset) {
+            file->pos = saved_pos;
+        }
+    }
+
+    post(ctx, sqe->user_data, result);
+}
+
+/*
+ * run_deferred(ctx)
+ *
+ * DESCRIPTION: Runs the held submissions whose files are ready now. One
+ *              that still has to wait holds back the rest on its fd, so
+ *              each fd's operations finish in the order they came.
+ *
+ * INPUTS: 	ctx - the process's ring state
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: posts completions
+ */
+static void run_deferred(io_context_t *ctx) {
+    uint32_t waiting_fds = 0;
+    uint32_t i = 0;
+
+    while (i < ctx->num_deferred) {
+        io_sqe_t sqe = ctx->deferred[i];
+        uint32_t fd_bit = 1 << (sqe.fd & 0x1F);     // fds 32 apart share a bit
+
+        if ((waiting_fds & fd_bit) || would_block(&sqe)) {
+            waiting_fds |= fd_bit;
+            i++;
+            continue;
+        }
+
+        ctx->num_deferred--;
+        memmove(&ctx->deferred[i], &ctx->deferred[i + 1], (ctx->num_deferred - i) * sizeof(io_sqe_t));
+        run(ctx, &sqe);
+    }
+}
+
+/*
+ * is_deferred(ctx, fd)
+ *
+ * DESCRIPTION: Checks for held submissions on an fd, which a new one on
+ *              the same fd has to queue behind
+ *
+ * INPUTS: 	ctx - the process's ring state
+ *          fd - the file descriptor
+ * OUTPUTS: none
+ *
+ * RETURNS: 1 if there are some, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+static uint32_t is_deferred(io_context_t *ctx, int32_t fd) {
+    uint32_t i;
+    for (i = 0; i < ctx->num_deferred; i++) {
+        if (ctx->deferred[i].fd == fd) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * io_setup(ring)
+ *
+ * DESCRIPTION: Registers the calling process's submission and completion
+ *              ring. The header and both arrays must be in its memory and
+ *              entries a power of two up to IORING_MAX_ENTRIES. Replacing
+ *              a ring drops any submissions still held.
+ *
+ * INPUTS: 	ring - the ring, or NULL to stop using one
+ * OUTPUTS: none
+ *
+ * RETURNS: 0 on success, -1 if the ring is bad
+ * SIDE EFFECTS: none
+ */
+int32_t io_setup(io_ring_t *ring) {
+    io_context_t *ctx = &get_current_pcb()->io;
+    uint32_t entries;
+
+    io_release(ctx);
+    if (ring == NULL) {
+        return 0;
+    }
+
+    if (!in_user_page(ring, sizeof(io_ring_t))) {
+        return -1;
+    }
+
+    entries = ring->entries;
+    if (entries == 0 || entries > IORING_MAX_ENTRIES || (entries & (entries - 1))
+        || !in_user_page(ring->sqes, entries * sizeof(io_sqe_t))
+        || !in_user_page(ring->cqes, entries * sizeof(io_cqe_t))) {
+        return -1;
+    }
+
+    ctx->entries = entries;
+    ctx->sqes = ring->sqes;
+    ctx->cqes = ring->cqes;
+    ctx->ring = ring;
+    return 0;
+}
+
+/*
+ * io_enter(min_complete)
+ *
+ * DESCRIPTION: Takes every queued submission there is room to complete
+ *              and runs it. Reads that would wait are held instead, so
+ *              the rest keep going, and run on a later call once their
+ *              file is ready. Then, while fewer than min_complete
+ *              completions are waiting to be reaped and something is
+ *              held, lets the rest of a pipeline run or sleeps until an
+ *              interrupt makes it ready.
+ *
+ * INPUTS: 	min_complete - completions to wait for, 0 to only submit
+ * OUTPUTS: none
+ *
+ * RETURNS: submissions taken, or -1 without a ring
+ * SIDE EFFECTS: runs file operations, posts completions
+ */
+int32_t io_enter(uint32_t min_complete) {
+    io_context_t *ctx = &get_current_pcb()->io;
+    io_ring_t *ring = ctx->ring;
+    int32_t taken = 0;
+
+    if (ring == NULL) {
+        return -1;
+    }
+
+    run_deferred(ctx);
+
+    // Everything taken needs a completion slot, held ones included
+    while (ring->sq_head != ring->sq_tail
+           && ring->cq_tail - ring->cq_head + ctx->num_deferred < ctx->entries) {
+        io_sqe_t sqe = ctx->sqes[ring->sq_head & (ctx->entries - 1)];
+
+        if (is_deferred(ctx, sqe.fd) || would_block(&sqe)) {
+            if (ctx->num_deferred == IORING_MAX_DEFERRED) {
+                break;
+            }
+            ctx->deferred[ctx->num_deferred++] = sqe;
+        } else {
+            run(ctx, &sqe);
+        }
+
+        ring->sq_head++;
+        taken++;
+    }
+
+    while (ring->cq_tail - ring->cq_head < min_complete && ctx->num_deferred > 0) {
+        if (pipeline_yield()) {
+            asm volatile ("sti; hlt" : : : "memory");
+        }
+        run_deferred(ctx);
+    }
+
+    return taken;
+}
+
+/*
+ * io_release(ctx)
+ *
+ * DESCRIPTION: Forgets a process's ring and anything it was holding
+ *
+ * INPUTS: 	ctx - the process's ring state
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: none
+ */
+void io_release(io_context_t *ctx) {
+    ctx->ring = NULL;
+    ctx->entries = 0;
+    ctx->sqes = NULL;
+    ctx->cqes = NULL;
+    ctx->num_deferred = 0;
+}
@@ -0,0 +1,67 @@
+#ifndef IORING_H_
+#define IORING_H_
+
+#include "types.h"
+
+// Operations a submission can ask for
+#define IORING_OP_READ          0
+#define IORING_OP_WRITE         1
+
+// Offset meaning "wherever the file is now", the way read() and write() go
+#define IORING_OFFSET_CURRENT   0xFFFFFFFF
+
+// Most entries a ring can have, the count must be a power of two
+#define IORING_MAX_ENTRIES      256
+// Submissions that would block, held until their file is ready
+#define IORING_MAX_DEFERRED     8
+
+/* A queued read or write, same meaning as the syscall arguments */
+typedef struct io_sqe {
+    uint32_t opcode;
+    int32_t fd;
+    void *buf;
+    int32_t nbytes;
+    uint32_t offset;            // Like pread()/pwrite() unless IORING_OFFSET_CURRENT
+    uint32_t user_data;         // Copied to the completion
+} io_sqe_t;
+
+/* The result of one submission, what read() or write() would have returned */
+typedef struct io_cqe {
+    uint32_t user_data;
+    int32_t result;
+} io_cqe_t;
+
+/*
+ * Shared between a process and the kernel, all in the process's memory.
+ * Heads and tails count up forever and index the arrays modulo entries.
+ * The process fills sqes and moves sq_tail, the kernel moves sq_head as
+ * it takes them; the kernel fills cqes and moves cq_tail, the process
+ * moves cq_head as it reaps them. Results are not lost: the kernel stops
+ * taking submissions while their completions might not fit.
+ */
+typedef struct io_ring {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    uint32_t entries;
+    io_sqe_t *sqes;
+    io_cqe_t *cqes;
+} io_ring_t;
+
+/* Per process ring state, kept in the PCB. The arrays and their size are
+   copied at setup so the process cannot move them afterwards. */
+typedef struct io_context {
+    io_ring_t *ring;
+    uint32_t entries;
+    io_sqe_t *sqes;
+    io_cqe_t *cqes;
+    io_sqe_t deferred[IORING_MAX_DEFERRED];
+    uint32_t num_deferred;
+} io_context_t;
+
+int32_t io_setup(io_ring_t *ring);
+int32_t io_enter(uint32_t min_complete);
+void io_release(io_context_t *ctx);
+
+#endif
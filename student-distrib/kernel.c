@@ -11,21 +11,128 @@
 #include "syscalls.h"
 #include "keyboard.h"
 #include "rofs.h"
+#include "crc32c.h"
+#include "mount.h"
+#include "ramdisk.h"
+#include "ata.h"
 #include "rtc.h"
 #include "paging.h"
 #include "tests.h"
 #include "terminal.h"
+#include "pit.h"
+#include "serial.h"
 
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags,bit)   ((flags) & (1 << (bit)))
 
+/* Uncomment to run the benchmarks in tests.c before the first shell */
+/* #define RUN_BENCHMARKS */
+
+/* Where each module sits once place_modules is done, mounted after
+   paging is on. A zero end means the module could not be kept. */
+static uint32_t module_start[MAX_MOUNTS];
+static uint32_t module_end[MAX_MOUNTS];
+static int8_t module_name[MAX_MOUNTS][MOUNT_NAME_LENGTH];
+static uint32_t num_modules;
+
+/* Picks where a module gets mounted: the first word after the image path
+   on its GRUB module line, or modN when there is none. Module 0 is the
+   root. NAME must hold MOUNT_NAME_LENGTH bytes. */
+static void
+module_mount_name (module_t *mod, int index, int8_t *name)
+{
+	int8_t *string = (int8_t *) mod->string;
+	uint32_t i;
+
+	name[0] = '\0';
+	if (index == 0)
+		return;
+
+	if (string != NULL) {
+		/* Skip the path, then the spaces after it */
+		while (*string != '\0' && *string != ' ')
+			string++;
+		while (*string == ' ')
+			string++;
+
+		for (i = 0; i < MOUNT_NAME_LENGTH - 1 && string[i] != '\0' && string[i] != ' '; i++)
+			name[i] = string[i];
+		name[i] = '\0';
+		if (i > 0)
+			return;
+	}
+
+	strcpy(name, "mod");
+	itoa(index, name + 3, 10);
+}
+
+/* Checks whether the kernel command line has OPTION as one of its
+   space-separated words, like console=ttyS0 */
+static int
+cmdline_has (const int8_t *cmdline, const int8_t *option)
+{
+	uint32_t length = strlen(option);
+
+	while (*cmdline != '\0') {
+		while (*cmdline == ' ')
+			cmdline++;
+		if (strncmp(cmdline, option, length) == 0 &&
+			(cmdline[length] == ' ' || cmdline[length] == '\0'))
+			return 1;
+		while (*cmdline != '\0' && *cmdline != ' ')
+			cmdline++;
+	}
+	return 0;
+}
+
+/* Records every module and moves the ones that do not fit in the kernel
+   page to 4MB boundaries past the frame pool, where nothing else lives.
+   Must run before paging, while all of physical memory is reachable.
+   MEM_TOP is the end of usable memory, or 0 if GRUB did not say. */
+static void
+place_modules (module_t *mod, uint32_t count, uint32_t mem_top)
+{
+	uint32_t next = FRAME_POOL_END;
+	uint32_t i;
+
+	/* Never copy over a module that has not been moved yet */
+	for (i = 0; i < count; i++) {
+		if (mod[i].mod_end > next)
+			next = (mod[i].mod_end + LARGE_PAGE_SIZE - 1) & ~(LARGE_PAGE_SIZE - 1);
+	}
+
+	num_modules = count < MAX_MOUNTS ? count : MAX_MOUNTS;
+	for (i = 0; i < num_modules; i++) {
+		uint32_t size = mod[i].mod_end - mod[i].mod_start;
+
+		module_mount_name(&mod[i], i, module_name[i]);
+		module_start[i] = mod[i].mod_start;
+		module_end[i] = mod[i].mod_end;
+		if (module_start[i] >= KERNEL_PAGE_START && module_end[i] <= KERNEL_PAGE_END)
+			continue;
+
+		if (mem_top != 0 && (next > mem_top || mem_top - next < size)) {
+			printf("  /%s: no room for %u bytes\n", module_name[i], size);
+			module_end[i] = 0;
+			continue;
+		}
+
+		memcpy((void *) next, (void *) mod[i].mod_start, size);
+		module_start[i] = next;
+		module_end[i] = next + size;
+		next = (module_end[i] + LARGE_PAGE_SIZE - 1) & ~(LARGE_PAGE_SIZE - 1);
+	}
+}
+
 /* Check if MAGIC is valid and print the Multiboot information structure
    pointed by ADDR. */
 void
 entry (unsigned long magic, unsigned long addr)
 {
 	multiboot_info_t *mbi;
+	uint32_t serial_console = 0;
+	uint32_t i;
 
 	/* Clear the screen. */
 	clear();
@@ -33,7 +140,7 @@ entry (unsigned long magic, unsigned long addr)
 	/* Am I booted by a Multiboot-compliant boot loader? */
 	if (magic != MULTIBOOT_BOOTLOADER_MAGIC)
 	{
-		printf ("Invalid magic number: 0x%#x\n", (unsigned) magic);
+		printf ("Invalid magic number: 0x%#X\n", (unsigned) magic);
 		return;
 	}
 
@@ -41,7 +148,7 @@ entry (unsigned long magic, unsigned long addr)
 	mbi = (multiboot_info_t *) addr;
 
 	/* Print out the flags. */
-	printf ("flags = 0x%#x\n", (unsigned) mbi->flags);
+	printf ("flags = 0x%#X\n", (unsigned) mbi->flags);
 
 	/* Are mem_* valid? */
 	if (CHECK_FLAG (mbi->flags, 0))
@@ -50,33 +157,36 @@ entry (unsigned long magic, unsigned long addr)
 
 	/* Is boot_device valid? */
 	if (CHECK_FLAG (mbi->flags, 1))
-		printf ("boot_device = 0x%#x\n", (unsigned) mbi->boot_device);
+		printf ("boot_device = 0x%#X\n", (unsigned) mbi->boot_device);
 
 	/* Is the command line passed? */
-	if (CHECK_FLAG (mbi->flags, 2))
+	if (CHECK_FLAG (mbi->flags, 2)) {
 		printf ("cmdline = %s\n", (char *) mbi->cmdline);
+		serial_console = cmdline_has((int8_t *) mbi->cmdline, "console=" SERIAL_NAME);
+	}
 
 	if (CHECK_FLAG (mbi->flags, 3)) {
 		int mod_count = 0;
 		int i;
 		module_t* mod = (module_t*)mbi->mods_addr;
 
-        printf("Initing Read Only File System... ");
-        init_rofs((void *)mod->mod_start);
-        printf("Done!\n");
+        /* mem_upper counts the KB past the first megabyte */
+        place_modules(mod, mbi->mods_count,
+            CHECK_FLAG (mbi->flags, 0) ? 0x100000 + mbi->mem_upper * 1024 : 0);
 
         while(mod_count < mbi->mods_count) {
-			printf("Module %d loaded at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_start);
-			printf("Module %d ends at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_end);
+			printf("Module %d loaded at address: 0x%#X\n", mod_count, (unsigned int)mod->mod_start);
+			printf("Module %d ends at address: 0x%#X\n", mod_count, (unsigned int)mod->mod_end);
 			printf("First few bytes of module:\n");
 			for(i = 0; i<16; i++) {
-				printf("0x%x ", *((char*)(mod->mod_start+i)));
+				printf("0x%X ", *((char*)(mod->mod_start+i)));
 			}
 			printf("\n");
 			mod_count++;
 			mod++;
 		}
 	}
+
 	/* Bits 4 and 5 are mutually exclusive! */
 	if (CHECK_FLAG (mbi->flags, 4) && CHECK_FLAG (mbi->flags, 5))
 	{
@@ -89,8 +199,8 @@ entry (unsigned long magic, unsigned long addr)
 	{
 		elf_section_header_table_t *elf_sec = &(mbi->elf_sec);
 
-		printf ("elf_sec: num = %u, size = 0x%#x,"
-				" addr = 0x%#x, shndx = 0x%#x\n",
+		printf ("elf_sec: num = %u, size = 0x%#X,"
+				" addr = 0x%#X, shndx = 0x%#X\n",
 				(unsigned) elf_sec->num, (unsigned) elf_sec->size,
 				(unsigned) elf_sec->addr, (unsigned) elf_sec->shndx);
 	}
@@ -100,14 +210,14 @@ entry (unsigned long magic, unsigned long addr)
 	{
 		memory_map_t *mmap;
 
-		printf ("mmap_addr = 0x%#x, mmap_length = 0x%x\n",
+		printf ("mmap_addr = 0x%#X, mmap_length = 0x%X\n",
 				(unsigned) mbi->mmap_addr, (unsigned) mbi->mmap_length);
 		for (mmap = (memory_map_t *) mbi->mmap_addr;
 				(unsigned long) mmap < mbi->mmap_addr + mbi->mmap_length;
 				mmap = (memory_map_t *) ((unsigned long) mmap
 					+ mmap->size + sizeof (mmap->size)))
-			printf (" size = 0x%x,     base_addr = 0x%#x%#x\n"
-					"     type = 0x%x,  length    = 0x%#x%#x\n",
+			printf (" size = 0x%X,     base_addr = 0x%#X%#X\n"
+					"     type = 0x%X,  length    = 0x%#X%#X\n",
 					(unsigned) mmap->size,
 					(unsigned) mmap->base_addr_high,
 					(unsigned) mmap->base_addr_low,
@@ -159,8 +269,59 @@ entry (unsigned long magic, unsigned long addr)
 
 	i8259_init();
     init_keyboard();
+    init_pit();
+    serial_init();
+	/* console=ttyS0 puts the first shell on COM1, for running headless */
+	serial_set_console(serial_console);
+	if (serial_console)
+		printf(serial_is_console() ? "Console on %s\n" : "No %s for the console\n", SERIAL_NAME);
 	sti();
 	init_paging();
+
+	/* Modules past the kernel page are only reachable through the
+	   mount pages, so mounting waits for paging */
+	crc32c_init();
+	printf("Mounting Read Only File Systems...\n");
+	for (i = 0; i < num_modules; i++) {
+		mount_t *mount;
+		rofs_stats_t stats;
+
+		printf("  /%s: ", module_name[i]);
+		if (module_end[i] == 0) {
+			printf("not loaded\n");
+			continue;
+		}
+
+		mount = mount_rofs(module_name[i], module_start[i], module_end[i]);
+		if (mount == NULL) {
+			printf("Unknown image!\n");
+			continue;
+		}
+
+		rofs_get_stats(&mount->rofs, &stats);
+		printf("version %d, %d logical blocks in %d physical blocks%s\n",
+			rofs_version(&mount->rofs), stats.logical_blocks, stats.physical_blocks,
+			mount->rofs.checksums != NULL ? ", checksummed" : "");
+	}
+	mount_tmpfs(TMPFS_MOUNT);
+
+	if (ramdisk_create(RAMDISK_NAME, RAMDISK_SIZE) == NULL)
+		printf("No room for the ramdisk\n");
+	ata_init();
+	mount_dev(DEV_MOUNT);
+
+#ifdef RUN_BENCHMARKS
+	bench_rofs();
+	bench_block();
+	bench_disk();
+	bench_pipe();
+	bench_terminal();
+	bench_switch();
+	bench_scroll();
+	bench_serial();
+	bench_printk();
+#endif
+
     init_terminals();
 
 	/* Spin (nicely, so we don't chew up cycles) */
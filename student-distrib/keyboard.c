@@ -30,13 +30,15 @@ static uint8_t key_scancodes[KEY_STATES][NUM_KEYS] = {
 };
 
 
-/* key buffer */
-//volatile uint8_t *key_buffer;
-/* position in the key buffer */
-volatile uint32_t key_buffer_pos = 0;
+/* Scancodes from the IRQ. Only the handler's first half moves key_tail
+   and only the loop that hands them to the line discipline moves
+   key_head, so neither needs a lock. */
+static uint8_t key_ring[KEY_RING_SIZE];
+static volatile uint32_t key_head = 0;
+static volatile uint32_t key_tail = 0;
+static volatile uint8_t key_draining = 0;
 
 /* global variables for keyboard state */
-volatile uint8_t enter_pressed = 0;
 static uint8_t shift_pressed = 0;
 static uint8_t capslock_state = 0;
 static uint8_t ctrl_pressed = 0;
@@ -45,7 +47,6 @@ static uint8_t keys_state = 0;    // 0 = nothing pressed
                                   // 1 = shift pressed
                                   // 2 = capslock pressed
                                   // 3 = shift pressed and capslock pressed
-int right_bound = 7;
 
 
 /*
@@ -62,30 +63,48 @@ int right_bound = 7;
 void init_keyboard() {
     cli();
     enable_irq(KEYBOARD_IRQ_LINE);
-    key_buffer_pos = 0;
+    key_head = 0;
+    key_tail = 0;
     sti();
 }
 
 /*
- * keyboard_handler()
+ * switch_from_drain(int term)
  *
- * DESCRIPTION: Handles keyboard input.
+ * DESCRIPTION: Switches terminals from the loop in drain_keys. The
+ *              terminal switched to carries on with the ring, either in
+ *              its own loop, which it left the same way, or in a handler
+ *              that runs once its new shell does.
  *
- * INPUTS: none
+ * INPUTS: term - which terminal to switch to
  * OUTPUTS: none
- * SIDE EFFECTS: prints keyboard input to the screen.
+ * SIDE EFFECTS: may run another terminal's processes
  *
  */
-void
-keyboard_handler()
+static void
+switch_from_drain(int term)
 {
-    cli();
-
-    /* Read from the keyboard's data buffer */
-    uint32_t scancode = inb(KEYBOARD_PORT);
-
-    send_eoi(KEYBOARD_IRQ_LINE);
+    key_draining = 0;
+    console_release();
+    switch_terminal(term);
+    console_hold();
+    key_draining = 1;
+}
 
+/*
+ * process_scancode(uint32_t scancode)
+ *
+ * DESCRIPTION: Tracks the modifier keys and sends a key to the foreground
+ *              terminal's line discipline
+ *
+ * INPUTS: scancode - from the ring
+ * OUTPUTS: none
+ * SIDE EFFECTS: may echo, switch terminals or scroll the view
+ *
+ */
+static void
+process_scancode(uint32_t scancode)
+{
     if (scancode != 0xE0){
       switch (scancode) {
         // shift pressed
@@ -134,33 +153,47 @@ keyboard_handler()
         case F1_KEY:
           // switch to terminal 1
           if (alt_pressed == 1)
-            switch_terminal(1);
+            switch_from_drain(1);
           break;
         case F2_KEY:
           // switch to terminal 2
           if (alt_pressed == 1)
-            switch_terminal(2);
+            switch_from_drain(2);
           break;
         case F3_KEY:
           // switch to terminal 3
           if (alt_pressed == 1)
-            switch_terminal(3);
+            switch_from_drain(3);
+          break;
+        // shift+page up/down look through the scrollback
+        case PAGE_UP:
+          if (shift_pressed == 1)
+            scroll_view(NUM_ROWS - 1);
+          break;
+        case PAGE_DOWN:
+          if (shift_pressed == 1)
+            scroll_view(-(NUM_ROWS - 1));
+          break;
+        // arrow keys
+        case ARROW_UP:
+          terminal_input(TERM_KEY_UP);
+          break;
+        case ARROW_DOWN:
+          terminal_input(TERM_KEY_DOWN);
           break;
-        // left arrow key pressed
         case ARROW_LEFT:
-          move_cursor_left();
+          terminal_input(TERM_KEY_LEFT);
           break;
-        // right arrow key pressed
         case ARROW_RIGHT:
-          move_cursor_right();
+          terminal_input(TERM_KEY_RIGHT);
           break;
         // enter pressed
         case ENTER:
-          handle_enter();
+          terminal_input('\n');
           break;
         // backspace pressed
         case BACKSPACE:
-          handle_backpace();
+          terminal_input('\b');
           break;
         default:
           key_pressed_handler(scancode);
@@ -168,154 +201,129 @@ keyboard_handler()
       }
     }
 
-    sti();
 }
 
 /*
- * key_pressed_handler(uint8_t scancode)
+ * drain_keys()
  *
- * DESCRIPTION: Handles keyboard input.
+ * DESCRIPTION: Empties the ring into the line discipline with interrupts
+ *              on, so keys that arrive while echo draws and scrolls are
+ *              kept. The console is held meanwhile, so the log waits
+ *              until an echo is done. Called with interrupts off, and
+ *              returns with them off.
  *
- * INPUTS: scancode - input from keyboard
+ * INPUTS: none
  * OUTPUTS: none
- * SIDE EFFECTS: prints keyboard input to the screen.
- *               adjusts key buffer.
+ * SIDE EFFECTS: echoes on the screen
  *
  */
-void
-key_pressed_handler(uint8_t scancode){
-    // check for valid scancode
-    if (scancode >= NUM_KEYS)
-      return;
-    // if ctrl+l is pressed, clear terminal
-    if (ctrl_pressed == 1) {
-      if (key_scancodes[keys_state][scancode] == 'l'){
-        clear();
-        key_buffer_pos = 0;
+static void
+drain_keys()
+{
+    uint32_t scancode;
+
+    key_draining = 1;
+    console_hold();
+    // Check again with interrupts off, or a key that came in just after
+    // the ring looked empty would wait for the next one
+    do {
+      sti();
+      while (key_head != key_tail) {
+        scancode = key_ring[key_head & (KEY_RING_SIZE - 1)];
+        key_head++;
+        process_scancode(scancode);
       }
-    }
-    else if (scancode < NUM_KEYS) {
-        if (key_buffer_pos < KEY_BUFFER_SIZE){
-          // check for null scancode
-          if (key_scancodes[keys_state][scancode] == NULL_SCANCODE)
-            return;
-          // update key buffer
-          key_buffer[key_buffer_pos] = key_scancodes[keys_state][scancode];
-          key_buffer_pos++;
-          right_bound++;
-          // display key
-          putc(key_scancodes[keys_state][scancode]);
-        }
-    }
+      cli();
+    } while (key_head != key_tail);
+    console_release();
+    key_draining = 0;
 }
 
 /*
- * clear_buffer()
+ * keyboard_handler()
  *
- * DESCRIPTION: clears the keyboard buffer
+ * DESCRIPTION: Handles keyboard input. Only putting the scancode in the
+ *              ring happens with interrupts off; then, unless an earlier
+ *              call below on the stack is already doing it, the ring is
+ *              drained. If the key came in while something was drawing,
+ *              the scancode waits in the ring for keyboard_drain_tick,
+ *              since the echo would draw over it.
  *
- * INPUTS:      none
- * OUTPUTS:     none
- * SIDE EFFECTS: clears keyboard buffer
+ * INPUTS: none
+ * OUTPUTS: none
+ * SIDE EFFECTS: prints keyboard input to the screen.
  *
-*/
-void clear_buffer() {
+ */
+void
+keyboard_handler()
+{
+    /* Read from the keyboard's data buffer */
+    uint32_t scancode = inb(KEYBOARD_PORT);
 
-    key_buffer_pos = 0;
-    right_bound = 7;
-    int i;
+    if (key_tail - key_head < KEY_RING_SIZE) {
+      key_ring[key_tail & (KEY_RING_SIZE - 1)] = scancode;
+      key_tail++;
+    }
 
-    /* uncomment to show the terminal read and write are working */
-    //terminal_read(0,key_buffer,key_buffer1_pos+1);
-    //terminal_write(0,key_buffer,key_buffer1_pos+1);
+    send_eoi(KEYBOARD_IRQ_LINE);
 
-    // clear key buffer
-    for (i = 0; i < KEY_BUFFER_SIZE; i++){
-      key_buffer[i] = '\0';
-    }
+    if (key_draining || console_busy())
+      return;
+
+    drain_keys();
 }
 
 /*
- * handle_enter()
+ * keyboard_drain_tick()
  *
- * DESCRIPTION: Handles pressing enter
+ * DESCRIPTION: Called on every timer tick after the PIC is acknowledged;
+ *              handles keys that keyboard_handler left in the ring
+ *              because the screen was busy, once it no longer is
  *
- * INPUTS:  none
+ * INPUTS: none
  * OUTPUTS: none
- * SIDE EFFECTS: goes to new line in terminal.
- *               resets key buffer.
+ * SIDE EFFECTS: echoes on the screen, enables interrupts while it runs
  *
  */
 void
-handle_enter() {
-    enter_pressed = 1;    // raise the enter_pressed flag
-    right_bound = 7;
-    do_enter();
+keyboard_drain_tick()
+{
+    if (key_head == key_tail || key_draining || console_busy())
+      return;
+
+    drain_keys();
 }
 
 /*
- * handle_backspace()
+ * key_pressed_handler(uint8_t scancode)
  *
- * DESCRIPTION: Handles pressing backspace
+ * DESCRIPTION: Handles keyboard input.
  *
- * INPUTS:  none
+ * INPUTS: scancode - input from keyboard
  * OUTPUTS: none
- * SIDE EFFECTS: removes previous entry in terminal.
- *               updates key buffer.
+ * SIDE EFFECTS: sends the character to the line discipline, a control
+ *               character if ctrl is held
  *
  */
 void
-handle_backpace() {
-    if (key_buffer_pos > 0){
-      // remove backspaced char from buffer by putting null key at that index
-      key_buffer_pos--;
-      key_buffer[key_buffer_pos] = '\0';
-      right_bound--;
+key_pressed_handler(uint8_t scancode){
+    uint8_t c;
 
-      do_backspace();
-    }
-}
+    // check for valid scancode
+    if (scancode >= NUM_KEYS)
+      return;
 
-/*  
- * move_cursor_left()
- * 
- * DESCRIPTION: Moves the cursor left
- *
- * INPUTS:  none
- * OUTPUTS: none
- * SIDE EFFECTS: cursor is moved to the left one space
- *
-*/
-void move_cursor_left() {
-  int x, y;
-  x = get_screen_x();
-  y = get_screen_y();
-  if (x != 7){
-    x--;
-    set_screen_pos(x,y);
-    update_cursor_loc(x,y);
-    key_buffer_pos--;
-  }
-}
+    c = key_scancodes[keys_state][scancode];
+    // check for null scancode
+    if (c == NULL_SCANCODE)
+      return;
 
-/*  
- * move_cursor_right()
- * 
- * DESCRIPTION: Moves the cursor right
- *
- * INPUTS:  none
- * OUTPUTS: none
- * SIDE EFFECTS: cursor is moved to the right one space
- *
-*/
-void move_cursor_right(){
-  int x,y;
-  x = get_screen_x();
-  y = get_screen_y();
-  if (x < right_bound){
-    x++;
-    set_screen_pos(x,y);
-    update_cursor_loc(x,y);
-    key_buffer_pos++;
-  }
+    if (ctrl_pressed == 1) {
+      // only letters have control characters
+      if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+        terminal_input(c & CTRL_MASK);
+      return;
+    }
+
+    terminal_input(c);
 }
@@ -11,6 +11,7 @@
 #define NUM_KEYS		60
 #define KEY_STATES		4
 #define KEY_BUFFER_SIZE 128
+#define CTRL_MASK		0x1F	// a letter with ctrl held
 #define NULL_SCANCODE	'\0'
 
 /* keyboard scancodes */
@@ -26,6 +27,8 @@
 #define ARROW_LEFT		0x4B
 #define ARROW_RIGHT		0x4D
 #define ARROW_DOWN 		0x50
+#define PAGE_UP			0x49
+#define PAGE_DOWN		0x51
 
 /* max number of terminals */
 #define MAX_TERMINALS 	3
@@ -38,29 +41,17 @@
 
 #define HISTORY			10
 
-/* key buffer */
-//extern volatile uint8_t key_buffer[KEY_BUFFER_SIZE];
-/* position in the key buffer */
-extern volatile uint32_t key_buffer_pos;
-/* if enter has been pressed */
-extern volatile uint8_t enter_pressed;
+/* Scancodes the IRQ has read and the line discipline has not taken yet,
+   a power of two */
+#define KEY_RING_SIZE	256
 
 /* Initialize the keyboard */
 void init_keyboard();
 /* Process interrupts */
 void handle_keyboard();
+/* Handles keys left waiting while the screen was busy, called on every tick */
+void keyboard_drain_tick();
 /* Process key pressed */
 void key_pressed_handler(uint8_t scancode);
-/* print character with new line consideration*/
-void putc_t(uint8_t c);
-/* handles backspace pressed */
-void handle_backpace();
-/* handles enter pressed */
-void handle_enter();
-void clear_buffer();
-void load_command();
-void move_cursor_left();
-void move_cursor_right();
-
 
 #endif
@@ -8,6 +8,46 @@
 static int screen_x;
 static int screen_y;
 static char* video_mem = (char *)VIDEO;
+static int cursor_base;     // cells from the start of VGA memory to video_mem
+
+/* Each page of VGA memory holds more rows than the screen. The screen is a
+ * window into its page that slides down one row per scroll, and the CRTC
+ * start address follows it. */
+static int cur_page;                    // page video_mem is in
+static int shown_page;                  // page the CRTC displays
+static int page_top[VIDEO_PAGES];       // first row of each page's window
+static int page_pins[VIDEO_PAGES];      // vidmap users, who need top 0
+static int hw_scroll = 1;               // 0 to always scroll by copying
+
+/* Rows that scroll off the top of each terminal's screen, the newest
+ * SCROLLBACK_LINES of them. Only the characters are kept, a terminal's
+ * attribute is the same everywhere. */
+static uint8_t scrollback[MAX_TERMINALS][SCROLLBACK_LINES][NUM_COLS];
+static uint32_t saved_lines[MAX_TERMINALS];     // ever saved, wraps the ring
+static int view_back;                   // rows the shown screen is scrolled back
+
+/* Set while anything here is partway through changing the screen, the
+ * position or the CRTC, so output from an interrupt can wait instead of
+ * drawing over it */
+static volatile int drawing;
+
+/* Attribute each page draws new text with, and the one it starts with */
+static uint8_t page_attrib[VIDEO_PAGES] = {ATTRIB_DEFAULT, ATTRIB_DEFAULT, ATTRIB_DEFAULT, ATTRIB_DEFAULT};
+static uint8_t page_default[VIDEO_PAGES] = {ATTRIB_DEFAULT, ATTRIB_DEFAULT, ATTRIB_DEFAULT, ATTRIB_DEFAULT};
+
+/*
+* live_view()
+*   Inputs:       none
+*   Return Value: none
+*   Function: puts the live screen back if output is about to change the
+*             terminal being looked at through its scrollback
+*/
+static void
+live_view() {
+    if (view_back != 0 && cur_page == shown_page) {
+        show_video_page(shown_page);
+    }
+}
 
 /*
 * void clear(void);
@@ -20,6 +60,8 @@ void
 clear(void)
 {
     int32_t i;
+    drawing++;
+    live_view();
     for(i=0; i<NUM_ROWS*NUM_COLS; i++) {
         *(uint8_t *)(video_mem + (i << 1)) = ' ';
         //*(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB_B;
@@ -27,6 +69,83 @@ clear(void)
     set_screen_pos(0, 0);
     update_cursor_loc(0, 0);
     printf("391OS> ");
+    drawing--;
+}
+
+/*
+* save_rows(int rows)
+*   Inputs:       rows - how many rows at the top are about to scroll off
+*   Return Value: none
+*   Function: adds them to the terminal's scrollback, overwriting the
+*             oldest once the ring is full
+*/
+static void
+save_rows(int rows) {
+    int32_t r, c;
+
+    if (cur_page >= MAX_TERMINALS) {
+        return;
+    }
+
+    for (r = 0; r < rows; r++) {
+        uint8_t *line = scrollback[cur_page][saved_lines[cur_page] % SCROLLBACK_LINES];
+        for (c = 0; c < NUM_COLS; c++) {
+            line[c] = video_mem[(NUM_COLS * r + c) << 1];
+        }
+        saved_lines[cur_page]++;
+    }
+}
+
+/*
+* move_window(int top)
+*   Inputs:       top - row of the current page the screen starts at
+*   Return Value: none
+*   Function: slides the screen's window over its page, following it
+*             with the CRTC if the page is on screen
+*/
+static void
+move_window(int top) {
+    page_top[cur_page] = top;
+    video_mem = (char *)(VIDEO + cur_page * VIDEO_PAGE_SIZE + top * (NUM_COLS << 1));
+    cursor_base = (cur_page * VIDEO_PAGE_SIZE >> 1) + top * NUM_COLS;
+    if (cur_page == shown_page) {
+        show_video_page(cur_page);
+    }
+}
+
+/*
+* scroll_rows(int rows)
+*   Inputs:       rows - how many rows to shift up, at most NUM_ROWS
+*   Return Value: none
+*   Function: shifts the screen up and blanks the rows that open up at
+*             the bottom. The window moves down its page instead of the
+*             text moving, until it hits the end of the page and the rows
+*             that stay get copied back to the top. Without hardware
+*             scrolling, or with the page pinned by vidmap, every scroll
+*             copies.
+*/
+static void
+scroll_rows(int rows) {
+    int32_t kept = NUM_COLS * (NUM_ROWS - rows);
+    int32_t top = page_top[cur_page] + rows;
+    int32_t i;
+
+    save_rows(rows);
+    if (!hw_scroll || page_pins[cur_page]) {
+        memmove(video_mem, video_mem + ((NUM_COLS * rows) << 1), kept << 1);
+    } else if (top + NUM_ROWS <= VIDEO_PAGE_ROWS) {
+        move_window(top);
+    } else {
+        // wrap: bring the rows that stay to the top of the page
+        memmove((char *)(VIDEO + cur_page * VIDEO_PAGE_SIZE),
+                video_mem + ((NUM_COLS * rows) << 1), kept << 1);
+        move_window(0);
+    }
+
+    for (i = kept; i < NUM_ROWS * NUM_COLS; i++) {
+        *(uint8_t *)(video_mem + (i << 1)) = '\0';
+        *(uint8_t *)(video_mem + (i << 1) + 1) = page_attrib[cur_page];
+    }
 }
 
 /*
@@ -37,155 +156,53 @@ clear(void)
 */
 void
 scroll() {
-    int row;
-    int col;
-    int32_t current_line;
-    int32_t scroll_line;
-    // shift the rows up one
-    for (row = 0; row < NUM_ROWS - 1; row++){
-      for (col = 0; col < NUM_COLS; col++){
-        current_line = NUM_COLS*(row+1) + col;
-        scroll_line = NUM_COLS*row + col;
-        *(uint8_t *)(video_mem+(scroll_line<<1)) = *(uint8_t *)(video_mem+(current_line<<1));
-      }
-    }
-    // clear the bottom line
-    for (col = 0; col < NUM_COLS; col++) {
-      scroll_line = NUM_COLS*(NUM_ROWS-1) + col;
-      *(uint8_t *)(video_mem + (scroll_line << 1)) = '\0';
-    }
+    drawing++;
+    scroll_rows(1);
     // update the terminal location
     screen_x = 0;
     screen_y = NUM_ROWS - 1;
+    drawing--;
 }
 
-/* Standard printf().
- * Only supports the following format strings:
- * %%  - print a literal '%' character
- * %x  - print a number in hexadecimal
- * %u  - print a number as an unsigned integer
- * %d  - print a number as a signed integer
- * %c  - print a character
- * %s  - print a string
- * %#x - print a number in 32-bit aligned hexadecimal, i.e.
- *       print 8 hexadecimal digits, zero-padded on the left.
- *       For example, the hex number "E" would be printed as
- *       "0000000E".
- *       Note: This is slightly different than the libc specification
- *       for the "#" modifier (this implementation doesn't add a "0x" at
- *       the beginning), but I think it's more flexible this way.
- *       Also note: %x is the only conversion specifier that can use
- *       the "#" modifier to alter output.
- * */
+/*
+* void flush_screen(format_buf_t* fb);
+*   Inputs: format_buf_t* fb = printf's buffer
+*   Return Value: none
+*	Function: Draws what printf has formatted so far
+*/
+
+static void
+flush_screen(format_buf_t* fb)
+{
+	putn((uint8_t *)fb->buf, fb->len);
+	fb->len = 0;
+}
+
+/* Standard printf(), with the conversions format_into takes. The text is
+ * formatted into a buffer and drawn PRINTF_BUF_SIZE characters at a time
+ * rather than one putc each. %#X prints 8 hexadecimal digits, zero-padded
+ * on the left and without a "0x", so the hex number "E" is "0000000E";
+ * %x and %#x give lowercase digits. */
 int32_t
 printf(int8_t *format, ...)
 {
-	/* Pointer to the format string */
-	int8_t* buf = format;
-
-	/* Stack pointer for the other parameters */
-	int32_t* esp = (void *)&format;
-	esp++;
-
-	while(*buf != '\0') {
-		switch(*buf) {
-			case '%':
-				{
-					int32_t alternate = 0;
-					buf++;
-
-format_char_switch:
-					/* Conversion specifiers */
-					switch(*buf) {
-						/* Print a literal '%' character */
-						case '%':
-							putc('%');
-							break;
-
-						/* Use alternate formatting */
-						case '#':
-							alternate = 1;
-							buf++;
-							/* Yes, I know gotos are bad.  This is the
-							 * most elegant and general way to do this,
-							 * IMHO. */
-							goto format_char_switch;
-
-						/* Print a number in hexadecimal form */
-						case 'x':
-							{
-								int8_t conv_buf[64];
-								if(alternate == 0) {
-									itoa(*((uint32_t *)esp), conv_buf, 16);
-									puts(conv_buf);
-								} else {
-									int32_t starting_index;
-									int32_t i;
-									itoa(*((uint32_t *)esp), &conv_buf[8], 16);
-									i = starting_index = strlen(&conv_buf[8]);
-									while(i < 8) {
-										conv_buf[i] = '0';
-										i++;
-									}
-									puts(&conv_buf[starting_index]);
-								}
-								esp++;
-							}
-							break;
-
-						/* Print a number in unsigned int form */
-						case 'u':
-							{
-								int8_t conv_buf[36];
-								itoa(*((uint32_t *)esp), conv_buf, 10);
-								puts(conv_buf);
-								esp++;
-							}
-							break;
-
-						/* Print a number in signed int form */
-						case 'd':
-							{
-								int8_t conv_buf[36];
-								int32_t value = *((int32_t *)esp);
-								if(value < 0) {
-									conv_buf[0] = '-';
-									itoa(-value, &conv_buf[1], 10);
-								} else {
-									itoa(value, conv_buf, 10);
-								}
-								puts(conv_buf);
-								esp++;
-							}
-							break;
-
-						/* Print a single character */
-						case 'c':
-							putc( (uint8_t) *((int32_t *)esp) );
-							esp++;
-							break;
-
-						/* Print a NULL-terminated string */
-						case 's':
-							puts( *((int8_t **)esp) );
-							esp++;
-							break;
-
-						default:
-							break;
-					}
-
-				}
-				break;
-
-			default:
-				putc(*buf);
-				break;
-		}
-		buf++;
-	}
-
-	return (buf - format);
+	int8_t buf[PRINTF_BUF_SIZE];
+	format_buf_t fb;
+	va_list args;
+
+	fb.buf = buf;
+	fb.size = PRINTF_BUF_SIZE;
+	fb.len = 0;
+	fb.total = 0;
+	fb.line_flush = 0;
+	fb.flush = flush_screen;
+
+	va_start(args, format);
+	format_into(&fb, format, args);
+	va_end(args);
+
+	flush_screen(&fb);
+	return fb.total;
 }
 
 /*
@@ -198,13 +215,138 @@ format_char_switch:
 int32_t
 puts(int8_t* s)
 {
-	register int32_t index = 0;
-	while(s[index] != '\0') {
-		putc(s[index]);
-		index++;
-	}
+	return putn((uint8_t *)s, strlen(s));
+}
+
+/*
+* int32_t draw_text(const uint8_t* s, int32_t n);
+*   Inputs: const uint8_t* s = characters to print
+*			int32_t n = how many
+*   Return Value: Number of bytes written
+*	Function: Output a run of characters to the console, a screenful of
+*			  lines at a time. Each screenful is counted first so the
+*			  screen scrolls once by however many rows it needs, then
+*			  drawn. The hardware cursor is left where it was.
+*/
+
+int32_t
+draw_text(const uint8_t* s, int32_t n)
+{
+    uint8_t attrib = page_attrib[cur_page];
+    int32_t lines;          // line breaks in this screenful
+    int32_t x;
+    int32_t overflow;
+    int32_t i, end;
+
+    drawing++;
+    live_view();
+    for (i = 0; i < n; i = end) {
+        // Up to NUM_ROWS - 1 breaks, so no line scrolls off undrawn and
+        // the scrollback gets all of them
+        lines = 0;
+        x = screen_x;
+        for (end = i; end < n && lines < NUM_ROWS - 1; end++) {
+            if (s[end] == '\n' || s[end] == '\r' || ++x == NUM_COLS) {
+                x = 0;
+                lines++;
+            }
+        }
+
+        overflow = screen_y + lines - (NUM_ROWS - 1);
+        if (overflow > 0) {
+            scroll_rows(overflow);
+            screen_y -= overflow;
+        }
+
+        for (; i < end; i++) {
+            if (s[i] != '\n' && s[i] != '\r') {
+                *(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1)) = s[i];
+                *(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = attrib;
+                if (++screen_x < NUM_COLS) {
+                    continue;
+                }
+            }
+            screen_x = 0;
+            screen_y++;
+        }
+    }
+
+    drawing--;
+    return n;
+}
+
+/*
+* int console_busy(void);
+*   Inputs: none
+*   Return Value: 1 if a change to the screen, the position or the CRTC
+*				  was interrupted partway, 0 otherwise
+*	Function: Lets interrupt handlers check before they draw
+*/
 
-	return index;
+int
+console_busy(void)
+{
+	return drawing != 0;
+}
+
+/*
+* void console_hold(void);
+*   Inputs: none
+*   Return Value: none
+*	Function: Marks the console busy until the matching console_release,
+*			  for changes made up of several calls; holds nest
+*/
+
+void
+console_hold(void)
+{
+	drawing++;
+}
+
+/*
+* void console_release(void);
+*   Inputs: none
+*   Return Value: none
+*	Function: Ends a console_hold
+*/
+
+void
+console_release(void)
+{
+	drawing--;
+}
+
+/*
+* void console_reset(void);
+*   Inputs: none
+*   Return Value: none
+*	Function: Drops every hold, for an exception that abandons the code
+*			  that was drawing, so the console does not stay busy
+*/
+
+void
+console_reset(void)
+{
+	drawing = 0;
+}
+
+/*
+* int32_t putn(const uint8_t* s, int32_t n);
+*   Inputs: const uint8_t* s = characters to print
+*			int32_t n = how many
+*   Return Value: Number of bytes written
+*	Function: Output a run of characters to the console with draw_text,
+*			  then move the cursor once
+*/
+
+int32_t
+putn(const uint8_t* s, int32_t n)
+{
+    drawing++;
+    draw_text(s, n);
+    update_cursor_loc(screen_x, screen_y);
+    drawing--;
+    return n;
 }
 
 /*
@@ -217,11 +359,13 @@ puts(int8_t* s)
 void
 putc(uint8_t c)
 {
+    drawing++;
+    live_view();
     if(c == '\n' || c == '\r') {
         do_enter();
     } else {
         *(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1)) = c;
-        //*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB_B;
+        *(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = page_attrib[cur_page];
         screen_x++;
         if (screen_x >= NUM_COLS) {
             do_enter();
@@ -229,6 +373,7 @@ putc(uint8_t c)
             update_cursor_loc(screen_x, screen_y);
         }
     }
+    drawing--;
 }
 
 /*
@@ -606,12 +751,228 @@ test_interrupts(void)
 *   Function: puts cursor in position pos.
 */
 void update_cursor_loc(int x, int y) {
-    unsigned short pos = (unsigned short)(NUM_COLS * y + x);
+    unsigned short pos = (unsigned short)(cursor_base + NUM_COLS * y + x);
 
+    // Each index goes with the data byte after it
+    drawing++;
     outb(FB_HIGH_BYTE_COMMAND, FB_COMMAND_PORT);
     outb(((pos >> 8) & 0x00FF), FB_DATA_PORT);
     outb(FB_LOW_BYTE_COMMAND, FB_COMMAND_PORT);
     outb(pos & 0x00FF, FB_DATA_PORT);
+    drawing--;
+}
+
+/*
+* set_start_address(unsigned short start)
+*   Inputs:       start - cell of VGA memory to show at the top left
+*   Return Value: none
+*   Function: programs the CRTC start address
+*/
+static void
+set_start_address(unsigned short start) {
+    drawing++;
+    outb(FB_START_HIGH_COMMAND, FB_COMMAND_PORT);
+    outb(((start >> 8) & 0x00FF), FB_DATA_PORT);
+    outb(FB_START_LOW_COMMAND, FB_COMMAND_PORT);
+    outb(start & 0x00FF, FB_DATA_PORT);
+    drawing--;
+}
+
+/*
+* void set_video_page(int page)
+*   Inputs: page - which page of VGA memory to draw in
+*   Return Value: none
+*   Function: sends output and the cursor to one page of the VGA text
+*             memory, which need not be the one on screen
+*/
+void set_video_page(int page) {
+    drawing++;
+    cur_page = page;
+    video_mem = (char *)(VIDEO + page * VIDEO_PAGE_SIZE + page_top[page] * (NUM_COLS << 1));
+    cursor_base = (page * VIDEO_PAGE_SIZE >> 1) + page_top[page] * NUM_COLS;
+    drawing--;
+}
+
+/*
+* void show_video_page(int page)
+*   Inputs: page - which page of VGA memory to display
+*   Return Value: none
+*   Function: points the CRTC start address at a page's window, so the
+*             screen changes without copying anything
+*/
+void show_video_page(int page) {
+    unsigned short start = (unsigned short)((page * VIDEO_PAGE_SIZE >> 1) + page_top[page] * NUM_COLS);
+
+    drawing++;
+    shown_page = page;
+    view_back = 0;
+    set_start_address(start);
+    drawing--;
+}
+
+/*
+* void scroll_view(int rows)
+*   Inputs: rows - how far to move back through the scrollback, negative
+*                  to move forward
+*   Return Value: none
+*   Function: shows the terminal on screen scrolled back through the lines
+*             that went off its top. The view is drawn in the spare VGA
+*             page, only the rows on screen, so the terminal's own page
+*             and output to it are untouched. Scrolling all the way
+*             forward shows the live screen again.
+*/
+void scroll_view(int rows) {
+    uint32_t stored;
+    uint8_t attrib;
+    char *live, *view;
+    int32_t r, c;
+
+    if (shown_page >= MAX_TERMINALS) {
+        return;
+    }
+
+    stored = saved_lines[shown_page] < SCROLLBACK_LINES ? saved_lines[shown_page] : SCROLLBACK_LINES;
+    rows += view_back;
+    if (rows > (int)stored) {
+        rows = stored;
+    }
+    if (rows <= 0) {
+        show_video_page(shown_page);
+        return;
+    }
+
+    drawing++;
+    view_back = rows;
+
+    live = (char *)(VIDEO + shown_page * VIDEO_PAGE_SIZE + page_top[shown_page] * (NUM_COLS << 1));
+    view = (char *)(VIDEO + VIEW_PAGE * VIDEO_PAGE_SIZE);
+    attrib = page_default[shown_page];    // colors are not kept
+    for (r = 0; r < NUM_ROWS; r++) {
+        int32_t row = r - view_back;    // below 0 is scrollback
+        uint8_t *line = row < 0 ? scrollback[shown_page][(saved_lines[shown_page] + row) % SCROLLBACK_LINES] : NULL;
+        for (c = 0; c < NUM_COLS; c++) {
+            view[(NUM_COLS * r + c) << 1] = line ? line[c] : live[(NUM_COLS * row + c) << 1];
+            view[((NUM_COLS * r + c) << 1) + 1] = attrib;
+        }
+    }
+
+    set_start_address((unsigned short)(VIEW_PAGE * VIDEO_PAGE_SIZE >> 1));
+    drawing--;
+}
+
+/*
+* void init_video_page(int page, uint8_t attrib)
+*   Inputs: page - page of VGA memory
+*           attrib - colors for the terminal drawing there
+*   Return Value: none
+*   Function: blanks the whole page in the terminal's colors, which text
+*             goes back to on reset
+*/
+void init_video_page(int page, uint8_t attrib) {
+    char *base = (char *)(VIDEO + page * VIDEO_PAGE_SIZE);
+    int32_t i;
+
+    drawing++;
+    for (i = 0; i < VIDEO_PAGE_ROWS * NUM_COLS; i++) {
+        *(uint8_t *)(base + (i << 1)) = ' ';
+        *(uint8_t *)(base + (i << 1) + 1) = attrib;
+    }
+    page_attrib[page] = attrib;
+    page_default[page] = attrib;
+    drawing--;
+}
+
+/*
+* uint8_t get_text_attrib(void)
+*   Inputs: none
+*   Return Value: the attribute new text is drawn with
+*   Function: for changing one part of the colors
+*/
+uint8_t get_text_attrib(void) {
+    return page_attrib[cur_page];
+}
+
+/*
+* uint8_t get_default_attrib(void)
+*   Inputs: none
+*   Return Value: the attribute the page was set up with
+*   Function: for resetting colors
+*/
+uint8_t get_default_attrib(void) {
+    return page_default[cur_page];
+}
+
+/*
+* void set_text_attrib(uint8_t attrib)
+*   Inputs: attrib - VGA attribute, background in the high nibble
+*   Return Value: none
+*   Function: colors the text drawn from now on
+*/
+void set_text_attrib(uint8_t attrib) {
+    page_attrib[cur_page] = attrib;
+}
+
+/*
+* void erase_cells(int from, int to)
+*   Inputs: from - first cell, counting across rows from the top left
+*           to - cell after the last
+*   Return Value: none
+*   Function: blanks part of the screen in the current colors
+*/
+void erase_cells(int from, int to) {
+    int32_t i;
+
+    drawing++;
+    live_view();
+    for (i = from; i < to; i++) {
+        *(uint8_t *)(video_mem + (i << 1)) = ' ';
+        *(uint8_t *)(video_mem + (i << 1) + 1) = page_attrib[cur_page];
+    }
+    drawing--;
+}
+
+/*
+* void pin_video_page(int page)
+*   Inputs: page - page a process is about to draw in directly
+*   Return Value: none
+*   Function: moves the page's screen back to the top of the page, where
+*             vidmap hands it out, and keeps it there until unpinned
+*/
+void pin_video_page(int page) {
+    int old_page = cur_page;
+
+    drawing++;
+    if (page_pins[page]++ == 0 && page_top[page] != 0) {
+        set_video_page(page);
+        memmove((char *)(VIDEO + page * VIDEO_PAGE_SIZE), video_mem, (NUM_ROWS * NUM_COLS) << 1);
+        move_window(0);
+        set_video_page(old_page);
+    }
+    drawing--;
+}
+
+/*
+* void unpin_video_page(int page)
+*   Inputs: page - page pinned with pin_video_page
+*   Return Value: none
+*   Function: lets the page scroll in hardware again once nobody has it
+*             pinned
+*/
+void unpin_video_page(int page) {
+    if (page_pins[page] > 0) {
+        page_pins[page]--;
+    }
+}
+
+/*
+* void set_hw_scroll(int on)
+*   Inputs: on - 1 to scroll with the CRTC start address, 0 to copy
+*   Return Value: none
+*   Function: picks how scrolling works, for cards where moving the start
+*             address misbehaves and for comparing the two
+*/
+void set_hw_scroll(int on) {
+    hw_scroll = on;
 }
 
 int get_screen_x() {
@@ -623,11 +984,14 @@ int get_screen_y() {
 }
 
 void set_screen_pos(int x, int y) {
+    drawing++;
     screen_x = x;
     screen_y = y;
+    drawing--;
 }
 
 void do_enter() {
+    drawing++;
     // check if terminal needs to be shifted up
     if (screen_y == NUM_ROWS - 1){
       scroll();
@@ -638,9 +1002,12 @@ void do_enter() {
     screen_x = 0;
 
     update_cursor_loc(screen_x, screen_y);
+    drawing--;
 }
 
 void do_backspace() {
+    drawing++;
+    live_view();
     // check if at beginning of line
     if (screen_x == 0 && screen_y > 0){
       screen_x = NUM_COLS - 2;
@@ -649,8 +1016,9 @@ void do_backspace() {
       screen_x--;
     }
 
-    *(uint8_t *)(VIDEO + ((NUM_COLS*screen_y + screen_x) << 1)) = '\0';
-    //*(uint8_t *)(VIDEO + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB_B;
+    *(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1)) = '\0';
+    //*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB_B;
 
     update_cursor_loc(screen_x, screen_y);
+    drawing--;
 }
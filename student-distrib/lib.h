@@ -6,10 +6,13 @@
 #define _LIB_H
 
 #include "types.h"
+#include "format.h"
 
 int32_t printf(int8_t *format, ...);
 void putc(uint8_t c);
 int32_t puts(int8_t *s);
+int32_t putn(const uint8_t *s, int32_t n);
+int32_t draw_text(const uint8_t *s, int32_t n);
 void fb_move_cursor(unsigned short pos);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
@@ -40,6 +43,21 @@ int get_screen_x();
 int get_screen_y();
 void set_screen_pos(int x, int y);
 void update_cursor_loc(int x, int y);
+void set_video_page(int page);
+void show_video_page(int page);
+void init_video_page(int page, uint8_t attrib);
+uint8_t get_text_attrib(void);
+uint8_t get_default_attrib(void);
+void set_text_attrib(uint8_t attrib);
+void erase_cells(int from, int to);
+void pin_video_page(int page);
+void scroll_view(int rows);
+void unpin_video_page(int page);
+void set_hw_scroll(int on);
+int console_busy(void);
+void console_hold(void);
+void console_release(void);
+void console_reset(void);
 
 void do_enter();
 void do_backspace();
@@ -105,12 +123,34 @@ do {                                    \
 /* Writes four bytes to four consecutive ports */
 #define outl(data, port)                \
 do {                                    \
-	asm volatile("outl  %l1, (%w0)"     \
+	asm volatile("outl  %k1, (%w0)"     \
 			:                           \
 			: "d" (port), "a" (data)    \
 			: "memory", "cc" );         \
 } while(0)
 
+/* Reads "count" two byte words from a port into buf */
+#define insw(port, buf, count)          \
+do {                                    \
+	uint32_t _dst = (uint32_t) (buf);   \
+	uint32_t _cnt = (count);            \
+	asm volatile("cld; rep insw"        \
+			: "+D" (_dst), "+c" (_cnt)  \
+			: "d" (port)                \
+			: "memory", "cc" );         \
+} while(0)
+
+/* Writes "count" two byte words from buf to a port */
+#define outsw(port, buf, count)         \
+do {                                    \
+	uint32_t _src = (uint32_t) (buf);   \
+	uint32_t _cnt = (count);            \
+	asm volatile("cld; rep outsw"       \
+			: "+S" (_src), "+c" (_cnt)  \
+			: "d" (port)                \
+			: "memory", "cc" );         \
+} while(0)
+
 /* Clear interrupt flag - disables interrupts on this processor */
 #define cli()                           \
 do {                                    \
@@ -158,12 +198,26 @@ do {                                    \
 			);                      \
 } while(0)
 
+/* Characters printf formats before drawing them */
+#define PRINTF_BUF_SIZE			128
+
 #define VIDEO 					0xB8000
+/* Text mode has 32KB of VGA memory, split in pages of twice a screen
+ * each so there is room to scroll by moving the start address */
+#define VIDEO_PAGE_SIZE			0x2000
+#define VIDEO_PAGES				4
+#define VIDEO_PAGE_ROWS			(VIDEO_PAGE_SIZE / (2 * NUM_COLS))
+/* The last page shows a terminal scrolled back through its scrollback */
+#define VIEW_PAGE				(VIDEO_PAGES - 1)
+/* Rows of scrollback kept for each terminal */
+#define SCROLLBACK_LINES		2048
 #define NUM_COLS 				80
 #define NUM_ROWS 				25
 #define ATTRIB_G				0xA
 #define ATTRIB_Y 				0xE
 #define ATTRIB_B 				0xB
+/* Light gray on black, what the BIOS leaves */
+#define ATTRIB_DEFAULT			0x7
 
 /* The I/O ports */
 #define FB_COMMAND_PORT         0x3D4
@@ -171,5 +225,7 @@ do {                                    \
 /* The I/O port commands */
 #define FB_HIGH_BYTE_COMMAND    14
 #define FB_LOW_BYTE_COMMAND     15
+#define FB_START_HIGH_COMMAND   12
+#define FB_START_LOW_COMMAND    13
 
 #endif /* _LIB_H */
@@ -0,0 +1,105 @@
+#include "lz4.h"
+
+#include "lib.h"
+
+/*
+ * read_length(ip, iend, length)
+ *
+ * DESCRIPTION: Adds the extra length bytes that follow a saturated
+ *              nibble in an LZ4 token
+ *
+ * INPUTS: 	ip - where the length bytes start
+ *          iend - end of the compressed data
+ * OUTPUTS: length - incremented by every extra byte
+ *
+ * RETURNS: pointer past the length bytes, or NULL on truncated input
+ * SIDE EFFECTS: none
+ */
+static const uint8_t *read_length(const uint8_t *ip, const uint8_t *iend, uint32_t *length) {
+    uint8_t byte;
+    do {
+        if (ip >= iend) {
+            return NULL;
+        }
+        byte = *ip++;
+        *length += byte;
+    } while (byte == 0xFF);
+    return ip;
+}
+
+/*
+ * lz4_decompress(src, src_length, dst, dst_length)
+ *
+ * DESCRIPTION: Decompresses one block in the LZ4 block format. Every
+ *              sequence is a token, literals, then a back reference;
+ *              the last sequence stops after its literals. All lengths
+ *              and offsets are checked, so a corrupt image cannot write
+ *              outside dst.
+ *
+ * INPUTS: 	src - compressed data
+ *          src_length - bytes of compressed data
+ *          dst_length - room in dst
+ * OUTPUTS: dst - the decompressed data
+ *
+ * RETURNS: -1 on malformed input, otherwise bytes written to dst
+ * SIDE EFFECTS: none
+ */
+int32_t lz4_decompress(const uint8_t *src, uint32_t src_length, uint8_t *dst, uint32_t dst_length) {
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + src_length;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_length;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        // Literals
+        uint32_t length = token >> 4;
+        if (length == 0xF && (ip = read_length(ip, iend, &length)) == NULL) {
+            return -1;
+        }
+        if (length > iend - ip || length > oend - op) {
+            return -1;
+        }
+        memcpy(op, ip, length);
+        op += length;
+        ip += length;
+
+        if (ip == iend) {
+            // Last sequence has no match
+            break;
+        }
+
+        // Match
+        if (iend - ip < 2) {
+            return -1;
+        }
+        uint32_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - dst) {
+            return -1;
+        }
+
+        length = token & 0xF;
+        if (length == 0xF && (ip = read_length(ip, iend, &length)) == NULL) {
+            return -1;
+        }
+        length += LZ4_MIN_MATCH;
+        if (length > oend - op) {
+            return -1;
+        }
+
+        const uint8_t *match = op - offset;
+        if (offset >= length) {
+            memcpy(op, match, length);
+            op += length;
+        } else {
+            // Overlapping copy repeats the last offset bytes
+            while (length--) {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    return op - dst;
+}
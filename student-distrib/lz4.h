@@ -0,0 +1,11 @@
+#ifndef LZ4_H_
+#define LZ4_H_
+
+#include "types.h"
+
+#define LZ4_MIN_MATCH   4
+
+/* Decompresses one LZ4 block */
+int32_t lz4_decompress(const uint8_t *src, uint32_t src_length, uint8_t *dst, uint32_t dst_length);
+
+#endif
@@ -0,0 +1,213 @@
+#include "mount.h"
+
+#include "lib.h"
+#include "paging.h"
+
+static mount_t mounts[MAX_MOUNTS];
+
+// The name a path uses for the top directory of a mount
+static const int8_t mount_dir[] = ".";
+
+/*
+ * add_mount(name, type)
+ *
+ * DESCRIPTION: Claims a mount table slot for a name
+ *
+ * INPUTS: 	name - where to mount, "" for the root
+ *          type - kind of file system
+ * OUTPUTS: none
+ *
+ * RETURNS: the slot, or NULL if the name is bad, taken or the table is full
+ * SIDE EFFECTS: none
+ */
+static mount_t *add_mount(const int8_t *name, mount_type_t type) {
+    uint32_t length = strlen(name);
+    mount_t *slot = NULL;
+    uint32_t i;
+
+    if (length >= MOUNT_NAME_LENGTH) {
+        return NULL;
+    }
+
+    for (i = 0; i < length; i++) {
+        if (name[i] == '/') {
+            // Mounts only go at the top level
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < MAX_MOUNTS; i++) {
+        if (!mounts[i].in_use) {
+            if (slot == NULL) {
+                slot = &mounts[i];
+            }
+        } else if (!strncmp(mounts[i].name, name, MOUNT_NAME_LENGTH)) {
+            return NULL;
+        }
+    }
+
+    if (slot != NULL) {
+        memset(slot, 0, sizeof(mount_t));
+        strncpy(slot->name, name, MOUNT_NAME_LENGTH);
+        slot->type = type;
+    }
+    return slot;
+}
+
+/*
+ * mount_rofs(name, start, end)
+ *
+ * DESCRIPTION: Mounts a rofs image that is already in memory. Images in
+ *              the kernel's own page are read in place; anywhere else the
+ *              image has to start on a 4MB boundary, and its first 4MB
+ *              get a kernel page of their own for the boot block and
+ *              inode table. Data blocks are always read through the rofs
+ *              window, so the image can be as large as memory allows.
+ *
+ * INPUTS: 	name - where to mount, "" for the root
+ *          start - physical address of the image
+ *          end - physical address just past it
+ * OUTPUTS: none
+ *
+ * RETURNS: the mount, or NULL if the image is not valid or there is no room
+ * SIDE EFFECTS: adds to the mount table, may map a kernel page
+ */
+mount_t *mount_rofs(const int8_t *name, uint32_t start, uint32_t end) {
+    mount_t *mount = add_mount(name, MOUNT_ROFS);
+    void *base = (void *) start;
+    uint32_t mapped = end - start;
+
+    if (mount == NULL) {
+        return NULL;
+    }
+
+    if (start < KERNEL_PAGE_START || end > KERNEL_PAGE_END) {
+        if (start & (LARGE_PAGE_SIZE - 1)) {
+            return NULL;
+        }
+
+        base = (void *) (MOUNT_PAGES_START + (mount - mounts) * LARGE_PAGE_SIZE);
+        map_kernel_page((uint32_t) base, start);
+        if (mapped > LARGE_PAGE_SIZE) {
+            mapped = LARGE_PAGE_SIZE;
+        }
+    }
+
+    if (init_rofs(&mount->rofs, base, start, mapped)) {
+        return NULL;
+    }
+
+    mount->in_use = 1;
+    return mount;
+}
+
+/*
+ * mount_tmpfs(name)
+ *
+ * DESCRIPTION: Makes the tmpfs reachable under a name. There is only
+ *              one tmpfs, so mounting it twice shows the same files.
+ *
+ * INPUTS: 	name - where to mount
+ * OUTPUTS: none
+ *
+ * RETURNS: the mount, or NULL if there is no room
+ * SIDE EFFECTS: adds to the mount table
+ */
+mount_t *mount_tmpfs(const int8_t *name) {
+    mount_t *mount = add_mount(name, MOUNT_TMPFS);
+    if (mount != NULL) {
+        mount->in_use = 1;
+    }
+    return mount;
+}
+
+/*
+ * mount_dev(name)
+ *
+ * DESCRIPTION: Makes the block devices reachable as files under a name
+ *
+ * INPUTS: 	name - where to mount
+ * OUTPUTS: none
+ *
+ * RETURNS: the mount, or NULL if there is no room
+ * SIDE EFFECTS: adds to the mount table
+ */
+mount_t *mount_dev(const int8_t *name) {
+    mount_t *mount = add_mount(name, MOUNT_DEV);
+    if (mount != NULL) {
+        mount->in_use = 1;
+    }
+    return mount;
+}
+
+/*
+ * get_mount(index)
+ *
+ * DESCRIPTION: Walks the mount table
+ *
+ * INPUTS: 	index - slot number
+ * OUTPUTS: none
+ *
+ * RETURNS: the mount, or NULL if the slot is empty or out of range
+ * SIDE EFFECTS: none
+ */
+mount_t *get_mount(uint32_t index) {
+    if (index >= MAX_MOUNTS || !mounts[index].in_use) {
+        return NULL;
+    }
+
+    return &mounts[index];
+}
+
+/*
+ * resolve_path(path, name)
+ *
+ * DESCRIPTION: Finds the file system a path lives in. A leading slash
+ *              is optional. "data/file" resolves to "file" in the mount
+ *              named data and "data" alone to its top directory ".";
+ *              anything that matches no named mount goes to the root.
+ *
+ * INPUTS: 	path - the path to look up
+ * OUTPUTS: name - the rest of the path within the mount
+ *
+ * RETURNS: the mount, or NULL if nothing is mounted there
+ * SIDE EFFECTS: none
+ */
+mount_t *resolve_path(const int8_t *path, const int8_t **name) {
+    mount_t *root = NULL;
+    uint32_t i;
+
+    while (*path == '/') {
+        path++;
+    }
+
+    for (i = 0; i < MAX_MOUNTS; i++) {
+        mount_t *mount = &mounts[i];
+        if (!mount->in_use) {
+            continue;
+        }
+
+        uint32_t length = strlen(mount->name);
+        if (length == 0) {
+            root = mount;
+            continue;
+        }
+
+        if (strncmp(path, mount->name, length)) {
+            continue;
+        }
+
+        if (path[length] == '\0' || (path[length] == '/' && path[length + 1] == '\0')) {
+            *name = mount_dir;
+            return mount;
+        }
+
+        if (path[length] == '/') {
+            *name = path + length + 1;
+            return mount;
+        }
+    }
+
+    *name = path;
+    return root;
+}
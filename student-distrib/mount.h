@@ -0,0 +1,36 @@
+#ifndef MOUNT_H_
+#define MOUNT_H_
+
+#include "types.h"
+#include "rofs.h"
+
+#define MAX_MOUNTS          8
+#define MOUNT_NAME_LENGTH   16
+
+// Where the writable tmpfs shows up
+#define TMPFS_MOUNT         "tmp"
+
+typedef enum mount_type {
+    MOUNT_ROFS = 0,
+    MOUNT_TMPFS = 1,
+    MOUNT_DEV = 2           // Block devices, see block.h
+} mount_type_t;
+
+/*
+ * A mounted file system. Paths starting with name and a slash resolve
+ * into it; the root mount has an empty name and takes everything else.
+ */
+typedef struct mount {
+    int8_t name[MOUNT_NAME_LENGTH];
+    uint32_t in_use;
+    mount_type_t type;
+    rofs_t rofs;            // Only for MOUNT_ROFS
+} mount_t;
+
+mount_t *mount_rofs(const int8_t *name, uint32_t start, uint32_t end);
+mount_t *mount_tmpfs(const int8_t *name);
+mount_t *mount_dev(const int8_t *name);
+mount_t *get_mount(uint32_t index);
+mount_t *resolve_path(const int8_t *path, const int8_t **name);
+
+#endif
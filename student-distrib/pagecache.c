@@ -0,0 +1,96 @@
+#include "pagecache.h"
+
+#include "lib.h"
+#include "paging.h"
+
+/*
+ * page_cache_lookup(cache, index)
+ *
+ * DESCRIPTION: Finds a page of the file if it is resident
+ *
+ * INPUTS: 	cache - the file's page cache
+ *          index - page number within the file
+ * OUTPUTS: none
+ *
+ * RETURNS: the page, or NULL if it was never written
+ * SIDE EFFECTS: none
+ */
+uint8_t *page_cache_lookup(page_cache_t *cache, uint32_t index) {
+    if (cache->pages == NULL || index >= PAGES_PER_CACHE) {
+        return NULL;
+    }
+
+    return cache->pages[index];
+}
+
+/*
+ * page_cache_grab(cache, index)
+ *
+ * DESCRIPTION: Finds a page of the file, bringing in a zeroed frame
+ *              when it is not resident yet
+ *
+ * INPUTS: 	cache - the file's page cache
+ *          index - page number within the file
+ * OUTPUTS: none
+ *
+ * RETURNS: the page, or NULL if out of frames or past the size limit
+ * SIDE EFFECTS: may allocate frames
+ */
+uint8_t *page_cache_grab(page_cache_t *cache, uint32_t index) {
+    if (index >= PAGES_PER_CACHE) {
+        return NULL;
+    }
+
+    if (cache->pages == NULL) {
+        cache->pages = (uint8_t **) alloc_frame();
+        if (cache->pages == NULL) {
+            return NULL;
+        }
+        memset(cache->pages, 0, PAGE_SIZE);
+    }
+
+    if (cache->pages[index] == NULL) {
+        uint8_t *page = (uint8_t *) alloc_frame();
+        if (page == NULL) {
+            return NULL;
+        }
+        memset(page, 0, PAGE_SIZE);
+        cache->pages[index] = page;
+        cache->num_pages++;
+    }
+
+    return cache->pages[index];
+}
+
+/*
+ * page_cache_truncate(cache, first)
+ *
+ * DESCRIPTION: Drops every page from first to the end of the file. The
+ *              page table itself goes once nothing is left in it.
+ *
+ * INPUTS: 	cache - the file's page cache
+ *          first - first page number to drop
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: frees frames
+ */
+void page_cache_truncate(page_cache_t *cache, uint32_t first) {
+    uint32_t i;
+
+    if (cache->pages == NULL) {
+        return;
+    }
+
+    for (i = first; i < PAGES_PER_CACHE && cache->num_pages > 0; i++) {
+        if (cache->pages[i] != NULL) {
+            free_frame(cache->pages[i]);
+            cache->pages[i] = NULL;
+            cache->num_pages--;
+        }
+    }
+
+    if (cache->num_pages == 0) {
+        free_frame(cache->pages);
+        cache->pages = NULL;
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef PAGECACHE_H_
+#define PAGECACHE_H_
+
+#include "types.h"
+
+#define PAGE_SIZE           4096
+#define PAGE_SHIFT          12
+#define PAGE_MASK           0xFFF
+
+// One frame of page pointers per file caps it at 4MB
+#define PAGES_PER_CACHE     1024
+#define MAX_CACHE_LENGTH    (PAGES_PER_CACHE * PAGE_SIZE)
+
+/* The pages holding one file's data, indexed by page number */
+typedef struct page_cache {
+    uint8_t **pages;        // Frame of page pointers, NULL until first write
+    uint32_t num_pages;     // Pages currently resident
+} page_cache_t;
+
+/* Finds a resident page, NULL for a hole */
+uint8_t *page_cache_lookup(page_cache_t *cache, uint32_t index);
+/* Finds a page, allocating a zeroed one if it is not resident */
+uint8_t *page_cache_grab(page_cache_t *cache, uint32_t index);
+/* Frees every page from first onwards */
+void page_cache_truncate(page_cache_t *cache, uint32_t first);
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "paging.h"
 #include "types.h"
+#include "lib.h"
 
 #define ARR_SIZE 1024
 #define FOUR_KB 4096
@@ -19,6 +20,10 @@ uint32_t pageTable[ARR_SIZE] __attribute__((aligned(FOUR_KB)));
 uint32_t userTable[ARR_SIZE] __attribute__((aligned(FOUR_KB)));
 uint32_t videoTable[ARR_SIZE] __attribute__((aligned(FOUR_KB)));
 
+//one bit per frame in the pool, set when the frame is in use
+static uint32_t frameMap[NUM_FRAMES / 32];
+static uint32_t framesFree = NUM_FRAMES;
+
 /*
 * Function: init_paging()
 * Description: Maps kernal memory and video memory, sets the rest not present.
@@ -43,8 +48,17 @@ void init_paging()
   //map kernal block (4 MB), set size, rw, and present flags
   pageDir[1] = FOUR_MB | PAGE_DIR_FLAGS;
 
-  //page table entry for video memory
-  pageTable[VID_MEM_LOC] |= 3;
+  //page table entries for video memory, every page of the VGA text memory
+  for(i = VID_MEM_LOC; i < VID_MEM_LOC + VIDEO_PAGES * VIDEO_PAGE_SIZE / FOUR_KB; i++)
+  {
+    pageTable[i] |= 3;
+  }
+
+  //map the frame pool as kernel only 4MB pages at the same addresses
+  for(i = FRAME_POOL_START / FOUR_MB; i < FRAME_POOL_END / FOUR_MB; i++)
+  {
+    pageDir[i] = (i * FOUR_MB) | PAGE_DIR_FLAGS;
+  }
 
   //turn on paging
   asm volatile(
@@ -117,6 +131,23 @@ void remapVideo(uint32_t vAddr, uint32_t pAddr)
   refresh_tbl();
 }
 
+/*
+* Function: remapVideoPage
+* Description: Points the page vidmap handed out at another page of video
+*              memory, if a process has one mapped
+* Inputs: pAddr - physical address to be mapped
+* Outputs: none
+*/
+void remapVideoPage(uint32_t pAddr)
+{
+  //nothing to move if vidmap was never called
+  if(userTable[0] & 1)
+  {
+    userTable[0] = pAddr | RWP_FLAGS;
+    refresh_tbl();
+  }
+}
+
 /*
 * Function: remapWithPageTableToPage
 * Description: Maps 4MB chunk of memory at the vAddr to the specified page of the user page table
@@ -138,6 +169,22 @@ void remapToPage(uint32_t vAddr, uint32_t pAddr, uint32_t page)
 }
 
 
+/*
+* Function: map_kernel_page
+* Description: Maps a kernel only 4MB page, for reaching physical memory
+*              outside the identity mapped regions
+* Inputs: vAddr - virtual address to be mapped, 4MB aligned
+*         pAddr - physical address to be mapped, 4MB aligned
+* Outputs: none
+*/
+void map_kernel_page(uint32_t vAddr, uint32_t pAddr)
+{
+  //sets size, r/w and present flags, no user access
+  pageDir[vAddr / FOUR_MB] = pAddr | PAGE_DIR_FLAGS;
+  //refresh
+  refresh_tbl();
+}
+
 /*
 * Function: refresh_tbl
 * Description: Refreshes the tbl
@@ -152,3 +199,66 @@ void refresh_tbl(void){
                :"%eax"
                );
 }
+
+/*
+* Function: alloc_frame
+* Description: Takes a free 4KB frame from the frame pool
+* Inputs: none
+* Outputs: kernel address of the frame, NULL if the pool is empty
+*/
+void *alloc_frame(void)
+{
+  uint32_t flags;
+  uint32_t i;
+  uint32_t bit;
+
+  cli_and_save(flags);
+  for(i = 0; i < NUM_FRAMES / 32; i++)
+  {
+    //skip words with every frame in use
+    if(frameMap[i] == 0xFFFFFFFF)
+      continue;
+
+    for(bit = 0; frameMap[i] & (1 << bit); bit++);
+    frameMap[i] |= 1 << bit;
+    framesFree--;
+    restore_flags(flags);
+    return (void *)(FRAME_POOL_START + (i * 32 + bit) * FRAME_SIZE);
+  }
+  restore_flags(flags);
+  return NULL;
+}
+
+/*
+* Function: free_frame
+* Description: Returns a frame from alloc_frame to the pool
+* Inputs: frame - the frame to free
+* Outputs: none
+*/
+void free_frame(void *frame)
+{
+  uint32_t flags;
+  uint32_t index = ((uint32_t)frame - FRAME_POOL_START) / FRAME_SIZE;
+
+  if((uint32_t)frame < FRAME_POOL_START || (uint32_t)frame >= FRAME_POOL_END)
+    return;
+
+  cli_and_save(flags);
+  if(frameMap[index / 32] & (1 << (index % 32)))
+  {
+    frameMap[index / 32] &= ~(1 << (index % 32));
+    framesFree++;
+  }
+  restore_flags(flags);
+}
+
+/*
+* Function: free_frames
+* Description: Counts the frames left in the pool
+* Inputs: none
+* Outputs: number of free frames
+*/
+uint32_t free_frames(void)
+{
+  return framesFree;
+}
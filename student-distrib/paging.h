@@ -1,8 +1,26 @@
 /*
 *	paging.h - paging.c header file
 */
+#ifndef PAGING_H_
+#define PAGING_H_
+
 #include "types.h"
 
+// Physical frames handed out by alloc_frame, identity mapped for the kernel
+#define FRAME_POOL_START    0x2000000     // 32MB, just past the last process
+#define FRAME_POOL_END      0x4000000     // 64MB
+#define FRAME_SIZE          4096
+#define NUM_FRAMES          ((FRAME_POOL_END - FRAME_POOL_START) / FRAME_SIZE)
+
+// The kernel's own identity mapped 4MB page, small modules load here too
+#define KERNEL_PAGE_START   0x400000
+#define KERNEL_PAGE_END     0x800000
+#define LARGE_PAGE_SIZE     0x400000
+
+// Kernel only windows onto physical memory outside the identity maps
+#define MOUNT_PAGES_START   0x4000000     // 64MB, one 4MB page per mount
+#define ROFS_WINDOW         0x7C00000     // 124MB, rofs data streams through here
+
 //global arrays
 extern uint32_t pageDir[1024] __attribute__((aligned(4096)));
 extern uint32_t pageTable[1024] __attribute__((aligned(4096)));
@@ -12,5 +30,12 @@ void init_paging();
 void remap(uint32_t vAddr, uint32_t pAddr);
 void remapWithPageTable(uint32_t vAddr, uint32_t pAddr);
 void remapVideo(uint32_t vAddr, uint32_t pAddr);
+void remapVideoPage(uint32_t pAddr);
 void remapToPage(uint32_t vAddr, uint32_t pAddr, uint32_t page);
+void map_kernel_page(uint32_t vAddr, uint32_t pAddr);
 void refresh_tbl(void);
+void *alloc_frame(void);
+void free_frame(void *frame);
+uint32_t free_frames(void);
+
+#endif
@@ -0,0 +1,278 @@
+#include "pipe.h"
+
+#include "lib.h"
+#include "paging.h"
+#include "syscalls.h"
+
+static pipe_t pipes[MAX_PIPES];
+
+/*
+ * pipe_create()
+ *
+ * DESCRIPTION: Takes a free pipe and a frame for its buffer
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * RETURNS: the pipe's index, -1 if there are no pipes or frames left
+ * SIDE EFFECTS: allocates a frame
+ */
+int32_t pipe_create(void) {
+    int32_t i;
+    for (i = 0; i < MAX_PIPES; i++) {
+        if (!pipes[i].in_use) {
+            break;
+        }
+    }
+
+    if (i == MAX_PIPES) {
+        return -1;
+    }
+
+    pipes[i].buf = alloc_frame();
+    if (pipes[i].buf == NULL) {
+        return -1;
+    }
+
+    pipes[i].in_use = 1;
+    pipes[i].head = 0;
+    pipes[i].tail = 0;
+    pipes[i].readers = 1;
+    pipes[i].writers = 1;
+    return i;
+}
+
+/*
+ * pipe_release(index, writer)
+ *
+ * DESCRIPTION: Drops one end of a pipe. With no writers left the reader
+ *              gets end of file once it drains what is buffered, with no
+ *              readers left writes fail.
+ *
+ * INPUTS: 	index - the pipe
+ *          writer - 1 for the write end, 0 for the read end
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: frees the pipe's frame when both sides are closed
+ */
+void pipe_release(int32_t index, uint32_t writer) {
+    pipe_t *p = &pipes[index];
+
+    if (writer) {
+        p->writers--;
+    } else {
+        p->readers--;
+    }
+
+    wake_up(&p->wait);
+    if (p->readers == 0 && p->writers == 0) {
+        free_frame(p->buf);
+        p->buf = NULL;
+        p->in_use = 0;
+    }
+}
+
+/*
+ * pipe_put(index, buf, nbytes)
+ *
+ * DESCRIPTION: Copies bytes into a pipe, as many as there is room for.
+ *              tail only moves once they are in the buffer.
+ *
+ * INPUTS: 	index - the pipe
+ *          buf - data
+ *          nbytes - bytes to write
+ * OUTPUTS: none
+ *
+ * RETURNS: bytes written, 0 if the pipe is full
+ * SIDE EFFECTS: none
+ */
+int32_t pipe_put(int32_t index, const uint8_t *buf, uint32_t nbytes) {
+    pipe_t *p = &pipes[index];
+    uint32_t tail = p->tail;
+    uint32_t room = PIPE_SIZE - (tail - p->head);
+    uint32_t offset = tail & (PIPE_SIZE - 1);
+    uint32_t first;
+
+    if (nbytes > room) {
+        nbytes = room;
+    }
+
+    // The free space may wrap around the end of the buffer
+    first = PIPE_SIZE - offset < nbytes ? PIPE_SIZE - offset : nbytes;
+    memcpy(p->buf + offset, buf, first);
+    memcpy(p->buf, buf + first, nbytes - first);
+
+    p->tail = tail + nbytes;
+    wake_up(&p->wait);
+    return nbytes;
+}
+
+/*
+ * pipe_get(index, buf, nbytes)
+ *
+ * DESCRIPTION: Copies bytes out of a pipe, as many as are buffered.
+ *              head only moves once they are copied.
+ *
+ * INPUTS: 	index - the pipe
+ *          nbytes - most bytes to read
+ * OUTPUTS: buf - the data
+ *
+ * RETURNS: bytes read, 0 if the pipe is empty
+ * SIDE EFFECTS: none
+ */
+int32_t pipe_get(int32_t index, uint8_t *buf, uint32_t nbytes) {
+    pipe_t *p = &pipes[index];
+    uint32_t head = p->head;
+    uint32_t used = p->tail - head;
+    uint32_t offset = head & (PIPE_SIZE - 1);
+    uint32_t first;
+
+    if (nbytes > used) {
+        nbytes = used;
+    }
+
+    first = PIPE_SIZE - offset < nbytes ? PIPE_SIZE - offset : nbytes;
+    memcpy(buf, p->buf + offset, first);
+    memcpy(buf + first, p->buf, nbytes - first);
+
+    p->head = head + nbytes;
+    wake_up(&p->wait);
+    return nbytes;
+}
+
+/*
+ * pipe_read(fd, buf, nbytes)
+ *
+ * DESCRIPTION: Reads what is buffered in a pipe. An empty pipe with a
+ *              writer still open blocks: the other stages of the pipeline
+ *              run until something arrives.
+ *
+ * INPUTS: 	fd - the read end
+ *          nbytes - most bytes to read
+ * OUTPUTS: buf - the data
+ *
+ * RETURNS: bytes read, 0 at end of file, -1 if nothing could ever
+ *          arrive because no other process holds the write end
+ * SIDE EFFECTS: may switch to another process
+ */
+int32_t pipe_read(int32_t fd, void *buf, int32_t nbytes) {
+    int32_t index = get_file(fd)->inode;
+    int32_t count;
+
+    if (nbytes <= 0) {
+        return 0;
+    }
+
+    while ((count = pipe_get(index, buf, nbytes)) == 0) {
+        if (pipes[index].writers == 0) {
+            return 0;
+        }
+
+        if (pipeline_yield()) {
+            return -1;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * pipe_write(fd, buf, nbytes)
+ *
+ * DESCRIPTION: Writes all of buf to a pipe. A full pipe blocks: the other
+ *              stages of the pipeline run until it has room.
+ *
+ * INPUTS: 	fd - the write end
+ *          buf - data
+ *          nbytes - bytes to write
+ * OUTPUTS: none
+ *
+ * RETURNS: bytes written, which is short only if the pipe filled and no
+ *          other process can empty it, -1 if there are no readers
+ * SIDE EFFECTS: may switch to another process
+ */
+int32_t pipe_write(int32_t fd, const void *buf, int32_t nbytes) {
+    int32_t index = get_file(fd)->inode;
+    int32_t done = 0;
+
+    while (done < nbytes) {
+        if (pipes[index].readers == 0) {
+            return done > 0 ? done : -1;
+        }
+
+        done += pipe_put(index, (const uint8_t *) buf + done, nbytes - done);
+        if (done < nbytes && pipeline_yield()) {
+            return done > 0 ? done : -1;
+        }
+    }
+
+    return done;
+}
+
+/*
+ * pipe_close(fd)
+ *
+ * DESCRIPTION: Closes one end of a pipe
+ *
+ * INPUTS: 	fd - the end
+ * OUTPUTS: none
+ *
+ * RETURNS: 0
+ * SIDE EFFECTS: see pipe_release
+ */
+int32_t pipe_close(int32_t fd) {
+    file_t *file = get_file(fd);
+    pipe_release(file->inode, file->flags & FILE_PIPE_WRITER);
+    return 0;
+}
+
+/*
+ * pipe_stat(fd, buf)
+ *
+ * DESCRIPTION: Gets information about a pipe end, the length being what
+ *              is buffered right now
+ *
+ * INPUTS: 	fd - the end
+ * OUTPUTS: buf - the information
+ *
+ * RETURNS: 0
+ * SIDE EFFECTS: none
+ */
+int32_t pipe_stat(int32_t fd, stat_t *buf) {
+    file_t *file = get_file(fd);
+    pipe_t *p = &pipes[file->inode];
+
+    buf->file_type = fifo;
+    buf->inode_num = file->inode;
+    buf->length = p->tail - p->head;
+    buf->num_blocks = 1;
+    return 0;
+}
+
+/*
+ * pipe_poll(fd, pt)
+ *
+ * DESCRIPTION: Readiness callback for either end
+ *
+ * INPUTS: 	fd - the end
+ *          pt - the poll call's table
+ * OUTPUTS: none
+ *
+ * RETURNS: for the read end POLLIN with bytes buffered and POLLHUP once
+ *          no writers are left; for the write end POLLOUT with room and
+ *          POLLERR once no readers are left
+ * SIDE EFFECTS: none
+ */
+int32_t pipe_poll(int32_t fd, poll_table_t *pt) {
+    file_t *file = get_file(fd);
+    pipe_t *p = &pipes[file->inode];
+    uint32_t used;
+
+    poll_wait(pt, &p->wait);
+    used = p->tail - p->head;
+    if (file->flags & FILE_PIPE_WRITER) {
+        return (used < PIPE_SIZE ? POLLOUT : 0) | (p->readers == 0 ? POLLERR : 0);
+    }
+
+    return (used > 0 ? POLLIN : 0) | (p->writers == 0 ? POLLHUP : 0);
+}
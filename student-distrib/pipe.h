@@ -0,0 +1,42 @@
+#ifndef PIPE_H_
+#define PIPE_H_
+
+#include "types.h"
+#include "poll.h"
+#include "rofs.h"
+
+#define MAX_PIPES   8
+// One frame per pipe, a power of two so indices wrap with a mask
+#define PIPE_SIZE   4096
+
+/*
+ * A single producer, single consumer ring. head and tail count up forever;
+ * only the reader moves head and only the writer moves tail, each after it
+ * has copied the bytes, so neither end needs a lock against the other.
+ */
+typedef struct pipe {
+    uint32_t in_use;
+    uint8_t *buf;               // Frame from the pool
+    volatile uint32_t head;     // Next byte to read
+    volatile uint32_t tail;     // Next byte to write
+    uint32_t readers;           // Open read ends
+    uint32_t writers;           // Open write ends
+    wait_queue_t wait;          // Woken when either end moves or closes
+} pipe_t;
+
+/* Makes a pipe with one read end and one write end open */
+int32_t pipe_create(void);
+/* Drops one end of a pipe, freeing it once both sides are gone */
+void pipe_release(int32_t index, uint32_t writer);
+/* Copies in as much as fits right now */
+int32_t pipe_put(int32_t index, const uint8_t *buf, uint32_t nbytes);
+/* Copies out as much as is there right now */
+int32_t pipe_get(int32_t index, uint8_t *buf, uint32_t nbytes);
+
+int32_t pipe_read(int32_t fd, void *buf, int32_t nbytes);
+int32_t pipe_write(int32_t fd, const void *buf, int32_t nbytes);
+int32_t pipe_close(int32_t fd);
+int32_t pipe_stat(int32_t fd, stat_t *buf);
+int32_t pipe_poll(int32_t fd, poll_table_t *pt);
+
+#endif
@@ -0,0 +1,57 @@
+#include "pit.h"
+#include "bcache.h"
+#include "i8259.h"
+#include "keyboard.h"
+#include "lib.h"
+#include "printk.h"
+
+volatile uint32_t pit_ticks = 0;
+
+/*
+ * init_pit(void)
+ *
+ * DESCRIPTION: Programs channel 0 of the PIT to interrupt at PIT_TICK_HZ
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Enables the timer PIC line
+ *
+ */
+void init_pit() {
+    uint32_t divisor = PIT_BASE_FREQ / PIT_TICK_HZ;
+
+    cli();
+    outb(PIT_SQUARE_WAVE, PIT_COMMAND_PORT);
+    outb(divisor & 0xFF, PIT_CHANNEL0_PORT);
+    outb((divisor >> 8) & 0xFF, PIT_CHANNEL0_PORT);
+
+    pit_ticks = 0;
+    enable_irq(PIT_IRQ_LINE);
+    sti();
+}
+
+/*
+ * pit_handler(void)
+ *
+ * DESCRIPTION: Processes interrupts generated by the PIT
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Advances the tick count, runs the buffer cache flusher,
+ *               sends logged messages to the console, echoes keys that
+ *               waited for the screen
+ *
+ */
+void pit_handler() {
+    pit_ticks++;
+
+    // Send eoi to PIC
+    send_eoi(PIT_IRQ_LINE);
+
+    // Deferred work runs after the eoi so later ticks still arrive
+    bcache_flush_tick();
+    log_drain_tick();
+    keyboard_drain_tick();
+}
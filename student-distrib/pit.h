@@ -0,0 +1,23 @@
+#ifndef PIT_H_
+#define PIT_H_
+
+#include "types.h"
+
+#define PIT_CHANNEL0_PORT   0x40
+#define PIT_COMMAND_PORT    0x43
+
+// Channel 0, lobyte/hibyte access, mode 3 (square wave)
+#define PIT_SQUARE_WAVE     0x36
+
+#define PIT_BASE_FREQ       1193182
+#define PIT_TICK_HZ         1000
+
+/* Milliseconds since the PIT was started */
+extern volatile uint32_t pit_ticks;
+
+/* Starts the 1 kHz system tick */
+extern void init_pit();
+/* Handle timer interrupts */
+extern void pit_handler();
+
+#endif
@@ -0,0 +1,183 @@
+#include "poll.h"
+
+#include "lib.h"
+#include "pit.h"
+#include "syscalls.h"
+
+/*
+ * wake_up(wq)
+ *
+ * DESCRIPTION: Wakes everything sleeping on a queue. Cheap enough for
+ *              interrupt handlers to call on every event.
+ *
+ * INPUTS: 	wq - the queue
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: none
+ */
+void wake_up(wait_queue_t *wq) {
+    wq->wakeups++;
+}
+
+/*
+ * poll_wait(pt, wq)
+ *
+ * DESCRIPTION: Adds a queue to the ones a poll call sleeps on. Readiness
+ *              callbacks call it before they look at their file, so an
+ *              event between the look and the sleep still wakes it.
+ *
+ * INPUTS: 	pt - the poll call's table, NULL to only check readiness
+ *          wq - the queue
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: none
+ */
+void poll_wait(poll_table_t *pt, wait_queue_t *wq) {
+    uint32_t i;
+
+    if (pt == NULL) {
+        return;
+    }
+
+    // fds on the same file share a queue
+    for (i = 0; i < pt->count; i++) {
+        if (pt->queues[i] == wq) {
+            return;
+        }
+    }
+
+    if (pt->count < POLL_MAX_FDS) {
+        pt->queues[pt->count] = wq;
+        pt->seen[pt->count] = wq->wakeups;
+        pt->count++;
+    }
+}
+
+/*
+ * poll_always(fd, pt)
+ *
+ * DESCRIPTION: Readiness callback for files whose reads and writes never
+ *              wait: files, directories and block devices
+ *
+ * INPUTS: 	fd - ignored
+ *          pt - ignored
+ * OUTPUTS: none
+ *
+ * RETURNS: POLLIN | POLLOUT
+ * SIDE EFFECTS: none
+ */
+int32_t poll_always(int32_t fd, poll_table_t *pt) {
+    return POLLIN | POLLOUT;
+}
+
+/*
+ * file_readable(fd)
+ *
+ * DESCRIPTION: Asks an open file's readiness callback whether a read
+ *              would return without waiting, with data, end of file or
+ *              an error
+ *
+ * INPUTS: 	fd - the open file
+ * OUTPUTS: none
+ *
+ * RETURNS: 1 if it would, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+uint32_t file_readable(int32_t fd) {
+    return (get_file(fd)->fileops.poll(fd, NULL) & (POLLIN | POLLERR | POLLHUP)) != 0;
+}
+
+/*
+ * woken(pt)
+ *
+ * DESCRIPTION: Checks whether any queue a poll call sleeps on was woken
+ *              since it started watching
+ *
+ * INPUTS: 	pt - the poll call's table
+ * OUTPUTS: none
+ *
+ * RETURNS: 1 if one was, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+static uint32_t woken(poll_table_t *pt) {
+    uint32_t i;
+    for (i = 0; i < pt->count; i++) {
+        if (pt->queues[i]->wakeups != pt->seen[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * poll(fds, nfds, timeout)
+ *
+ * DESCRIPTION: Checks each fd with its file's readiness callback and
+ *              fills in revents with the asked-for events that hold,
+ *              plus POLLERR, POLLHUP and POLLNVAL. Negative fds are
+ *              skipped. If none is ready it sleeps on every callback's
+ *              wait queue at once, letting the rest of a pipeline run
+ *              first, and checks again after the first wakeup.
+ *
+ * INPUTS: 	fds - the fds to watch
+ *          nfds - how many, up to POLL_MAX_FDS
+ *          timeout - milliseconds to wait, 0 not to wait, -1 forever
+ * OUTPUTS: fds - revents set
+ *
+ * RETURNS: fds with revents set, 0 after the timeout, -1 if fds is bad
+ * SIDE EFFECTS: may switch to another stage of the pipeline
+ */
+int32_t poll(pollfd_t *fds, uint32_t nfds, int32_t timeout) {
+    uint32_t start = pit_ticks;
+    poll_table_t pt;
+    int32_t ready;
+    uint32_t i;
+
+    // The array has to be in the process's page
+    if (nfds > POLL_MAX_FDS || (nfds > 0 && !in_user_page(fds, nfds * sizeof(pollfd_t)))) {
+        return -1;
+    }
+
+    while (1) {
+        pt.count = 0;
+        ready = 0;
+        for (i = 0; i < nfds; i++) {
+            file_t *file;
+            int32_t mask;
+
+            fds[i].revents = 0;
+            if (fds[i].fd < 0) {
+                continue;
+            }
+
+            file = get_file(fds[i].fd);
+            if (file == NULL) {
+                mask = POLLNVAL;
+            } else if ((mask = file->fileops.poll(fds[i].fd, &pt)) < 0) {
+                mask = POLLERR;
+            }
+
+            fds[i].revents = mask & (fds[i].events | POLLERR | POLLHUP | POLLNVAL);
+            if (fds[i].revents) {
+                ready++;
+            }
+        }
+
+        if (ready > 0 || timeout == 0) {
+            return ready;
+        }
+
+        while (!woken(&pt)) {
+            if (timeout > 0 && pit_ticks - start >= (uint32_t) timeout) {
+                return 0;
+            }
+
+            // The other stages may be what a pipe end waits on; when
+            // there are none, or they had nothing for it, sleep until
+            // an interrupt
+            if (pipeline_yield() || !woken(&pt)) {
+                asm volatile ("sti; hlt" : : : "memory");
+            }
+        }
+    }
+}
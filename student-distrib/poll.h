@@ -0,0 +1,51 @@
+#ifndef POLL_H_
+#define POLL_H_
+
+#include "types.h"
+
+// What a file can do without waiting, the same bits as Linux
+#define POLLIN          0x0001
+#define POLLOUT         0x0004
+#define POLLERR         0x0008  // Always reported, never asked for
+#define POLLHUP         0x0010  // Likewise: the other end of a pipe is gone
+#define POLLNVAL        0x0020  // Likewise: the fd is not open
+
+// Most fds one poll call watches
+#define POLL_MAX_FDS    32
+
+/*
+ * Something a sleeper waits on. Whatever makes a file ready wakes its
+ * queue, which counts up wakeups; a sleeper notes the count when it
+ * starts watching and wakes once it moves.
+ */
+typedef struct wait_queue {
+    volatile uint32_t wakeups;
+} wait_queue_t;
+
+// The queues one poll call sleeps on, with the count each had
+typedef struct poll_table {
+    uint32_t count;
+    wait_queue_t *queues[POLL_MAX_FDS];
+    uint32_t seen[POLL_MAX_FDS];
+} poll_table_t;
+
+// One fd to watch, laid out like struct pollfd
+typedef struct pollfd {
+    int32_t fd;
+    int16_t events;
+    int16_t revents;
+} pollfd_t;
+
+/* Wakes everything sleeping on a queue */
+void wake_up(wait_queue_t *wq);
+/* Has a poll call sleep on a queue, called before looking at the state */
+void poll_wait(poll_table_t *pt, wait_queue_t *wq);
+/* Readiness of files that never wait, such as regular files */
+int32_t poll_always(int32_t fd, poll_table_t *pt);
+/* Says whether a file's read would return without waiting */
+uint32_t file_readable(int32_t fd);
+
+/* Waits for any of several fds to be ready */
+int32_t poll(pollfd_t *fds, uint32_t nfds, int32_t timeout);
+
+#endif
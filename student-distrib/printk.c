@@ -0,0 +1,383 @@
+#include "printk.h"
+
+#include "lib.h"
+#include "pit.h"
+#include "serial.h"
+#include "syscalls.h"
+
+// One logged message. seq is its sequence number plus one once the text
+// is in, and anything else while it is being written or reused.
+typedef struct log_record {
+    volatile uint32_t seq;
+    uint32_t ticks;
+    uint16_t level;
+    uint16_t length;
+    int8_t text[LOG_TEXT_SIZE];
+} log_record_t;
+
+// The newest LOG_RECORDS messages. Writers take a sequence number with
+// one atomic add and fill its slot, so printk never waits for anyone, an
+// interrupt that logs in the middle of another printk included.
+static log_record_t log_ring[LOG_RECORDS];
+static volatile uint32_t log_next;
+
+// Next message for the console, and whether a drain is running
+static uint32_t console_seq;
+static uint32_t draining;
+
+// Woken for every message
+static wait_queue_t log_wait;
+
+/*
+ * reserve(seq)
+ *
+ * DESCRIPTION: Takes the next sequence number and its slot, marking the
+ *              slot as being written
+ *
+ * INPUTS: 	none
+ * OUTPUTS: seq - the sequence number
+ *
+ * RETURNS: the slot
+ * SIDE EFFECTS: none
+ */
+static log_record_t *reserve(uint32_t *seq) {
+    log_record_t *rec;
+    uint32_t s = 1;
+
+    asm volatile ("lock xaddl %0, %1" : "+r" (s), "+m" (log_next) : : "memory", "cc");
+
+    rec = &log_ring[s & (LOG_RECORDS - 1)];
+    rec->seq = 0;
+    rec->ticks = pit_ticks;
+    *seq = s;
+    return rec;
+}
+
+/*
+ * commit(rec, seq, level, length)
+ *
+ * DESCRIPTION: Finishes a message whose text is in its slot. Trailing
+ *              line breaks are dropped, every message is one line.
+ *
+ * INPUTS: 	rec - the slot
+ *          seq - its sequence number
+ *          level - KERN_ERR and so on
+ *          length - length of the text, even past the slot
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: wakes readers of the log
+ */
+static void commit(log_record_t *rec, uint32_t seq, int32_t level, int32_t length) {
+    if (length > LOG_TEXT_SIZE - 1) {
+        length = LOG_TEXT_SIZE - 1;
+    }
+    while (length > 0 && rec->text[length - 1] == '\n') {
+        length--;
+    }
+
+    rec->level = level < 0 ? 0 : level > KERN_DEBUG ? KERN_DEBUG : level;
+    rec->length = length;
+    asm volatile ("" : : : "memory");
+    rec->seq = seq + 1;
+    wake_up(&log_wait);
+}
+
+/*
+ * next_record(seq, copy)
+ *
+ * DESCRIPTION: Copies out the first message at or after a sequence
+ *              number that is still kept, checking afterwards that no
+ *              writer reused its slot during the copy
+ *
+ * INPUTS: 	seq - sequence number to start at
+ * OUTPUTS: seq - the copied message's, or where to try again
+ *          copy - the message
+ *
+ * RETURNS: 0 if there was one, -1 if the next is not written yet
+ * SIDE EFFECTS: none
+ */
+static int32_t next_record(uint32_t *seq, log_record_t *copy) {
+    while (*seq != log_next) {
+        log_record_t *rec = &log_ring[*seq & (LOG_RECORDS - 1)];
+
+        // Overwritten since, skip to the oldest kept
+        if (log_next - *seq > LOG_RECORDS) {
+            *seq = log_next - LOG_RECORDS;
+            continue;
+        }
+
+        if (rec->seq == *seq + 1) {
+            memcpy(copy, rec, sizeof(log_record_t));
+            if (rec->seq == *seq + 1) {
+                return 0;
+            }
+        }
+
+        // Still being written, unless it was overwritten meanwhile
+        if (log_next - *seq <= LOG_RECORDS) {
+            return -1;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * format_line(rec, line, with_level)
+ *
+ * DESCRIPTION: Writes a message as a line: its level if asked for, the
+ *              seconds and milliseconds since boot it was logged at, then
+ *              the text
+ *
+ * INPUTS: 	rec - the message
+ *          with_level - 1 to start with "<level>"
+ * OUTPUTS: line - LOG_LINE_SIZE bytes for the line
+ *
+ * RETURNS: length of the line
+ * SIDE EFFECTS: none
+ */
+static int32_t format_line(const log_record_t *rec, int8_t *line, uint32_t with_level) {
+    int32_t length = 0;
+
+    if (with_level) {
+        length = snprintf(line, LOG_LINE_SIZE, "<%u>", rec->level);
+    }
+    length += snprintf(&line[length], LOG_LINE_SIZE - length, "[%5u.%03u] ", rec->ticks / 1000, rec->ticks % 1000);
+
+    memcpy(&line[length], rec->text, rec->length);
+    length += rec->length;
+    line[length++] = '\n';
+    return length;
+}
+
+/*
+ * drain(max)
+ *
+ * DESCRIPTION: Sends logged messages at CONSOLE_LOGLEVEL or below to the
+ *              screen, and to the serial port when there is one. Stops
+ *              early while the screen is being drawn by whatever it
+ *              interrupted or the serial ring is full, to go on later.
+ *
+ * INPUTS: 	max - most messages to look at
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: draws on the current terminal
+ */
+static void drain(uint32_t max) {
+    log_record_t rec;
+    int8_t line[LOG_LINE_SIZE];
+    int32_t length;
+    uint32_t flags;
+    uint32_t i;
+
+    cli_and_save(flags);
+    if (draining) {
+        restore_flags(flags);
+        return;
+    }
+    draining = 1;
+
+    for (i = 0; i < max && !next_record(&console_seq, &rec); i++) {
+        if (rec.level <= CONSOLE_LOGLEVEL) {
+            if (console_busy()) {
+                break;
+            }
+
+            length = format_line(&rec, line, 0);
+            if (serial_present() && serial_try_write(line, length) < 0) {
+                break;
+            }
+            putn((uint8_t *) line, length);
+        }
+        console_seq++;
+    }
+
+    draining = 0;
+    restore_flags(flags);
+}
+
+/*
+ * printk(level, format, ...)
+ *
+ * DESCRIPTION: Logs a message, formatted like printf, with its level and
+ *              the time. It only goes into the log; the timer tick sends
+ *              it to the console later, so this is safe anywhere, with
+ *              interrupts on or off. Text past LOG_TEXT_SIZE is cut.
+ *
+ * INPUTS: 	level - KERN_ERR and so on
+ *          format - format string
+ * OUTPUTS: none
+ *
+ * RETURNS: length of the formatted text
+ * SIDE EFFECTS: may overwrite the oldest message
+ */
+int32_t printk(int32_t level, int8_t *format, ...) {
+    uint32_t seq;
+    log_record_t *rec = reserve(&seq);
+    int32_t length;
+    va_list args;
+
+    va_start(args, format);
+    length = vsnprintf(rec->text, LOG_TEXT_SIZE, format, args);
+    va_end(args);
+
+    commit(rec, seq, level, length);
+    return length;
+}
+
+/*
+ * log_drain_tick()
+ *
+ * DESCRIPTION: Called on every timer tick after the PIC is acknowledged;
+ *              sends up to LOG_DRAIN_BATCH messages to the console, so a
+ *              burst of them spreads over several ticks
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: draws on the current terminal
+ */
+void log_drain_tick(void) {
+    if (console_seq != log_next) {
+        drain(LOG_DRAIN_BATCH);
+    }
+}
+
+/*
+ * log_flush()
+ *
+ * DESCRIPTION: Sends every waiting message to the console now, for when
+ *              the next tick may be too late, like before halting a
+ *              process on an exception
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: draws on the current terminal
+ */
+void log_flush(void) {
+    drain(LOG_RECORDS);
+}
+
+/*
+ * kmsg_open(filename)
+ *
+ * DESCRIPTION: Opens the log, reads start at the oldest message kept
+ *
+ * INPUTS: 	filename - ignored
+ * OUTPUTS: none
+ *
+ * RETURNS: 0
+ * SIDE EFFECTS: none
+ */
+int32_t kmsg_open(const int8_t *filename) {
+    return 0;
+}
+
+/*
+ * kmsg_close(fd)
+ *
+ * DESCRIPTION: Closes the log
+ *
+ * INPUTS: 	fd - ignored
+ * OUTPUTS: none
+ *
+ * RETURNS: 0
+ * SIDE EFFECTS: none
+ */
+int32_t kmsg_close(int32_t fd) {
+    return 0;
+}
+
+/*
+ * kmsg_read(fd, buf, nbytes)
+ *
+ * DESCRIPTION: Reads the next message as a line "<level>[seconds] text".
+ *              Messages overwritten since the last read are skipped. A
+ *              line longer than nbytes is cut.
+ *
+ * INPUTS: 	fd - the open log, its position is a sequence number
+ *          nbytes - most bytes to read
+ * OUTPUTS: buf - the line
+ *
+ * RETURNS: bytes read, 0 once there are no more messages
+ * SIDE EFFECTS: advances the position
+ */
+int32_t kmsg_read(int32_t fd, void *buf, int32_t nbytes) {
+    file_t *file = get_file(fd);
+    uint32_t seq = file->pos;
+    log_record_t rec;
+    int8_t line[LOG_LINE_SIZE];
+    int32_t length;
+
+    if (nbytes <= 0) {
+        return 0;
+    }
+
+    if (next_record(&seq, &rec)) {
+        file->pos = seq;
+        return 0;
+    }
+
+    length = format_line(&rec, line, 1);
+    if (length > nbytes) {
+        length = nbytes;
+    }
+    memcpy(buf, line, length);
+    file->pos = seq + 1;
+    return length;
+}
+
+/*
+ * kmsg_write(fd, buf, nbytes)
+ *
+ * DESCRIPTION: Logs a message from a program at KERN_INFO, or at the
+ *              level it starts with as "<level>"
+ *
+ * INPUTS: 	fd - ignored
+ *          buf - the text
+ *          nbytes - its length
+ * OUTPUTS: none
+ *
+ * RETURNS: nbytes
+ * SIDE EFFECTS: may overwrite the oldest message
+ */
+int32_t kmsg_write(int32_t fd, const void *buf, int32_t nbytes) {
+    const int8_t *text = (const int8_t *) buf;
+    int32_t level = KERN_INFO;
+    int32_t length = nbytes;
+    log_record_t *rec;
+    uint32_t seq;
+
+    if (nbytes < 0) {
+        return -1;
+    }
+
+    if (length >= 3 && text[0] == '<' && text[1] >= '0' && text[1] <= '0' + KERN_DEBUG && text[2] == '>') {
+        level = text[1] - '0';
+        text += 3;
+        length -= 3;
+    }
+
+    rec = reserve(&seq);
+    memcpy(rec->text, text, length < LOG_TEXT_SIZE ? length : LOG_TEXT_SIZE);
+    commit(rec, seq, level, length);
+    return nbytes;
+}
+
+/*
+ * kmsg_poll(fd, pt)
+ *
+ * DESCRIPTION: Readiness callback for the log
+ *
+ * INPUTS: 	fd - the open log
+ *          pt - the poll call's table
+ * OUTPUTS: none
+ *
+ * RETURNS: POLLIN if there is a message past the position, and POLLOUT
+ * SIDE EFFECTS: none
+ */
+int32_t kmsg_poll(int32_t fd, poll_table_t *pt) {
+    poll_wait(pt, &log_wait);
+    return ((uint32_t) get_file(fd)->pos != log_next ? POLLIN : 0) | POLLOUT;
+}
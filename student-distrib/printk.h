@@ -0,0 +1,40 @@
+#ifndef PRINTK_H_
+#define PRINTK_H_
+
+#include "types.h"
+#include "poll.h"
+
+// How urgent a message is, lower is more, numbered as in Linux
+#define KERN_ERR            3
+#define KERN_WARNING        4
+#define KERN_INFO           6
+#define KERN_DEBUG          7
+// Messages up to this level also go to the screen and the serial port
+#define CONSOLE_LOGLEVEL    KERN_INFO
+
+// Messages kept, a power of two, and the most text one holds
+#define LOG_RECORDS         256
+#define LOG_TEXT_SIZE       116
+// A message as a line: "<7>[4294967.295] ", the text and '\n'
+#define LOG_LINE_SIZE       (LOG_TEXT_SIZE + 20)
+// Most messages each timer tick sends to the console
+#define LOG_DRAIN_BATCH     8
+
+// What the log is called under DEV_MOUNT
+#define KMSG_NAME           "kmsg"
+
+/* Logs a message without waiting, safe from interrupt handlers */
+int32_t printk(int32_t level, int8_t *format, ...);
+/* Sends a few logged messages to the console, called on every tick */
+void log_drain_tick(void);
+/* Sends every logged message to the console now */
+void log_flush(void);
+
+// The log as a file
+int32_t kmsg_open(const int8_t *filename);
+int32_t kmsg_close(int32_t fd);
+int32_t kmsg_read(int32_t fd, void *buf, int32_t nbytes);
+int32_t kmsg_write(int32_t fd, const void *buf, int32_t nbytes);
+int32_t kmsg_poll(int32_t fd, poll_table_t *pt);
+
+#endif
@@ -0,0 +1,119 @@
+#include "ramdisk.h"
+
+#include "lib.h"
+#include "paging.h"
+
+static ramdisk_t ramdisks[MAX_RAMDISKS];
+
+/*
+ * ramdisk_start(dev, req)
+ *
+ * DESCRIPTION: Copies a request's blocks to or from the frames holding
+ *              them and completes it right away
+ *
+ * INPUTS: 	dev - the ramdisk
+ *          req - the head request, already checked against the size
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: completes the request
+ */
+static void ramdisk_start(block_device_t *dev, block_request_t *req) {
+    ramdisk_t *disk = (ramdisk_t *) dev->driver;
+    uint32_t offset = req->block * RAMDISK_BLOCK_SIZE;
+    uint32_t left = req->count * RAMDISK_BLOCK_SIZE;
+    uint8_t *buf = req->buf;
+
+    while (left > 0) {
+        uint8_t *frame = disk->frames[offset / FRAME_SIZE] + offset % FRAME_SIZE;
+        uint32_t length = FRAME_SIZE - offset % FRAME_SIZE;
+        if (length > left) {
+            length = left;
+        }
+
+        if (req->write) {
+            memcpy(frame, buf, length);
+        } else {
+            memcpy(buf, frame, length);
+        }
+
+        buf += length;
+        offset += length;
+        left -= length;
+    }
+
+    block_complete(dev, 0);
+}
+
+static const block_ops_t ramdisk_ops = {ramdisk_start};
+
+/*
+ * free_ramdisk(disk)
+ *
+ * DESCRIPTION: Gives a ramdisk's frames back to the pool
+ *
+ * INPUTS: 	disk - the ramdisk
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: frees frames
+ */
+static void free_ramdisk(ramdisk_t *disk) {
+    uint32_t i;
+
+    for (i = 0; i < disk->num_frames; i++) {
+        free_frame(disk->frames[i]);
+    }
+    free_frame(disk->frames);
+    disk->frames = NULL;
+    disk->num_frames = 0;
+}
+
+/*
+ * ramdisk_create(name, size)
+ *
+ * DESCRIPTION: Makes a zeroed ramdisk out of frames from the pool and
+ *              registers it with the block layer
+ *
+ * INPUTS: 	name - device name
+ *          size - bytes, rounded down to whole frames, at most
+ *                 RAMDISK_MAX_SIZE
+ * OUTPUTS: none
+ *
+ * RETURNS: the device, or NULL if there is no room
+ * SIDE EFFECTS: allocates frames
+ */
+block_device_t *ramdisk_create(const int8_t *name, uint32_t size) {
+    ramdisk_t *disk = NULL;
+    block_device_t *dev;
+    uint32_t i;
+
+    size -= size % FRAME_SIZE;
+    if (size == 0 || size > RAMDISK_MAX_SIZE) {
+        return NULL;
+    }
+
+    for (i = 0; i < MAX_RAMDISKS && disk == NULL; i++) {
+        if (ramdisks[i].frames == NULL) {
+            disk = &ramdisks[i];
+        }
+    }
+
+    if (disk == NULL || (disk->frames = (uint8_t **) alloc_frame()) == NULL) {
+        return NULL;
+    }
+
+    while (disk->num_frames < size / FRAME_SIZE) {
+        uint8_t *frame = (uint8_t *) alloc_frame();
+        if (frame == NULL) {
+            free_ramdisk(disk);
+            return NULL;
+        }
+        memset(frame, 0, FRAME_SIZE);
+        disk->frames[disk->num_frames++] = frame;
+    }
+
+    dev = register_block_device(name, RAMDISK_BLOCK_SIZE, size / RAMDISK_BLOCK_SIZE, &ramdisk_ops, disk);
+    if (dev == NULL) {
+        free_ramdisk(disk);
+    }
+    return dev;
+}
@@ -0,0 +1,25 @@
+#ifndef RAMDISK_H_
+#define RAMDISK_H_
+
+#include "types.h"
+#include "block.h"
+
+// Sector size, the same as a disk so both look alike to the cache
+#define RAMDISK_BLOCK_SIZE  512
+// One frame of frame pointers caps each ramdisk at 4MB
+#define RAMDISK_MAX_SIZE    0x400000
+#define MAX_RAMDISKS        2
+
+// The ramdisk made at boot
+#define RAMDISK_NAME        "ram0"
+#define RAMDISK_SIZE        0x400000
+
+typedef struct ramdisk {
+    uint8_t **frames;       // Frame of pointers to the data frames
+    uint32_t num_frames;
+} ramdisk_t;
+
+/* Makes a zeroed ramdisk out of frames from the pool */
+block_device_t *ramdisk_create(const int8_t *name, uint32_t size);
+
+#endif
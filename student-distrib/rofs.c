@@ -1,82 +1,790 @@
 #include "rofs.h"
 
+#include "crc32c.h"
 #include "lib.h"
+#include "lz4.h"
+#include "mount.h"
+#include "paging.h"
+#include "printk.h"
 
 #include "syscalls.h"
 
-boot_block_t *boot_block;
-inode_t *inodes;
-data_block_t *data_blocks;
+// LRU cache of decompressed blocks, shared by every mounted image
+typedef struct cached_block {
+    rofs_t *fs;
+    uint32_t inode;
+    uint32_t block;
+    uint32_t last_used;     // 0 when the slot is empty
+    uint8_t data[BLOCK_SIZE];
+} cached_block_t;
+
+static cached_block_t block_cache[BLOCK_CACHE_SIZE];
+static uint32_t cache_clock;
+
+// Compressed blocks that straddle two extents are gathered here
+static uint8_t stored_block[BLOCK_SIZE];
+
+// Physical 4MB page currently visible at ROFS_WINDOW
+static uint32_t window_base;
+static uint32_t window_mapped;
 
 /*
- * init_rofs(base)
+ * init_rofs(fs, base, phys_base, mapped)
  *
- * DESCRIPTION: Sets up the file system for reading
+ * DESCRIPTION: Sets up the file system for reading. Images with the
+ *              version 2 magic use the extent based inode table, all
+ *              others are treated as version 1. Version 2 images may
+ *              keep their names in directory inodes instead of the
+ *              boot block.
  *
- * INPUTS: 	base - the address of the start of the fs
+ * INPUTS: 	fs - the image to set up
+ *          base - where the start of the image can be read
+ *          phys_base - physical address of the start of the image
+ *          mapped - bytes readable at base, the boot block and inode
+ *                   table must fit. Data blocks are read through
+ *                   ROFS_WINDOW, so the rest can be anywhere.
  * OUTPUTS: none
  *
+ * RETURNS: -1 on an unknown image, 0 otherwise
  * SIDE EFFECTS: Sets pointers to fs objects
  *
  */
-void init_rofs(void *base) {
+int32_t init_rofs(rofs_t *fs, void *base, uint32_t phys_base, uint32_t mapped) {
     // Size is used multiple times
     uint32_t boot_block_size = sizeof(boot_block_t);
 
+    if (mapped < boot_block_size) {
+        return -1;
+    }
+
     // Boot block is at start of memory
-    boot_block = (boot_block_t *) base;
-    // Then inodes
-    inodes = (inode_t *) (base + boot_block_size);
+    fs->boot_block = (boot_block_t *) base;
+
+    // Cached blocks belong to whatever was mounted here before
+    uint32_t i;
+    for (i = 0; i < BLOCK_CACHE_SIZE; i++) {
+        if (block_cache[i].fs == fs) {
+            block_cache[i].last_used = 0;
+        }
+    }
+    fs->cache_hits = 0;
+    fs->cache_misses = 0;
+    fs->checksums = NULL;
+    fs->bad_blocks = 0;
+    rofs_forget_verified(fs);
+
+    if (fs->boot_block->magic != ROFS_MAGIC) {
+        if (fs->boot_block->num_dir_entries > MAX_DIR_ENTRIES) {
+            // Not a file system image
+            return -1;
+        }
+
+        fs->version = ROFS_VERSION_1;
+        fs->root_inode = DIR_END;
+        // Then inodes
+        fs->inodes = (inode_t *) (base + boot_block_size);
+        fs->inodes2 = NULL;
+        // Then the data
+        fs->data_start = phys_base + boot_block_size + fs->boot_block->num_inodes * sizeof(inode_t);
+        return fs->data_start - phys_base > mapped ? -1 : 0;
+    }
+
+    if (fs->boot_block->version != ROFS_VERSION_2) {
+        // Newer than we understand
+        return -1;
+    }
+
+    fs->version = ROFS_VERSION_2;
+    fs->root_inode = DIR_END;
+    if (fs->boot_block->flags & ROFS_DIRECTORIES) {
+        if (fs->boot_block->root_inode >= fs->boot_block->num_inodes) {
+            return -1;
+        }
+        fs->root_inode = fs->boot_block->root_inode;
+    }
+
+    // Packed inode table follows the boot block
+    fs->inodes = NULL;
+    fs->inodes2 = (inode2_t *) (base + boot_block_size);
+    uint32_t metadata = boot_block_size + fs->boot_block->inode_blocks * BLOCK_SIZE;
+    // Then the checksums, one per data block
+    if (fs->boot_block->flags & ROFS_CHECKSUMS) {
+        if (fs->boot_block->checksum_blocks < (fs->boot_block->num_data_blocks + 1023) >> 10) {
+            return -1;
+        }
+        fs->checksums = (uint32_t *) (base + metadata);
+        metadata += fs->boot_block->checksum_blocks * BLOCK_SIZE;
+    }
     // Then the data
-    data_blocks = (data_block_t *) (base + boot_block_size + boot_block->num_inodes * sizeof(inode_t));
+    fs->data_start = phys_base + metadata;
+    return metadata > mapped ? -1 : 0;
+}
+
+/*
+ * rofs_version(fs)
+ *
+ * DESCRIPTION: Gets the on-disk format version of the mounted image
+ *
+ * INPUTS: 	fs - the mounted image
+ * OUTPUTS: none
+ *
+ * RETURNS: ROFS_VERSION_1 or ROFS_VERSION_2
+ * SIDE EFFECTS: none
+ *
+ */
+uint32_t rofs_version(rofs_t *fs) {
+    return fs->version;
+}
+
+/*
+ * inode_length(fs, inode)
+ *
+ * DESCRIPTION: Gets the size in bytes of a file from its inode
+ *
+ * INPUTS: 	fs - the mounted image
+ *          inode - a valid inode index
+ * OUTPUTS: none
+ *
+ * RETURNS: the length of the file
+ * SIDE EFFECTS: none
+ *
+ */
+static uint32_t inode_length(rofs_t *fs, uint32_t inode) {
+    return fs->version == ROFS_VERSION_2 ? fs->inodes2[inode].length : fs->inodes[inode].length;
+}
+
+/*
+ * verify_blocks(fs, block, data, count)
+ *
+ * DESCRIPTION: Checks mapped data blocks against the image's CRC table,
+ *              skipping any that already passed
+ *
+ * INPUTS: 	fs - the mounted image, with checksums
+ *          block - first data block number
+ *          data - where it is mapped
+ *          count - blocks to check
+ * OUTPUTS: none
+ *
+ * RETURNS: -1 if a block is corrupt, 0 otherwise
+ * SIDE EFFECTS: marks blocks verified
+ */
+static int32_t verify_blocks(rofs_t *fs, uint32_t block, uint8_t *data, uint32_t count) {
+    uint32_t i;
+    for (i = 0; i < count; i++, block++, data += BLOCK_SIZE) {
+        uint32_t bit = 1 << (block & 31);
+        if (block < ROFS_VERIFIED_BLOCKS && (fs->verified[block >> 5] & bit)) {
+            continue;
+        }
+
+        if (crc32c(0, data, BLOCK_SIZE) != fs->checksums[block]) {
+            fs->bad_blocks++;
+            printk(KERN_ERR, "rofs: data block %d failed its checksum\n", block);
+            return -1;
+        }
+
+        if (block < ROFS_VERIFIED_BLOCKS) {
+            fs->verified[block >> 5] |= bit;
+            fs->verified_blocks++;
+        }
+    }
+    return 0;
+}
+
+/*
+ * map_block(fs, block, block_offset, run)
+ *
+ * DESCRIPTION: Makes a data block readable by pointing ROFS_WINDOW at
+ *              the 4MB physical page holding it. The pointer is only good
+ *              until the next call, so callers copy out with interrupts
+ *              off. On images with checksums every block the run touches
+ *              is verified the first time it is mapped.
+ *
+ * INPUTS: 	fs - the mounted image
+ *          block - data block number, already bounds checked
+ *          block_offset - byte within the block
+ *          run - bytes the caller would like contiguous, at least 1
+ * OUTPUTS: run - clipped to what the window holds
+ *
+ * RETURNS: pointer to the byte, or NULL if a block is corrupt
+ * SIDE EFFECTS: may remap the window
+ */
+static uint8_t *map_block(rofs_t *fs, uint32_t block, uint32_t block_offset, uint32_t *run) {
+    uint32_t phys = fs->data_start + (block << BLOCK_SHIFT) + block_offset;
+    uint32_t base = phys & ~(LARGE_PAGE_SIZE - 1);
+
+    if (!window_mapped || window_base != base) {
+        map_kernel_page(ROFS_WINDOW, base);
+        window_base = base;
+        window_mapped = 1;
+    }
+
+    if (*run > base + LARGE_PAGE_SIZE - phys) {
+        *run = base + LARGE_PAGE_SIZE - phys;
+    }
+
+    // Blocks never straddle the window, modules are page aligned
+    uint8_t *data = (uint8_t *) ROFS_WINDOW + (phys - base);
+    if (fs->checksums != NULL
+        && verify_blocks(fs, block, data - block_offset, (block_offset + *run + BLOCK_MASK) >> BLOCK_SHIFT)) {
+        return NULL;
+    }
+    return data;
+}
+
+/*
+ * get_extent(fs, node, index, extent)
+ *
+ * DESCRIPTION: Gets an extent of a version 2 inode. Inodes with more
+ *              extents than fit inline use the last inline slot to point
+ *              at data blocks holding the rest.
+ *
+ * INPUTS: 	fs - the mounted image
+ *          node - the inode
+ *          index - which extent, less than num_extents
+ * OUTPUTS: extent - a copy of the extent
+ *
+ * RETURNS: -1 if the inode is corrupt, 0 otherwise
+ * SIDE EFFECTS: may remap the window
+ */
+static int32_t get_extent(rofs_t *fs, inode2_t *node, uint32_t index, extent_t *extent) {
+    if (!(node->flags & INODE_INDIRECT)) {
+        if (index >= INLINE_EXTENTS) {
+            return -1;
+        }
+        *extent = node->extents[index];
+        return 0;
+    }
+
+    if (index < INLINE_EXTENTS - 1) {
+        *extent = node->extents[index];
+        return 0;
+    }
+
+    extent_t *table = &node->extents[INLINE_EXTENTS - 1];
+    uint32_t offset = (index - (INLINE_EXTENTS - 1)) * sizeof(extent_t);
+    if (table->start + table->length > fs->boot_block->num_data_blocks
+        || offset >> BLOCK_SHIFT >= table->length) {
+        return -1;
+    }
+
+    // Extents never straddle a block, so this maps in one piece
+    uint32_t run = sizeof(extent_t);
+    uint32_t flags;
+    cli_and_save(flags);
+    uint8_t *src = map_block(fs, table->start + (offset >> BLOCK_SHIFT), offset & BLOCK_MASK, &run);
+    if (src != NULL) {
+        memcpy(extent, src, sizeof(extent_t));
+    }
+    restore_flags(flags);
+    return src == NULL ? -1 : 0;
+}
+
+/*
+ * map_data(fs, inode, offset, run)
+ *
+ * DESCRIPTION: Finds where a byte of a file lives and maps it. Version 1
+ *              maps one block at a time through the block list, version 2
+ *              walks the extents so a whole contiguous run maps at once,
+ *              up to the end of the window.
+ *
+ * INPUTS: 	fs - the mounted image
+ *          inode - a valid inode index
+ *          offset - byte offset into the file, less than its length
+ *          run - most bytes the caller wants, at least 1
+ * OUTPUTS: run - how many bytes are contiguous starting at offset
+ *
+ * RETURNS: pointer to the byte, or NULL if the inode or data is corrupt
+ * SIDE EFFECTS: may remap the window, see map_block()
+ *
+ */
+static uint8_t *map_data(rofs_t *fs, uint32_t inode, uint32_t offset, uint32_t *run) {
+    uint32_t block = offset >> BLOCK_SHIFT;         // >> 12 ~= / 4096
+    uint32_t block_offset = offset & BLOCK_MASK;    // & 0xFFF ~= % 4096
+    uint32_t wanted = *run;
+
+    if (fs->version == ROFS_VERSION_1) {
+        if (block >= INODE_BLOCK_NUMS) {
+            return NULL;
+        }
+
+        uint32_t data_block = fs->inodes[inode].data_block_num[block];
+        if (data_block >= fs->boot_block->num_data_blocks) {
+            return NULL;
+        }
+
+        *run = BLOCK_SIZE - block_offset;
+        if (*run > wanted) {
+            *run = wanted;
+        }
+        return map_block(fs, data_block, block_offset, run);
+    }
+
+    inode2_t *node = &fs->inodes2[inode];
+    uint32_t i;
+    uint32_t first = 0;     // First file block covered by the extent
+    for (i = 0; i < node->num_extents; i++) {
+        extent_t extent;
+        if (get_extent(fs, node, i, &extent)) {
+            return NULL;
+        }
+
+        if (block >= first + extent.length) {
+            first += extent.length;
+            continue;
+        }
+
+        if (extent.start + extent.length > fs->boot_block->num_data_blocks) {
+            return NULL;
+        }
+
+        // No run is longer than the window, which also keeps this from overflowing
+        uint32_t blocks = first + extent.length - block;
+        if (blocks > LARGE_PAGE_SIZE >> BLOCK_SHIFT) {
+            blocks = LARGE_PAGE_SIZE >> BLOCK_SHIFT;
+        }
+
+        *run = (blocks << BLOCK_SHIFT) - block_offset;
+        if (*run > wanted) {
+            *run = wanted;
+        }
+        return map_block(fs, extent.start + block - first, block_offset, run);
+    }
+
+    // Ran out of extents before reaching the end of the file
+    return NULL;
+}
+
+/*
+ * read_stored(fs, inode, offset, buf, length)
+ *
+ * DESCRIPTION: Copies bytes of an inode's data as stored in the image,
+ *              without decompressing
+ *
+ * INPUTS: 	fs - the mounted image
+ *          inode - a valid inode index
+ *          offset - byte offset into the stored data
+ *          length - bytes to copy
+ * OUTPUTS: buf - the copied bytes
+ *
+ * RETURNS: -1 if the inode is corrupt, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+static int32_t read_stored(rofs_t *fs, uint32_t inode, uint32_t offset, uint8_t *buf, uint32_t length) {
+    uint32_t copied = 0;
+    uint32_t flags;
+    while (copied < length) {
+        // Nothing may move the window between mapping and copying
+        cli_and_save(flags);
+
+        uint32_t run = length - copied;
+        if (run > ROFS_COPY_CHUNK) {
+            run = ROFS_COPY_CHUNK;
+        }
+
+        uint8_t *src = map_data(fs, inode, offset + copied, &run);
+        if (src == NULL) {
+            restore_flags(flags);
+            return -1;
+        }
+
+        memcpy(buf + copied, src, run);
+        restore_flags(flags);
+        copied += run;
+    }
+
+    return 0;
+}
+
+/*
+ * get_block(fs, inode, block)
+ *
+ * DESCRIPTION: Gets one decompressed block of a compressed inode through
+ *              the block cache. On a miss the least recently used slot
+ *              is refilled, decompressing straight out of the image when
+ *              the stored block is contiguous.
+ *
+ * INPUTS: 	fs - the mounted image
+ *          inode - a valid compressed inode index
+ *          block - block number within the file
+ * OUTPUTS: none
+ *
+ * RETURNS: the decompressed block, or NULL if the inode is corrupt
+ * SIDE EFFECTS: updates the block cache
+ */
+static uint8_t *get_block(rofs_t *fs, uint32_t inode, uint32_t block) {
+    cached_block_t *slot = &block_cache[0];
+    uint32_t i;
+
+    cache_clock++;
+    for (i = 0; i < BLOCK_CACHE_SIZE; i++) {
+        cached_block_t *entry = &block_cache[i];
+        if (entry->last_used && entry->fs == fs && entry->inode == inode && entry->block == block) {
+            entry->last_used = cache_clock;
+            fs->cache_hits++;
+            return entry->data;
+        }
+
+        if (entry->last_used < slot->last_used) {
+            slot = entry;
+        }
+    }
+
+    fs->cache_misses++;
+    slot->last_used = 0;
+
+    // Where the block is stored
+    uint32_t table[2];
+    if (read_stored(fs, inode, block * sizeof(uint32_t), (uint8_t *) table, sizeof(table))) {
+        return NULL;
+    }
+
+    uint32_t stored_length = table[1] - table[0];
+    uint32_t block_length = fs->inodes2[inode].length - (block << BLOCK_SHIFT);
+    if (block_length > BLOCK_SIZE) {
+        block_length = BLOCK_SIZE;
+    }
+
+    if (table[1] < table[0] || stored_length > block_length) {
+        return NULL;
+    }
+
+    if (stored_length == block_length) {
+        // Incompressible, kept raw
+        if (read_stored(fs, inode, table[0], slot->data, block_length)) {
+            return NULL;
+        }
+    } else {
+        // Decompress straight out of the window while nothing can move it
+        uint32_t flags;
+        cli_and_save(flags);
+
+        uint32_t run = stored_length;
+        uint8_t *src = map_data(fs, inode, table[0], &run);
+        int32_t decompressed = -1;
+        if (src != NULL && run >= stored_length) {
+            decompressed = lz4_decompress(src, stored_length, slot->data, block_length);
+        }
+        restore_flags(flags);
+
+        if (src != NULL && run < stored_length) {
+            if (read_stored(fs, inode, table[0], stored_block, stored_length)) {
+                return NULL;
+            }
+            decompressed = lz4_decompress(stored_block, stored_length, slot->data, block_length);
+        }
+
+        if (decompressed != block_length) {
+            return NULL;
+        }
+    }
+
+    slot->fs = fs;
+    slot->inode = inode;
+    slot->block = block;
+    slot->last_used = cache_clock;
+    return slot->data;
+}
+
+/*
+ * rofs_get_stats(fs, stats)
+ *
+ * DESCRIPTION: Reports how well the image compresses, how many data
+ *              blocks are shared between inodes, how the decompressed
+ *              block cache is doing and how many blocks were checked
+ *
+ * INPUTS: 	fs - the mounted image
+ * OUTPUTS: stats - the statistics
+ *
+ * SIDE EFFECTS: none
+ */
+void rofs_get_stats(rofs_t *fs, rofs_stats_t *stats) {
+    uint32_t i;
+
+    stats->logical_bytes = 0;
+    stats->stored_bytes = 0;
+    stats->logical_blocks = 0;
+    stats->physical_blocks = fs->boot_block->num_data_blocks;
+    stats->cache_hits = fs->cache_hits;
+    stats->cache_misses = fs->cache_misses;
+    stats->verified_blocks = fs->verified_blocks;
+    stats->bad_blocks = fs->bad_blocks;
+
+    for (i = 0; i < fs->boot_block->num_inodes; i++) {
+        stats->logical_bytes += inode_length(fs, i);
+
+        if (fs->version == ROFS_VERSION_1) {
+            stats->stored_bytes += inode_length(fs, i);
+            stats->logical_blocks += (inode_length(fs, i) + BLOCK_SIZE - 1) >> BLOCK_SHIFT;
+            continue;
+        }
+
+        uint32_t e;
+        extent_t extent;
+        for (e = 0; e < fs->inodes2[i].num_extents && !get_extent(fs, &fs->inodes2[i], e, &extent); e++) {
+            stats->logical_blocks += extent.length;
+        }
+
+        if (!(fs->inodes2[i].flags & INODE_COMPRESSED)) {
+            stats->stored_bytes += fs->inodes2[i].length;
+            continue;
+        }
+
+        // Compressed data ends where the last block does
+        uint32_t num_blocks = (fs->inodes2[i].length + BLOCK_SIZE - 1) >> BLOCK_SHIFT;
+        uint32_t end;
+        if (read_stored(fs, i, num_blocks * sizeof(uint32_t), (uint8_t *) &end, sizeof(end)) == 0) {
+            stats->stored_bytes += end;
+        }
+    }
+}
+
+/*
+ * rofs_forget_verified(fs)
+ *
+ * DESCRIPTION: Clears the verified bitmap so every block gets checked
+ *              again the next time it is read
+ *
+ * INPUTS: 	fs - the mounted image
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: resets the verified count
+ */
+void rofs_forget_verified(rofs_t *fs) {
+    memset(fs->verified, 0, sizeof(fs->verified));
+    fs->verified_blocks = 0;
 }
 
 /*
- * list_all_files()
+ * list_all_files(fs)
  *
  * DESCRIPTION: Testing function that lists all the files in the fs
  *
- * INPUTS: 	none
+ * INPUTS: 	fs - the mounted image
  * OUTPUTS: none
  *
  * SIDE EFFECTS: Prints file names, types, and size to screen
  *
  */
-void list_all_files() {
+void list_all_files(rofs_t *fs) {
     int i;
     int8_t buf[33];
+    dentry_t dentry;
     printf("Listing all files in filesys_img:\n");
-    for (i = 0; i < boot_block->num_dir_entries; i++) {
-        strncpy(buf, boot_block->dentries[i].file_name, FILE_NAME_LENGTH);
+    for (i = 0; read_dentry_by_index(fs, i, &dentry) == 0; i++) {
+        strncpy(buf, dentry.file_name, FILE_NAME_LENGTH);
         buf[32] = 0;
         printf("file_name: %s, file_type: %d, file_size: %d\n",
             buf,
-            boot_block->dentries[i].file_type,
-            inodes[boot_block->dentries[i].inode_num].length);
+            dentry.file_type,
+            dentry.file_type == file ? inode_length(fs, dentry.inode_num) : 0);
+    }
+}
+
+/*
+ * rofs_name_hash(name, length)
+ *
+ * DESCRIPTION: FNV-1a hash of a file name, picks its directory bucket.
+ *              mkrofs uses the same function.
+ *
+ * INPUTS: 	name - the name, not necessarily NUL terminated
+ *          length - characters in the name
+ * OUTPUTS: none
+ *
+ * RETURNS: the hash
+ * SIDE EFFECTS: none
+ */
+uint32_t rofs_name_hash(const int8_t *name, uint32_t length) {
+    uint32_t hash = 2166136261U;
+    uint32_t i;
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t) name[i]) * 16777619U;
+    }
+    return hash;
+}
+
+/*
+ * read_dir_header(fs, dir_inode, header)
+ *
+ * DESCRIPTION: Reads the header of a directory inode
+ *
+ * INPUTS: 	fs - the mounted image
+ *          dir_inode - inode of the directory
+ * OUTPUTS: header - the header
+ *
+ * RETURNS: -1 if the inode is not a valid directory, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+static int32_t read_dir_header(rofs_t *fs, uint32_t dir_inode, dir_header_t *header) {
+    if (dir_inode >= fs->boot_block->num_inodes
+        || !(fs->inodes2[dir_inode].flags & INODE_DIRECTORY)) {
+        return -1;
+    }
+
+    if (read_data(fs, dir_inode, 0, (uint8_t *) header, sizeof(dir_header_t)) != sizeof(dir_header_t)
+        || header->num_buckets == 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * entry_offset(header, index)
+ *
+ * DESCRIPTION: Finds where an entry is within the directory data
+ *
+ * INPUTS: 	header - the directory header
+ *          index - entry index
+ * OUTPUTS: none
+ *
+ * RETURNS: byte offset of the entry
+ * SIDE EFFECTS: none
+ */
+static uint32_t entry_offset(dir_header_t *header, uint32_t index) {
+    return sizeof(dir_header_t) + header->num_buckets * sizeof(uint32_t) + index * sizeof(dir_entry_t);
+}
+
+/*
+ * to_dentry(entry, dentry)
+ *
+ * DESCRIPTION: Copies a directory entry into the dentry callers expect
+ *
+ * INPUTS: 	entry - the on-disk entry
+ * OUTPUTS: dentry - the populated directory entry
+ *
+ * SIDE EFFECTS: none
+ */
+static void to_dentry(dir_entry_t *entry, dentry_t *dentry) {
+    memset(dentry, 0, sizeof(dentry_t));
+    memcpy(dentry->file_name, entry->file_name, FILE_NAME_LENGTH);
+    dentry->file_type = entry->file_type;
+    dentry->inode_num = entry->inode_num;
+}
+
+/*
+ * find_in_dir(fs, dir_inode, name, length, dentry)
+ *
+ * DESCRIPTION: Looks a single path component up in a directory by
+ *              following its hash chain
+ *
+ * INPUTS: 	fs - the mounted image
+ *          dir_inode - inode of the directory
+ *          name - the component, not NUL terminated
+ *          length - characters in the component
+ * OUTPUTS: dentry - the populated directory entry
+ *
+ * RETURNS: -1 if it is not there, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+static int32_t find_in_dir(rofs_t *fs, uint32_t dir_inode, const int8_t *name, uint32_t length,
+                           dentry_t *dentry) {
+    dir_header_t header;
+    if (read_dir_header(fs, dir_inode, &header)) {
+        return -1;
+    }
+
+    uint32_t bucket = rofs_name_hash(name, length) % header.num_buckets;
+    uint32_t index;
+    if (read_data(fs, dir_inode, sizeof(dir_header_t) + bucket * sizeof(uint32_t),
+                  (uint8_t *) &index, sizeof(index)) != sizeof(index)) {
+        return -1;
+    }
+
+    // A corrupt chain could loop, it can be no longer than the directory
+    uint32_t steps;
+    for (steps = 0; index != DIR_END && steps < header.num_entries; steps++) {
+        dir_entry_t entry;
+        if (index >= header.num_entries
+            || read_data(fs, dir_inode, entry_offset(&header, index), (uint8_t *) &entry,
+                         sizeof(entry)) != sizeof(entry)) {
+            return -1;
+        }
+
+        if (!strncmp(name, entry.file_name, length)
+            && (length == FILE_NAME_LENGTH || entry.file_name[length] == '\0')) {
+            to_dentry(&entry, dentry);
+            return 0;
+        }
+
+        index = entry.next;
+    }
+
+    return -1;
+}
+
+/*
+ * walk_path(fs, path, dentry)
+ *
+ * DESCRIPTION: Resolves a slash separated path one directory at a time
+ *              starting from the root directory inode. Empty components
+ *              are skipped.
+ *
+ * INPUTS: 	fs - the mounted image, with directories
+ *          path - the path
+ * OUTPUTS: dentry - the populated directory entry of the last component
+ *
+ * RETURNS: -1 on error, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+static int32_t walk_path(rofs_t *fs, const int8_t *path, dentry_t *dentry) {
+    uint32_t dir_inode = fs->root_inode;
+    uint32_t found = 0;
+
+    while (*path != '\0') {
+        if (*path == '/') {
+            path++;
+            continue;
+        }
+
+        uint32_t length = 0;
+        while (path[length] != '\0' && path[length] != '/') {
+            length++;
+        }
+
+        if (length > FILE_NAME_LENGTH || (found && dentry->file_type != dir)) {
+            // Name too long, or trying to look inside a file
+            return -1;
+        }
+
+        if (find_in_dir(fs, dir_inode, path, length, dentry)) {
+            return -1;
+        }
+
+        found = 1;
+        dir_inode = dentry->inode_num;
+        path += length;
     }
+
+    return found ? 0 : -1;
 }
 
 /*
- * read_dentry_by_name(fname, dentry)
+ * read_dentry_by_name(fs, fname, dentry)
  *
- * DESCRIPTION: Attempts to read a directory entry on the file system by name
+ * DESCRIPTION: Attempts to read a directory entry on the file system by
+ *              name. Images with directories take a slash separated path.
  *
- * INPUTS: 	fname - the name of the file
+ * INPUTS: 	fs - the mounted image
+ *          fname - the name of the file
  * OUTPUTS: dentry - the populated directory entry
  *
  * RETURNS: -1 on error, 0 otherwise
  * SIDE EFFECTS: none
  */
-int32_t read_dentry_by_name(const int8_t *fname, dentry_t *dentry) {
+int32_t read_dentry_by_name(rofs_t *fs, const int8_t *fname, dentry_t *dentry) {
+    if (fs->root_inode != DIR_END) {
+        return walk_path(fs, fname, dentry);
+    }
+
     int i;
-    for (i = 0; i < boot_block->num_dir_entries; i++) {
+    for (i = 0; i < fs->boot_block->num_dir_entries; i++) {
         // If file names aren't equal, continue looking
-        if (strncmp(fname, boot_block->dentries[i].file_name, FILE_NAME_LENGTH)) {
+        if (strncmp(fname, fs->boot_block->dentries[i].file_name, FILE_NAME_LENGTH)) {
             continue;
         }
 
         // Directory Entry has been found, copy it
-        memcpy(dentry, &boot_block->dentries[i], sizeof(dentry_t));
+        memcpy(dentry, &fs->boot_block->dentries[i], sizeof(dentry_t));
 
         // Return Success
         return 0;
@@ -87,35 +795,42 @@ int32_t read_dentry_by_name(const int8_t *fname, dentry_t *dentry) {
 }
 
 /*
- * read_dentry_by_index(index, dentry)
+ * read_dentry_by_index(fs, index, dentry)
  *
- * DESCRIPTION: Attempts to read a directory entry on the file system by index
+ * DESCRIPTION: Attempts to read a directory entry on the file system by
+ *              index. Images with directories index the root directory.
  *
- * INPUTS: 	index - the index of the file
+ * INPUTS: 	fs - the mounted image
+ *          index - the index of the file
  * OUTPUTS: dentry - the populated directory entry
  *
  * RETURNS: -1 on error, 0 otherwise
  * SIDE EFFECTS: none
  */
-int32_t read_dentry_by_index(uint32_t index, dentry_t *dentry) {
-    if (index >= boot_block->num_dir_entries) {
+int32_t read_dentry_by_index(rofs_t *fs, uint32_t index, dentry_t *dentry) {
+    if (fs->root_inode != DIR_END) {
+        return read_dir_entry(fs, fs->root_inode, index, dentry);
+    }
+
+    if (index >= fs->boot_block->num_dir_entries) {
         // Invalid index
         return -1;
     }
 
     // Copy the valid entry
-    memcpy(dentry, &boot_block->dentries[index], sizeof(dentry_t));
+    memcpy(dentry, &fs->boot_block->dentries[index], sizeof(dentry_t));
 
     // Return Success
     return 0;
 }
 
 /*
- * read_data(inode, offset, buf, length)
+ * read_data(fs, inode, offset, buf, length)
  *
  * DESCRIPTION: Writes the data contained by the inode to a buffer
  *
- * INPUTS: 	inode - the inode index that contains data information
+ * INPUTS: 	fs - the mounted image
+ *          inode - the inode index that contains data information
  *          offset - how many bytes from the start of the file to start reading
  *          length - the max amount of bytes to read
  * OUTPUTS: buf - A buffer where the data is placed
@@ -123,36 +838,142 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t *dentry) {
  * RETURNS: -1 on error, otherwise the amount of bytes read
  * SIDE EFFECTS: none
  */
-int32_t read_data(uint32_t inode, uint32_t offset, uint8_t *buf, uint32_t length) {
-    if (inode >= boot_block->num_inodes) {
+int32_t read_data(rofs_t *fs, uint32_t inode, uint32_t offset, uint8_t *buf, uint32_t length) {
+    if (inode >= fs->boot_block->num_inodes) {
         // Invalid index
         return -1;
     }
 
-    inode_t *node = &inodes[inode];
-    if (offset > node->length) {
+    uint32_t file_length = inode_length(fs, inode);
+    if (offset > file_length) {
         // Invalid offset
         return -1;
     }
 
-    if (offset + length > node->length) {
+    if (length > file_length - offset) {
         // Length too long, just truncate
-        length = node->length - offset;
+        length = file_length - offset;
     }
 
-    int i;
-    for (i = 0; i < length; i++) {
-        int block = (i + offset) >> 12;             // >> 12 ~= / 4096
-        int block_offset = (i + offset) & 0xFFF;    // & 0xFFF ~= % 4096
-        buf[i] = data_blocks[node->data_block_num[block]][block_offset];
+    if (fs->version == ROFS_VERSION_1 || !(fs->inodes2[inode].flags & INODE_COMPRESSED)) {
+        // Copy whole contiguous runs instead of a byte at a time
+        return read_stored(fs, inode, offset, buf, length) ? -1 : length;
     }
 
-    return i;
+    // Compressed files go a block at a time through the cache
+    uint32_t copied = 0;
+    while (copied < length) {
+        uint32_t pos = offset + copied;
+        uint8_t *data = get_block(fs, inode, pos >> BLOCK_SHIFT);
+        if (data == NULL) {
+            return -1;
+        }
+
+        uint32_t run = BLOCK_SIZE - (pos & BLOCK_MASK);
+        if (run > length - copied) {
+            run = length - copied;
+        }
+
+        memcpy(buf + copied, data + (pos & BLOCK_MASK), run);
+        copied += run;
+    }
+
+    return copied;
+}
+
+/*
+ * read_dir_entry(fs, dir_inode, index, dentry)
+ *
+ * DESCRIPTION: Reads a directory entry by position from a directory
+ *              inode, for listing
+ *
+ * INPUTS: 	fs - the mounted image, with directories
+ *          dir_inode - inode of the directory
+ *          index - the position of the entry
+ * OUTPUTS: dentry - the populated directory entry
+ *
+ * RETURNS: -1 past the end or on error, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+int32_t read_dir_entry(rofs_t *fs, uint32_t dir_inode, uint32_t index, dentry_t *dentry) {
+    dir_header_t header;
+    dir_entry_t entry;
+
+    if (fs->root_inode == DIR_END || read_dir_header(fs, dir_inode, &header)
+        || index >= header.num_entries) {
+        return -1;
+    }
+
+    if (read_data(fs, dir_inode, entry_offset(&header, index), (uint8_t *) &entry,
+                  sizeof(entry)) != sizeof(entry)) {
+        return -1;
+    }
+
+    to_dentry(&entry, dentry);
+    return 0;
+}
+
+/*
+ * read_stat(fs, file_type, inode, stat)
+ *
+ * DESCRIPTION: Fills in file information straight from the in-memory inode
+ *
+ * INPUTS: 	fs - the mounted image
+ *          file_type - the type of the file from its directory entry
+ *          inode - the inode index of the file
+ * OUTPUTS: stat - the populated file information
+ *
+ * RETURNS: -1 on error, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+int32_t read_stat(rofs_t *fs, uint32_t file_type, uint32_t inode, stat_t *stat) {
+    stat->file_type = file_type;
+    stat->inode_num = 0;
+    stat->length = 0;
+    stat->num_blocks = 0;
+
+    if (file_type != file) {
+        // Only regular files have a meaningful inode
+        return 0;
+    }
+
+    if (inode >= fs->boot_block->num_inodes) {
+        // Invalid index
+        return -1;
+    }
+
+    stat->inode_num = inode;
+    stat->length = inode_length(fs, inode);
+    stat->num_blocks = (stat->length + BLOCK_SIZE - 1) >> BLOCK_SHIFT;
+
+    return 0;
+}
+
+/*
+ * lookup(filename, dentry)
+ *
+ * DESCRIPTION: Resolves a full path to a directory entry in whichever
+ *              rofs image it is mounted from
+ *
+ * INPUTS: 	filename - full path
+ * OUTPUTS: dentry - the populated directory entry
+ *
+ * RETURNS: -1 if the path is not in a rofs image, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+static int32_t lookup(const int8_t *filename, dentry_t *dentry) {
+    const int8_t *name;
+    mount_t *mount = resolve_path(filename, &name);
+    if (mount == NULL || mount->type != MOUNT_ROFS) {
+        return -1;
+    }
+
+    return read_dentry_by_name(&mount->rofs, name, dentry);
 }
 
 int32_t file_open(const int8_t *filename) {
     dentry_t dentry;
-    if (read_dentry_by_name(filename, &dentry)) {
+    if (lookup(filename, &dentry)) {
         return -1;
     }
 
@@ -164,21 +985,21 @@ int32_t file_open(const int8_t *filename) {
 }
 
 int32_t file_close(int32_t fd) {
-    if (fd < 0 || fd > MAX_FILES) {
+    if (get_file(fd) == NULL) {
         return -1;
     }
     return 0;
 }
 
 int32_t file_read(int32_t fd, void *buf, int32_t nbytes) {
-    if (fd < 0 || fd > MAX_FILES) {
+    if (get_file(fd) == NULL) {
         return -1;
     }
 
     uint8_t *byte_buf = (uint8_t *)buf;
 
-    file_t *file = &get_current_pcb()->files[fd];
-    int32_t bytes_read = read_data(file->inode, file->pos, byte_buf, nbytes);
+    file_t *file = get_file(fd);
+    int32_t bytes_read = read_data(file->fs, file->inode, file->pos, byte_buf, nbytes);
 
     if (bytes_read < 0) {
         return -1;
@@ -197,9 +1018,14 @@ int32_t file_read(int32_t fd, void *buf, int32_t nbytes) {
     return bytes_read;
 }
 
+int32_t rofs_stat(int32_t fd, stat_t *buf) {
+    file_t *file = get_file(fd);
+    return read_stat(file->fs, file->type, file->inode, buf);
+}
+
 int32_t dir_open(const int8_t *filename) {
     dentry_t dentry;
-    if (read_dentry_by_name(filename, &dentry)) {
+    if (lookup(filename, &dentry)) {
         return -1;
     }
 
@@ -211,7 +1037,7 @@ int32_t dir_open(const int8_t *filename) {
 }
 
 int32_t dir_close(int32_t fd) {
-    if (fd < 0 || fd > MAX_FILES) {
+    if (get_file(fd) == NULL) {
         return -1;
     }
     return 0;
@@ -220,13 +1046,24 @@ int32_t dir_close(int32_t fd) {
 int32_t dir_read(int32_t fd, void *buf, int32_t nbytes) {
 
     // See if we've reached the end of file
-    file_t *file = &get_current_pcb()->files[fd];
-    if (file->pos >= boot_block->num_dir_entries) {
-        return 0;
-    }
+    file_t *file = get_file(fd);
+    rofs_t *fs = file->fs;
+    dentry_t dentry_buf;
+    dentry_t *dentry = &dentry_buf;
 
-    // Get the dentry
-    dentry_t *dentry = &boot_block->dentries[file->pos];
+    if (fs->root_inode != DIR_END) {
+        // Directory inodes hold their own entries
+        if (read_dir_entry(fs, file->inode, file->pos, dentry)) {
+            return 0;
+        }
+    } else {
+        if (file->pos >= fs->boot_block->num_dir_entries) {
+            return 0;
+        }
+
+        // Get the dentry
+        dentry = &fs->boot_block->dentries[file->pos];
+    }
 
     // Copy number of bytes requested up to max file name length
     int32_t copy_length = nbytes > FILE_NAME_LENGTH ? FILE_NAME_LENGTH : nbytes;
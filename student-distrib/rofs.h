@@ -8,7 +8,10 @@
 typedef enum file_type {
     rtc = 0,
     dir = 1,
-    file = 2
+    file = 2,
+    tty = 3,    // Never stored on disk, only reported by fstat
+    block = 4,  // A block device under DEV_MOUNT, also never on disk
+    fifo = 5    // One end of a pipe, only reported by fstat
 } file_type_t;
 
 typedef struct dentry {
@@ -18,32 +21,161 @@ typedef struct dentry {
     uint8_t reserved[24];
 } dentry_t;
 
+// Version 2 images carry this in the boot block, version 1 images have zeros
+#define ROFS_MAGIC          0x32534F52  // "ROS2"
+#define ROFS_VERSION_1      1
+#define ROFS_VERSION_2      2
+
+#define MAX_DIR_ENTRIES     63
+#define INODE_BLOCK_NUMS    1023
+#define INLINE_EXTENTS      14
+
+// Superblock feature flags
+#define ROFS_COMPRESSED     0x1     // Some inodes are LZ4 compressed
+#define ROFS_DIRECTORIES    0x2     // Names live in directory inodes from root_inode
+#define ROFS_CHECKSUMS      0x4     // A CRC32C per data block follows the inode table
+
+// Version 2 inode flags
+#define INODE_COMPRESSED    0x1     // Extents hold a block table and LZ4 blocks
+#define INODE_DIRECTORY     0x2     // Data is a directory
+#define INODE_INDIRECT      0x4     // Last inline extent points at more extents
+
+// Ends a hash chain in a directory
+#define DIR_END             0xFFFFFFFF
+
+// Decompressed blocks kept around for small and repeated reads
+#define BLOCK_CACHE_SIZE    8
+
+// Most bytes copied out of the data window with interrupts off at once
+#define ROFS_COPY_CHUNK     0x10000
+
+// Data blocks whose verified state is remembered, 128MB worth. Blocks
+// past this still get checked, just on every read.
+#define ROFS_VERIFIED_BLOCKS 0x8000
+
 typedef struct boot_block {
     uint32_t num_dir_entries;
     uint32_t num_inodes;
     uint32_t num_data_blocks;
-    uint8_t reserved[52];
-    dentry_t dentries[63];
+
+    // Version 2 superblock, lives in what version 1 left reserved
+    uint32_t magic;
+    uint32_t version;
+    uint32_t inode_blocks;      // Blocks taken up by the inode table
+    uint32_t flags;
+    uint32_t root_inode;        // With ROFS_DIRECTORIES, else unused
+    uint32_t checksum_blocks;   // With ROFS_CHECKSUMS, blocks in the CRC table
+    uint8_t reserved[28];
+
+    dentry_t dentries[MAX_DIR_ENTRIES];     // Unused with ROFS_DIRECTORIES
 } boot_block_t;
 
+// Version 1 inode, one 4KB block each
 typedef struct inode {
     uint32_t length;
-    uint32_t data_block_num[1023];
+    uint32_t data_block_num[INODE_BLOCK_NUMS];
 } inode_t;
 
+// A run of contiguous data blocks
+typedef struct extent {
+    uint32_t start;
+    uint32_t length;
+} extent_t;
+
+// Version 2 inode, 32 of them packed into each block. With INODE_INDIRECT,
+// extents[INLINE_EXTENTS - 1] covers data blocks holding extents
+// INLINE_EXTENTS - 1 through num_extents - 1 instead of file data.
+typedef struct inode2 {
+    uint32_t length;
+    uint32_t flags;
+    uint32_t num_extents;
+    uint32_t reserved;
+    extent_t extents[INLINE_EXTENTS];
+} inode2_t;
+
+/*
+ * Directory inode data starts with a header, then num_buckets hash chain
+ * heads, then num_entries entries. Entries whose names hash to the same
+ * bucket are chained through next, ending with DIR_END.
+ */
+typedef struct dir_header {
+    uint32_t num_entries;
+    uint32_t num_buckets;
+} dir_header_t;
+
+typedef struct dir_entry {
+    int8_t file_name[FILE_NAME_LENGTH];
+    uint32_t file_type;
+    uint32_t inode_num;
+    uint32_t next;              // Next entry index in the same bucket
+    uint8_t reserved[20];
+} dir_entry_t;
+
+/*
+ * Data of a compressed inode starts with a table of num_blocks + 1 offsets
+ * into the data. Block i is stored between table[i] and table[i + 1];
+ * a block stored at full size was not worth compressing and is raw.
+ */
+
 typedef uint8_t data_block_t[4096];
 
-void init_rofs(void *base);
+#define BLOCK_SIZE 4096
+#define BLOCK_SHIFT 12
+#define BLOCK_MASK 0xFFF
+
+typedef struct rofs_stats {
+    uint32_t logical_bytes;     // Length of every file
+    uint32_t stored_bytes;      // Space they take up in the image
+    uint32_t logical_blocks;    // Blocks referenced by inodes
+    uint32_t physical_blocks;   // Data blocks in the image, less if shared
+    uint32_t cache_hits;
+    uint32_t cache_misses;
+    uint32_t verified_blocks;   // Checked against their CRC so far
+    uint32_t bad_blocks;        // Reads refused because the CRC did not match
+} rofs_stats_t;
+
+// A mounted image, every function works on one of these
+typedef struct rofs {
+    boot_block_t *boot_block;
+    inode_t *inodes;            // Version 1 only
+    inode2_t *inodes2;          // Version 2 only
+    uint32_t data_start;        // Physical address of data block 0
+    uint32_t version;
+    uint32_t root_inode;        // DIR_END for a flat image
+    uint32_t cache_hits;
+    uint32_t cache_misses;
+    uint32_t *checksums;        // CRC32C of each data block, NULL without them
+    uint32_t verified_blocks;
+    uint32_t bad_blocks;
+    uint32_t verified[ROFS_VERIFIED_BLOCKS / 32];   // Bit set once a block checks out
+} rofs_t;
+
+typedef struct stat {
+    uint32_t file_type;
+    uint32_t inode_num;
+    uint32_t length;
+    uint32_t num_blocks;
+} stat_t;
+
+int32_t init_rofs(rofs_t *fs, void *base, uint32_t phys_base, uint32_t mapped);
+uint32_t rofs_version(rofs_t *fs);
+void rofs_get_stats(rofs_t *fs, rofs_stats_t *stats);
+void rofs_forget_verified(rofs_t *fs);
 // Helper function before ls is implemented
-void list_all_files();
-int32_t read_dentry_by_name(const int8_t *fname, dentry_t *dentry);
-int32_t read_dentry_by_index(uint32_t index, dentry_t *dentry);
-int32_t read_data(uint32_t inode, uint32_t offset, uint8_t *buf, uint32_t length);
+void list_all_files(rofs_t *fs);
+int32_t read_dentry_by_name(rofs_t *fs, const int8_t *fname, dentry_t *dentry);
+int32_t read_dentry_by_index(rofs_t *fs, uint32_t index, dentry_t *dentry);
+int32_t read_data(rofs_t *fs, uint32_t inode, uint32_t offset, uint8_t *buf, uint32_t length);
+int32_t read_dir_entry(rofs_t *fs, uint32_t dir_inode, uint32_t index, dentry_t *dentry);
+uint32_t rofs_name_hash(const int8_t *name, uint32_t length);
+int32_t read_stat(rofs_t *fs, uint32_t file_type, uint32_t inode, stat_t *stat);
 
 int32_t file_open(const int8_t *filename);
 int32_t file_close(int32_t fd);
 int32_t file_read(int32_t fd, void *buf, int32_t nbytes);
 
+int32_t rofs_stat(int32_t fd, stat_t *buf);
+
 int32_t dir_open(const int8_t *filename);
 int32_t dir_close(int32_t fd);
 int32_t dir_read(int32_t fd, void *buf, int32_t nbytes);
@@ -5,6 +5,7 @@
 #include "x86_desc.h"
 
 int int_occur = 0;
+static wait_queue_t rtc_wait;
 
 /*
  * rtc_handler(void)
@@ -21,6 +22,7 @@ void rtc_handler() {
     cli();
 
     int_occur = 1;
+    wake_up(&rtc_wait);
 
     // Throw away contents
     outb(RTC_REG_C, RTC_PORT);
@@ -110,6 +112,24 @@ int32_t rtc_read(int32_t fd, void *buf, int32_t nbytes)
     int_occur = 0;
     return 0;
 }
+/*
+ * rtc_poll()
+ *
+ * DESCRIPTION: readiness callback, woken by every interrupt
+ *
+ * INPUTS:  fd - ignored
+ *          pt - the poll call's table
+ * OUTPUTS: POLLIN if there is an interrupt rtc_read has not consumed,
+ *          POLLOUT always
+ *
+ * SIDE EFFECTS: N/A
+ *
+ */
+int32_t rtc_poll(int32_t fd, poll_table_t *pt)
+{
+    poll_wait(pt, &rtc_wait);
+    return (int_occur ? POLLIN : 0) | POLLOUT;
+}
 /*
  * rtc_read(buf, nbytes)
  *
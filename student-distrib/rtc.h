@@ -3,6 +3,7 @@
 
 #include "idt.h"
 #include "lib.h"
+#include "poll.h"
 
 #define RTC_PORT    0x70
 #define CMOS_PORT   0x71
@@ -42,5 +43,7 @@ extern int32_t rtc_close(int32_t fd);
 extern int32_t rtc_read(int32_t fd, void *buf, int32_t nbytes);
 /* Writes frequency of rtc */
 extern int32_t rtc_write(int32_t fd, const void *buf, int32_t nbytes);
+/* Readiness callback: POLLIN once rtc_read would return right away */
+extern int32_t rtc_poll(int32_t fd, poll_table_t *pt);
 
 #endif
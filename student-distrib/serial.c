@@ -0,0 +1,483 @@
+#include "serial.h"
+
+#include "i8259.h"
+#include "lib.h"
+#include "syscalls.h"
+
+static uint32_t present;
+// Whether the first terminal's shell runs on the port
+static uint32_t console;
+
+// Finished lines, filled by the interrupt handler and drained by reads.
+// head and tail run freely and are masked on use.
+static uint8_t rx_buf[SERIAL_RX_SIZE];
+static volatile uint32_t rx_head;
+static volatile uint32_t rx_tail;
+static volatile uint32_t rx_lines;
+
+// Bytes waiting for the transmit FIFO. Writes and echo both add to it,
+// always with interrupts off, and the handler takes from it.
+static uint8_t tx_buf[SERIAL_TX_SIZE];
+static volatile uint32_t tx_head;
+static volatile uint32_t tx_tail;
+
+// The line being typed, which reads do not see until it is finished
+static uint8_t line[SERIAL_LINE_SIZE];
+static uint32_t line_length;
+static uint32_t last_cr;
+
+// Woken when a line is finished or the transmit ring drains
+static wait_queue_t serial_wait;
+
+/*
+ * tx_start()
+ *
+ * DESCRIPTION: Fills the transmit FIFO from the ring if it is empty, and
+ *              asks for an interrupt when it empties again only while
+ *              there is more to send. Interrupts must be off.
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: writes to the UART
+ */
+static void tx_start(void) {
+    uint32_t i;
+
+    if (inb(COM1_PORT + UART_LSR) & UART_LSR_THRE) {
+        for (i = 0; i < UART_FIFO_SIZE && tx_head != tx_tail; i++) {
+            outb(tx_buf[tx_head & (SERIAL_TX_SIZE - 1)], COM1_PORT + UART_DATA);
+            tx_head++;
+        }
+        wake_up(&serial_wait);
+    }
+
+    outb(UART_IER_RX | UART_IER_LINE | (tx_head != tx_tail ? UART_IER_THRE : 0), COM1_PORT + UART_IER);
+}
+
+/*
+ * tx_put(c)
+ *
+ * DESCRIPTION: Adds a byte to the transmit ring, dropping it if the ring
+ *              is full. Interrupts must be off.
+ *
+ * INPUTS: 	c - the byte
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: none
+ */
+static void tx_put(uint8_t c) {
+    if (tx_tail - tx_head < SERIAL_TX_SIZE) {
+        tx_buf[tx_tail & (SERIAL_TX_SIZE - 1)] = c;
+        tx_tail++;
+    }
+}
+
+/*
+ * tx_wait_put(c)
+ *
+ * DESCRIPTION: Adds a byte to the transmit ring, sleeping until the
+ *              handler makes room if it is full. Interrupts must be off;
+ *              they are on only while it sleeps.
+ *
+ * INPUTS: 	c - the byte
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: none
+ */
+static void tx_wait_put(uint8_t c) {
+    while (tx_tail - tx_head == SERIAL_TX_SIZE) {
+        tx_start();
+        asm volatile ("sti; hlt; cli" : : : "memory");
+    }
+
+    tx_buf[tx_tail & (SERIAL_TX_SIZE - 1)] = c;
+    tx_tail++;
+}
+
+/*
+ * receive(c)
+ *
+ * DESCRIPTION: Edits the line being typed with a received byte and echoes
+ *              it. Return finishes the line, which goes into the receive
+ *              ring with a '\n' if it fits and is dropped otherwise.
+ *              Backspace and delete both erase. Other control characters
+ *              are ignored.
+ *
+ * INPUTS: 	c - the byte
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: may finish a line for serial_read
+ */
+static void receive(uint8_t c) {
+    uint32_t i;
+    uint32_t cr = c == '\r';
+
+    // Terminals send '\r', '\n' or both for return
+    if (c == '\n' && last_cr) {
+        last_cr = 0;
+        return;
+    }
+    last_cr = cr;
+
+    if (c == '\r' || c == '\n') {
+        if (SERIAL_RX_SIZE - (rx_tail - rx_head) > line_length) {
+            for (i = 0; i < line_length; i++) {
+                rx_buf[(rx_tail + i) & (SERIAL_RX_SIZE - 1)] = line[i];
+            }
+            rx_buf[(rx_tail + i) & (SERIAL_RX_SIZE - 1)] = '\n';
+            rx_tail += line_length + 1;
+            rx_lines++;
+            wake_up(&serial_wait);
+        }
+        line_length = 0;
+        tx_put('\r');
+        tx_put('\n');
+    } else if (c == SERIAL_BS || c == SERIAL_DEL) {
+        if (line_length > 0) {
+            line_length--;
+            tx_put(SERIAL_BS);
+            tx_put(' ');
+            tx_put(SERIAL_BS);
+        }
+    } else if (c >= ' ' || c == '\t') {
+        // Room is kept for the '\n'
+        if (line_length < SERIAL_LINE_SIZE - 1) {
+            line[line_length++] = c;
+            tx_put(c);
+        }
+    }
+}
+
+/*
+ * serial_init()
+ *
+ * DESCRIPTION: Checks for a UART at COM1 and sets it up for SERIAL_BAUD
+ *              8N1 with its FIFOs on and interrupts for received bytes
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: enables IRQ4 when there is a UART
+ */
+void serial_init(void) {
+    uint32_t divisor = UART_CLOCK / SERIAL_BAUD;
+
+    // Nothing at the port reads back all ones, not what was written
+    outb(0x5A, COM1_PORT + UART_SCRATCH);
+    if (inb(COM1_PORT + UART_SCRATCH) != 0x5A) {
+        return;
+    }
+
+    outb(0, COM1_PORT + UART_IER);
+    outb(UART_LCR_DLAB, COM1_PORT + UART_LCR);
+    outb(divisor & 0xFF, COM1_PORT + UART_DATA);
+    outb(divisor >> 8, COM1_PORT + UART_IER);
+    outb(UART_LCR_8N1, COM1_PORT + UART_LCR);
+    outb(UART_FCR_INIT, COM1_PORT + UART_FCR);
+    outb(UART_MCR_INIT, COM1_PORT + UART_MCR);
+
+    // Clear anything that was pending before
+    inb(COM1_PORT + UART_LSR);
+    inb(COM1_PORT + UART_DATA);
+    inb(COM1_PORT + UART_IIR);
+    inb(COM1_PORT + UART_MSR);
+
+    present = 1;
+    outb(UART_IER_RX | UART_IER_LINE, COM1_PORT + UART_IER);
+    enable_irq(COM1_IRQ_LINE);
+}
+
+/*
+ * serial_handler()
+ *
+ * DESCRIPTION: Handles IRQ4. Takes every source the UART has pending:
+ *              empties the receive FIFO, refills the transmit FIFO from
+ *              the ring up to 16 bytes at a time, and clears line and
+ *              modem status changes.
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: moves bytes between the FIFOs and the rings
+ */
+void serial_handler(void) {
+    uint32_t iir;
+
+    send_eoi(COM1_IRQ_LINE);
+    if (!present) {
+        return;
+    }
+
+    while (!((iir = inb(COM1_PORT + UART_IIR)) & UART_IIR_NONE)) {
+        switch (iir & UART_IIR_ID) {
+            case UART_IIR_RX:
+            case UART_IIR_TIMEOUT:
+                while (inb(COM1_PORT + UART_LSR) & UART_LSR_DR) {
+                    receive(inb(COM1_PORT + UART_DATA));
+                }
+                tx_start();
+                break;
+            case UART_IIR_THRE:
+                tx_start();
+                break;
+            case UART_IIR_LINE:
+                inb(COM1_PORT + UART_LSR);
+                break;
+            default:
+                inb(COM1_PORT + UART_MSR);
+                break;
+        }
+    }
+}
+
+/*
+ * serial_present()
+ *
+ * DESCRIPTION: Says whether serial_init found a UART
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * RETURNS: 1 if it did, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+uint32_t serial_present(void) {
+    return present;
+}
+
+/*
+ * serial_set_console(on)
+ *
+ * DESCRIPTION: Puts the first terminal's shell on the port instead of
+ *              the screen and keyboard, as the boot option
+ *              console=ttyS0 asks. Needs a UART, so call it after
+ *              serial_init.
+ *
+ * INPUTS: 	on - 1 for the port, 0 for the screen
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: none
+ */
+void serial_set_console(uint32_t on) {
+    console = on && present;
+}
+
+/*
+ * serial_is_console()
+ *
+ * DESCRIPTION: Says whether the first terminal's shell runs on the port
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * RETURNS: 1 if it does, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+uint32_t serial_is_console(void) {
+    return console;
+}
+
+/*
+ * serial_poll(fd, pt)
+ *
+ * DESCRIPTION: Readiness callback for the port
+ *
+ * INPUTS: 	fd - ignored
+ *          pt - the poll call's table
+ * OUTPUTS: none
+ *
+ * RETURNS: POLLIN if a finished line is waiting, POLLOUT if the
+ *          transmit ring has room
+ * SIDE EFFECTS: none
+ */
+int32_t serial_poll(int32_t fd, poll_table_t *pt) {
+    poll_wait(pt, &serial_wait);
+    return (rx_lines ? POLLIN : 0) | (tx_tail - tx_head < SERIAL_TX_SIZE ? POLLOUT : 0);
+}
+
+/*
+ * serial_drain()
+ *
+ * DESCRIPTION: Waits until the ring is empty and the UART has sent its
+ *              last byte
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: none
+ */
+void serial_drain(void) {
+    if (!present) {
+        return;
+    }
+
+    while (tx_head != tx_tail) {
+        asm volatile ("sti; hlt" : : : "memory");
+    }
+
+    while (!(inb(COM1_PORT + UART_LSR) & UART_LSR_TEMT)) {
+        // Under 16 bytes left, not worth sleeping for
+    }
+}
+
+/*
+ * serial_open(filename)
+ *
+ * DESCRIPTION: Opens the port, the lookup already found it
+ *
+ * INPUTS: 	filename - ignored
+ * OUTPUTS: none
+ *
+ * RETURNS: 0, -1 without a UART
+ * SIDE EFFECTS: none
+ */
+int32_t serial_open(const int8_t *filename) {
+    return present ? 0 : -1;
+}
+
+/*
+ * serial_close(fd)
+ *
+ * DESCRIPTION: Closes the port. Anything still in the transmit ring goes
+ *              out anyway.
+ *
+ * INPUTS: 	fd - ignored
+ * OUTPUTS: none
+ *
+ * RETURNS: 0
+ * SIDE EFFECTS: none
+ */
+int32_t serial_close(int32_t fd) {
+    return 0;
+}
+
+/*
+ * serial_read(fd, buf, nbytes)
+ *
+ * DESCRIPTION: Reads a line typed on the port, sleeping until one is
+ *              finished unless the file is nonblocking. A line longer
+ *              than nbytes is returned over several reads.
+ *
+ * INPUTS: 	fd - the open port
+ *          nbytes - most bytes to read
+ * OUTPUTS: buf - the line, ending with '\n' if all of it fit
+ *
+ * RETURNS: bytes read, 0 if nonblocking and no line is ready
+ * SIDE EFFECTS: none
+ */
+int32_t serial_read(int32_t fd, void *buf, int32_t nbytes) {
+    uint8_t *bytes = (uint8_t *) buf;
+    uint32_t flags;
+    int32_t count = 0;
+
+    if (nbytes <= 0) {
+        return 0;
+    }
+
+    while (!rx_lines) {
+        if (get_file(fd)->flags & FILE_NONBLOCK) {
+            return 0;
+        }
+        asm volatile ("sti; hlt" : : : "memory");
+    }
+
+    while (count < nbytes) {
+        uint8_t c = rx_buf[rx_head & (SERIAL_RX_SIZE - 1)];
+        bytes[count++] = c;
+        rx_head++;
+        if (c == '\n') {
+            cli_and_save(flags);
+            rx_lines--;
+            restore_flags(flags);
+            break;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * serial_write(fd, buf, nbytes)
+ *
+ * DESCRIPTION: Queues bytes for the port, '\n' going out as "\r\n", and
+ *              starts the UART on them. Returns once they are all in the
+ *              ring, sleeping while it is full; the IRQ4 handler sends
+ *              them on.
+ *
+ * INPUTS: 	fd - ignored
+ *          buf - data
+ *          nbytes - bytes to write
+ * OUTPUTS: none
+ *
+ * RETURNS: nbytes, -1 without a UART
+ * SIDE EFFECTS: none
+ */
+int32_t serial_write(int32_t fd, const void *buf, int32_t nbytes) {
+    const uint8_t *bytes = (const uint8_t *) buf;
+    uint32_t flags;
+    int32_t i;
+
+    if (!present || nbytes < 0) {
+        return -1;
+    }
+
+    cli_and_save(flags);
+    for (i = 0; i < nbytes; i++) {
+        if (bytes[i] == '\n') {
+            tx_wait_put('\r');
+        }
+        tx_wait_put(bytes[i]);
+    }
+    tx_start();
+    restore_flags(flags);
+
+    return nbytes;
+}
+
+/*
+ * serial_try_write(buf, nbytes)
+ *
+ * DESCRIPTION: Queues bytes like serial_write, but only if they all fit
+ *              in the ring now, for callers that must not sleep
+ *
+ * INPUTS: 	buf - data
+ *          nbytes - bytes to write
+ * OUTPUTS: none
+ *
+ * RETURNS: nbytes, -1 if they did not fit or there is no UART
+ * SIDE EFFECTS: none
+ */
+int32_t serial_try_write(const void *buf, int32_t nbytes) {
+    const uint8_t *bytes = (const uint8_t *) buf;
+    uint32_t needed = nbytes;
+    uint32_t flags;
+    int32_t i;
+
+    if (!present || nbytes < 0) {
+        return -1;
+    }
+
+    for (i = 0; i < nbytes; i++) {
+        if (bytes[i] == '\n') {
+            needed++;
+        }
+    }
+
+    cli_and_save(flags);
+    if (SERIAL_TX_SIZE - (tx_tail - tx_head) < needed) {
+        restore_flags(flags);
+        return -1;
+    }
+
+    for (i = 0; i < nbytes; i++) {
+        if (bytes[i] == '\n') {
+            tx_put('\r');
+        }
+        tx_put(bytes[i]);
+    }
+    tx_start();
+    restore_flags(flags);
+
+    return nbytes;
+}
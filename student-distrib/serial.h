@@ -0,0 +1,86 @@
+#ifndef SERIAL_H_
+#define SERIAL_H_
+
+#include "types.h"
+#include "poll.h"
+
+// First serial port, a 16550 UART
+#define COM1_PORT           0x3F8
+
+// Register offsets from the base port
+#define UART_DATA           0       // Divisor low byte with DLAB set
+#define UART_IER            1       // Divisor high byte with DLAB set
+#define UART_IIR            2       // Read
+#define UART_FCR            2       // Write
+#define UART_LCR            3
+#define UART_MCR            4
+#define UART_LSR            5
+#define UART_MSR            6
+#define UART_SCRATCH        7
+
+// Interrupt enable bits
+#define UART_IER_RX         0x01
+#define UART_IER_THRE       0x02
+#define UART_IER_LINE       0x04
+
+// Interrupt identification, the highest priority source pending
+#define UART_IIR_NONE       0x01
+#define UART_IIR_ID         0x0E
+#define UART_IIR_MODEM      0x00
+#define UART_IIR_THRE       0x02
+#define UART_IIR_RX         0x04
+#define UART_IIR_LINE       0x06
+#define UART_IIR_TIMEOUT    0x0C    // Bytes sat in the FIFO below the trigger
+
+// FIFO control: on, both cleared, interrupt at 14 received bytes
+#define UART_FCR_INIT       0xC7
+// Line control: 8 data bits, no parity, one stop bit
+#define UART_LCR_8N1        0x03
+#define UART_LCR_DLAB       0x80
+// Modem control: DTR, RTS, and OUT2, which lets the interrupt out
+#define UART_MCR_INIT       0x0B
+
+// Line status bits
+#define UART_LSR_DR         0x01    // A received byte is waiting
+#define UART_LSR_THRE       0x20    // The transmit FIFO is empty
+#define UART_LSR_TEMT       0x40    // The last byte has been shifted out
+
+#define UART_CLOCK          115200  // Baud with a divisor of 1
+#define SERIAL_BAUD         115200
+#define UART_FIFO_SIZE      16
+
+// Ring sizes, powers of two
+#define SERIAL_RX_SIZE      1024
+#define SERIAL_TX_SIZE      4096
+// Longest line being typed, like the keyboard's
+#define SERIAL_LINE_SIZE    128
+
+// Characters the line discipline looks at
+#define SERIAL_BS           0x08
+#define SERIAL_DEL          0x7F
+
+// What the port is called under DEV_MOUNT
+#define SERIAL_NAME         "ttyS0"
+
+/* Sets up COM1 if there is one */
+void serial_init(void);
+/* Moves bytes in and out of the FIFOs, called from the IRQ4 handler */
+void serial_handler(void);
+/* Says whether serial_init found a UART */
+uint32_t serial_present(void);
+/* Picks whether the first terminal's shell runs on the port */
+void serial_set_console(uint32_t on);
+uint32_t serial_is_console(void);
+/* Waits for everything written to leave the UART */
+void serial_drain(void);
+
+// The port as a file
+int32_t serial_open(const int8_t *filename);
+int32_t serial_close(int32_t fd);
+int32_t serial_read(int32_t fd, void *buf, int32_t nbytes);
+int32_t serial_write(int32_t fd, const void *buf, int32_t nbytes);
+int32_t serial_poll(int32_t fd, poll_table_t *pt);
+/* Writes only if it can without sleeping, for interrupt handlers */
+int32_t serial_try_write(const void *buf, int32_t nbytes);
+
+#endif
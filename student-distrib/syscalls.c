@@ -1,38 +1,314 @@
 #include "syscalls.h"
 
+#include "block.h"
+#include "interrupt_handlers.h"
 #include "paging.h"
+#include "pipe.h"
+#include "poll.h"
+#include "printk.h"
 #include "rofs.h"
 #include "rtc.h"
+#include "serial.h"
 #include "terminal.h"
+#include "tmpfs.h"
+#include "mount.h"
 #include "x86_desc.h"
 
 // All file ops
-fileops_t stdin_ops = {terminal_open, fail, terminal_read, fail};
-fileops_t stdout_ops = {terminal_open, fail, fail, terminal_write};
-fileops_t rtc_ops = {rtc_open, rtc_close, rtc_read, rtc_write};
-fileops_t dir_ops = {dir_open, dir_close, dir_read, fail};
-fileops_t file_ops = {file_open, file_close, file_read, fail};
-fileops_t fail_ops = {fail, fail, fail, fail};
+fileops_t stdin_ops = {terminal_open, fail, terminal_read, fail, rofs_stat, terminal_poll};
+fileops_t stdout_ops = {terminal_open, fail, fail, terminal_write, rofs_stat, poll_always};
+fileops_t rtc_ops = {rtc_open, rtc_close, rtc_read, rtc_write, rofs_stat, rtc_poll};
+fileops_t dir_ops = {dir_open, dir_close, dir_read, fail, rofs_stat, poll_always};
+fileops_t file_ops = {file_open, file_close, file_read, fail, rofs_stat, poll_always};
+fileops_t tmpfs_dir_ops = {tmpfs_dir_open, dir_close, tmpfs_dir_read, fail, tmpfs_stat, poll_always};
+fileops_t tmpfs_file_ops = {tmpfs_open, tmpfs_close, tmpfs_read, tmpfs_write, tmpfs_stat, poll_always};
+fileops_t dev_dir_ops = {dev_dir_open, dir_close, dev_dir_read, fail, blockdev_stat, poll_always};
+fileops_t blockdev_ops = {blockdev_open, blockdev_close, blockdev_read, blockdev_write, blockdev_stat, poll_always};
+fileops_t serial_ops = {serial_open, serial_close, serial_read, serial_write, blockdev_stat, serial_poll};
+fileops_t kmsg_ops = {kmsg_open, kmsg_close, kmsg_read, kmsg_write, blockdev_stat, kmsg_poll};
+fileops_t pipe_reader_ops = {fail, pipe_close, pipe_read, fail, pipe_stat, pipe_poll};
+fileops_t pipe_writer_ops = {fail, pipe_close, fail, pipe_write, pipe_stat, pipe_poll};
+fileops_t fail_ops = {fail, fail, fail, fail, fail, fail};
 
 uint8_t processes_flags = 0;
 
+// Every open file in the system, fds point into here
+static file_t open_files[MAX_OPEN_FILES];
+
 /*
- * can_execute()
+ * alloc_file()
  *
- * DESCRIPTION: check whether another terminal can be opened
+ * DESCRIPTION: takes a free entry of the open-file table
  *
  * INPUTS: none
+ * OUTPUTS: the entry, with one reference and nothing else set, or NULL
+ *          if the table is full
+ * SIDE EFFECTS: none
+ *
+*/
+static file_t *alloc_file() {
+    int i;
+    for (i = 0; i < MAX_OPEN_FILES; i++) {
+        if (!(open_files[i].flags & FILE_OPEN)) {
+            memset(&open_files[i], 0, sizeof(file_t));
+            open_files[i].flags = FILE_OPEN;
+            open_files[i].refcount = 1;
+            open_files[i].fileops = fail_ops;
+            return &open_files[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * grow_fds(pcb_t *pcb)
+ *
+ * DESCRIPTION: moves a process's fd table out of its pcb into a frame
+ *              with room for MAX_FDS
+ *
+ * INPUTS: pcb - the process
+ * OUTPUTS: 0 on sucess, -1 if it already has MAX_FDS or no frame is free
+ * SIDE EFFECTS: allocates a frame
+ *
+*/
+static int32_t grow_fds(pcb_t *pcb) {
+    if (pcb->num_fds == MAX_FDS) {
+        return -1;
+    }
+
+    file_t **fds = alloc_frame();
+    if (fds == NULL) {
+        return -1;
+    }
+
+    memset(fds, 0, MAX_FDS * sizeof(file_t *));
+    memcpy(fds, pcb->fds, pcb->num_fds * sizeof(file_t *));
+    pcb->fds = fds;
+    pcb->num_fds = MAX_FDS;
+    return 0;
+}
+
+/*
+ * set_fd(pcb_t *pcb, int32_t fd, file_t *file)
+ *
+ * DESCRIPTION: points a free fd at an open file, growing the table if
+ *              the fd is past its end. Takes over a reference the caller
+ *              already holds.
+ *
+ * INPUTS: pcb - the process
+ *         fd - the fd, less than MAX_FDS
+ *         file - the open file
+ * OUTPUTS: 0 on sucess, -1 if the table cannot grow
+ * SIDE EFFECTS: none
+ *
+*/
+static int32_t set_fd(pcb_t *pcb, int32_t fd, file_t *file) {
+    if ((uint32_t) fd >= pcb->num_fds && grow_fds(pcb)) {
+        return -1;
+    }
+
+    pcb->fds[fd] = file;
+    pcb->fd_bitmap[fd >> 5] |= 1 << (fd & 0x1F);
+    return 0;
+}
+
+/*
+ * install_fd(pcb_t *pcb, file_t *file)
+ *
+ * DESCRIPTION: points the lowest free fd at an open file, the way open
+ *              picks one. Takes over a reference the caller holds.
+ *
+ * INPUTS: pcb - the process
+ *         file - the open file
+ * OUTPUTS: the fd, or -1 if the table is full
+ * SIDE EFFECTS: may grow the table
+ *
+*/
+static int32_t install_fd(pcb_t *pcb, file_t *file) {
+    uint32_t i, bit;
+    for (i = 0; i < FD_BITMAP_WORDS; i++) {
+        if (pcb->fd_bitmap[i] != 0xFFFFFFFF) {
+            break;
+        }
+    }
+
+    if (i == FD_BITMAP_WORDS) {
+        return -1;
+    }
+
+    // Lowest clear bit of the word
+    asm ("bsfl %1, %0" : "=r" (bit) : "r" (~pcb->fd_bitmap[i]) : "cc");
+
+    int32_t fd = (i << 5) + bit;
+    return set_fd(pcb, fd, file) ? -1 : fd;
+}
+
+/*
+ * forget_fd(pcb_t *pcb, int32_t fd)
+ *
+ * DESCRIPTION: frees an fd without touching the open file
+ *
+ * INPUTS: pcb - the process
+ *         fd - an fd in use
+ * OUTPUTS: none
+ * SIDE EFFECTS: none
+ *
+*/
+static void forget_fd(pcb_t *pcb, int32_t fd) {
+    pcb->fds[fd] = NULL;
+    pcb->fd_bitmap[fd >> 5] &= ~(1 << (fd & 0x1F));
+}
+
+/*
+ * drop_fd(pcb_t *pcb, int32_t fd, uint32_t force)
+ *
+ * DESCRIPTION: frees an fd. The open file is closed with the last
+ *              reference to it; if its close fails, the fd stays unless
+ *              force is set. Closing goes through the current process's
+ *              fds, so pcb must be it whenever fd holds the last reference.
+ *
+ * INPUTS: pcb - the process
+ *         fd - an fd in use
+ *         force - 1 to free the fd even if closing fails
+ * OUTPUTS: 0 on sucess, -1 if the close failed and the fd stays
+ * SIDE EFFECTS: may close the file
+ *
+*/
+static int32_t drop_fd(pcb_t *pcb, int32_t fd, uint32_t force) {
+    file_t *file = pcb->fds[fd];
+
+    if (file->refcount == 1) {
+        if (file->fileops.close(fd) && !force) {
+            return -1;
+        }
+        file->flags = 0;
+    }
+
+    file->refcount--;
+    forget_fd(pcb, fd);
+    return 0;
+}
+
+/*
+ * free_fds(pcb_t *pcb)
+ *
+ * DESCRIPTION: frees every fd of the current process as it halts
+ *
+ * INPUTS: pcb - the current process
+ * OUTPUTS: none
+ * SIDE EFFECTS: closes files nothing else has open, frees a grown table
+ *
+*/
+static void free_fds(pcb_t *pcb) {
+    uint32_t fd;
+    for (fd = 0; fd < pcb->num_fds; fd++) {
+        if (pcb->fds[fd] != NULL) {
+            drop_fd(pcb, fd, 1);
+        }
+    }
+
+    if (pcb->fds != pcb->fd_inline) {
+        free_frame(pcb->fds);
+    }
+    pcb->fds = pcb->fd_inline;
+    pcb->num_fds = MAX_FILES;
+}
+
+/*
+ * new_tty(pcb_t *pcb, int32_t fd, fileops_t *ops)
+ *
+ * DESCRIPTION: opens the terminal for a new process
+ *
+ * INPUTS: pcb - the process
+ *         fd - 0 for stdin or 1 for stdout
+ *         ops - what that end does
+ * OUTPUTS: 0 on sucess, -1 if the open-file table is full
+ * SIDE EFFECTS: none
+ *
+*/
+static int32_t new_tty(pcb_t *pcb, int32_t fd, fileops_t *ops) {
+    file_t *file = alloc_file();
+    if (file == NULL) {
+        return -1;
+    }
+
+    file->fileops = *ops;
+    file->type = tty;
+    file->flags |= FILE_CONSOLE;
+    return set_fd(pcb, fd, file);
+}
+
+/*
+ * new_serial(pcb_t *pcb, int32_t fd)
+ *
+ * DESCRIPTION: opens the serial port for a new process, as opening
+ *              dev/ttyS0 would. Unlike the terminal it is passed down to
+ *              the programs the process starts.
+ *
+ * INPUTS: pcb - the process
+ *         fd - 0 for stdin or 1 for stdout
+ * OUTPUTS: 0 on sucess, -1 if the open-file table is full
+ * SIDE EFFECTS: none
+ *
+*/
+static int32_t new_serial(pcb_t *pcb, int32_t fd) {
+    file_t *file = alloc_file();
+    if (file == NULL) {
+        return -1;
+    }
+
+    file->fileops = serial_ops;
+    file->type = tty;
+    file->inode = DEV_SERIAL_INODE;
+    return set_fd(pcb, fd, file);
+}
+
+// A program found for execute, before anything is set up for it
+typedef struct program {
+    rofs_t *fs;
+    uint32_t inode;
+    uint32_t length;
+    uint32_t entry;
+    int8_t args[COMMAND_SIZE];
+} program_t;
+
+/*
+ * can_execute(uint32_t count)
+ *
+ * DESCRIPTION: check whether more processes can be started
+ *
+ * INPUTS: count - how many
  * OUTPUTS: none
  * SIDE EFFECTS: returns 0 if can't execute, and 1 if can execute
  *
 */
-uint8_t can_execute() {
+uint8_t can_execute(uint32_t count) {
     int i;
     int total = 0;
     for (i = 0; i < 3; i++) {
         total += terminal[i].num_processes;
     }
-    return total < MAX_PROCESSES;
+    return total + count <= MAX_PROCESSES;
+}
+
+/*
+ * switch_stage(uint32_t *save_esp, pcb_t *next)
+ *
+ * DESCRIPTION: runs another stage of a pipeline where it left off
+ *
+ * INPUTS: save_esp - where to keep this kernel stack
+ *         next - the stage to run
+ * OUTPUTS: none
+ * SIDE EFFECTS: maps the stage's memory, returns once something switches back
+ *
+*/
+static void switch_stage(uint32_t *save_esp, pcb_t *next) {
+    terminal[term_cur - 1].term_pid = next->pid;
+    remap(VIRTUAL_START, PHYSICAL_START + next->pid * FOUR_MB_BLOCK);
+    tss.ss0 = KERNEL_DS;
+    tss.esp0 = PHYSICAL_START - next->pid * EIGHT_KB_BLOCK - MAGIC_SIZE;
+
+    switch_context(save_esp, next->esp);
 }
 
 /*
@@ -42,27 +318,39 @@ uint8_t can_execute() {
  *
  * INPUTS: status
  * OUTPUTS: status
- * SIDE EFFECTS: restores values of parent process
+ * SIDE EFFECTS: restores values of parent process, or runs the next
+ *               stage if this one was part of a pipeline
  *
 */
 int32_t halt(uint8_t status) {
     cli();
 
-    int i;
     pcb_t *pcb = get_current_pcb();
 
-    for(i = 2; i < MAX_FILES; i++)
-    {
-        if((pcb->files[i].flags) & FILE_OPEN)
-        {
-            pcb->files[i].fileops.close(i);
-        }
+    free_fds(pcb);
+    io_release(&pcb->io);
+    if (pcb->vidmapped) {
+        unpin_video_page(term_cur - 1);
+    }
+    if (pcb->raw_tty) {
+        terminal_set_raw(0);
     }
 
     // update number of processes running in current terminal
     terminal[term_cur-1].num_processes--;
     processes_flags &= ~(1 << pcb->pid);
 
+    if (pcb->stage_next != pcb->pid) {
+        // The rest of the pipeline keeps going, the last to halt returns
+        pcb_t *prev = pcb;
+        uint32_t unused;
+        while (prev->stage_next != pcb->pid) {
+            prev = get_pcb(prev->stage_next);
+        }
+        prev->stage_next = pcb->stage_next;
+        switch_stage(&unused, get_pcb(pcb->stage_next));
+    }
+
     if (terminal[term_cur-1].num_processes == 0) {
         execute("shell");
     }
@@ -88,14 +376,207 @@ int32_t halt(uint8_t status) {
     return status;
 }
 
+/*
+ * find_program(const int8_t *command, uint32_t length, program_t *program)
+ *
+ * DESCRIPTION: finds the program a command runs and checks it can be loaded
+ *
+ * INPUTS: command - program name then its arguments, not terminated
+ *         length - characters in command
+ * OUTPUTS: program - where it is and what to pass it
+ *          0 on sucess, -1 on failure
+ * SIDE EFFECTS: none
+ *
+*/
+static int32_t find_program(const int8_t *command, uint32_t length, program_t *program) {
+    int8_t com_buf[COMMAND_SIZE];
+    uint8_t buffer[MAGIC_SIZE];
+    uint32_t i;
+
+    // Spaces around a '|' are not part of either command
+    while (length > 0 && command[0] == ' ') {
+        command++;
+        length--;
+    }
+    while (length > 0 && command[length - 1] == ' ') {
+        length--;
+    }
+    if (length == 0 || length >= COMMAND_SIZE) {
+        return -1;
+    }
+
+    // Copy command
+    for (i = 0; i < length && command[i] != ' '; i++) {
+        com_buf[i] = command[i];
+    }
+    com_buf[i] = '\0';
+
+    // Copy all the arguments if we hit a space
+    memset(program->args, 0, COMMAND_SIZE);
+    if (i < length) {
+        strncpy(program->args, command + i + 1, length - i - 1);
+    }
+
+    // Read the file, programs can be run out of any rofs mount
+    const int8_t *name;
+    mount_t *mount = resolve_path(com_buf, &name);
+    if (mount == NULL || mount->type != MOUNT_ROFS) {
+        return -1;
+    }
+
+    rofs_t *fs = &mount->rofs;
+    dentry_t dentry;
+    if (read_dentry_by_name(fs, name, &dentry) || dentry.file_type != file) {
+        return -1;
+    }
+
+    // Check ELF magic number
+    read_data(fs, dentry.inode_num, 0, buffer, MAGIC_SIZE);
+    if(buffer[0] != MAGIC0 || buffer[1] != MAGIC1 || buffer[2] != MAGIC2 || buffer[3] != MAGIC3) {
+        return -1;
+    }
+
+    // The whole program has to fit in its 4MB page above the load address
+    stat_t stat;
+    if (read_stat(fs, dentry.file_type, dentry.inode_num, &stat)
+        || stat.length > VIRTUAL_END - EXECUTE_START) {
+        return -1;
+    }
+
+    // Read first instruction
+    read_data(fs, dentry.inode_num, 24, buffer, MAGIC_SIZE);
+
+    program->fs = fs;
+    program->inode = dentry.inode_num;
+    program->length = stat.length;
+    program->entry = *((uint32_t*)buffer);
+    return 0;
+}
+
+/*
+ * make_pipe(file_t **ends)
+ *
+ * DESCRIPTION: creates a pipe and opens both of its ends
+ *
+ * INPUTS: none
+ * OUTPUTS: ends - the read end then the write end, each with one reference
+ *          0 on sucess, -1 on failure
+ * SIDE EFFECTS: allocates a frame for the pipe's buffer
+ *
+*/
+static int32_t make_pipe(file_t **ends) {
+    int32_t index = pipe_create();
+    if (index < 0) {
+        return -1;
+    }
+
+    ends[0] = alloc_file();
+    ends[1] = ends[0] == NULL ? NULL : alloc_file();
+    if (ends[1] == NULL) {
+        if (ends[0] != NULL) {
+            ends[0]->flags = 0;
+        }
+        pipe_release(index, 0);
+        pipe_release(index, 1);
+        return -1;
+    }
+
+    ends[0]->fileops = pipe_reader_ops;
+    ends[0]->inode = index;
+    ends[0]->type = fifo;
+
+    ends[1]->fileops = pipe_writer_ops;
+    ends[1]->inode = index;
+    ends[1]->type = fifo;
+    ends[1]->flags |= FILE_PIPE_WRITER;
+    return 0;
+}
+
+/*
+ * unmake_pipe(file_t **ends)
+ *
+ * DESCRIPTION: closes both ends of a pipe no fd points at yet
+ *
+ * INPUTS: ends - from make_pipe
+ * OUTPUTS: none
+ * SIDE EFFECTS: frees the pipe
+ *
+*/
+static void unmake_pipe(file_t **ends) {
+    pipe_release(ends[0]->inode, 0);
+    pipe_release(ends[1]->inode, 1);
+    ends[0]->flags = 0;
+    ends[1]->flags = 0;
+}
+
+/*
+ * stage_start()
+ *
+ * DESCRIPTION: first thing a pipeline stage runs when it is switched to,
+ *              goes to its program the way execute does
+ *
+ * INPUTS: none
+ * OUTPUTS: none
+ * SIDE EFFECTS: never returns
+ *
+*/
+static void stage_start() {
+    uint32_t com_start = get_current_pcb()->entry;
+
+    asm volatile (
+        "movw $0x2B, %%ax\n\t"
+        "movw %%ax, %%ds\n\t"
+        "movl $0x83FFFFC, %%eax\n\t"
+        "pushl $0x2B\n\t"
+        "pushl %%eax\n\t"
+        "pushfl\n\t"
+        "popl %%edx\n\t"
+        "orl $0x200, %%edx\n\t"
+        "pushl %%edx\n\t"
+        "pushl $0x23\n\t"
+        "pushl %0\n\t"
+        "iret\n\t"
+        : // No outputs
+        : "r" (com_start)
+        : "%eax", "%edx"
+    );
+}
+
+/*
+ * prepare_stage(pcb_t *pcb)
+ *
+ * DESCRIPTION: sets up a stage's kernel stack so that switching to it
+ *              starts its program
+ *
+ * INPUTS: pcb - the stage
+ * OUTPUTS: none
+ * SIDE EFFECTS: none
+ *
+*/
+static void prepare_stage(pcb_t *pcb) {
+    uint32_t *stack = (uint32_t *)(PHYSICAL_START - pcb->pid * EIGHT_KB_BLOCK - MAGIC_SIZE);
+
+    // What switch_context pops: edi, esi, ebx, ebp, then where it returns to
+    stack -= 5;
+    stack[0] = 0;
+    stack[1] = 0;
+    stack[2] = 0;
+    stack[3] = 0;
+    stack[4] = (uint32_t) stage_start;
+    pcb->esp = (uint32_t) stack;
+}
+
 /*
  * execute(const int8_t *command)
  *
- * DESCRIPTION: load and execute a new program
+ * DESCRIPTION: load and execute a new program, or a pipeline of them
+ *              separated by '|' with each one's output going to the
+ *              next one's input
  *
  * INPUTS: command
  * OUTPUTS: 0 on sucess, -1 on failure
- * SIDE EFFECTS: hands processor off to new program
+ * SIDE EFFECTS: hands processor off to new program, returns once every
+ *               stage has halted with the status of the last one
  *
 */
 int32_t execute(const int8_t *command) {
@@ -106,88 +587,108 @@ int32_t execute(const int8_t *command) {
         return -1;
     }
 
-    uint32_t com_start;
-    int8_t com_buf[COMMAND_SIZE] = {0};
-    int8_t arg_buf[COMMAND_SIZE] = {0};
-    uint8_t buffer[MAGIC_SIZE] = {0};
-    uint8_t i;
-    int arg_start;
-
-    // Must clear arg_buf manually when called as interrupt
-    memset(arg_buf, 0, COMMAND_SIZE);
-
-    // Copy command
-    for(i = 0; (command[i] != ' ') && (command[i] != '\0') && (command[i] != '\n'); i++)
-    {
-        com_buf[i] = (int8_t)command[i];
-    }
-    com_buf[i] = '\0';
+    program_t programs[MAX_STAGES];
+    pcb_t *stages[MAX_STAGES];
+    file_t *ends[2 * (MAX_STAGES - 1)];     // Read then write end of each pipe
+    const int8_t *start, *end;
+    uint32_t num_stages, i;
 
-    if (strncmp(com_buf, "exit", 4) == 0) {
+    if (strncmp(command, "exit", 4) == 0) {
         // We got exit passed to execute for some reason...
         halt(0);
         return 0;
     }
 
-    // Read the file
-    dentry_t dentry;
-    if (read_dentry_by_name(com_buf, &dentry)) {
-        return -1;
-    }
+    // Every program has to be there before any of them starts
+    for (num_stages = 0, start = command; ; start = end + 1) {
+        for (end = start; *end != '\0' && *end != '\n' && *end != '|'; end++);
 
-    // Check ELF magic number
-    read_data(dentry.inode_num, 0, buffer, MAGIC_SIZE);
-    if(buffer[0] != MAGIC0 || buffer[1] != MAGIC1 || buffer[2] != MAGIC2 || buffer[3] != MAGIC3) {
-        return -1;
+        if (num_stages == MAX_STAGES || find_program(start, end - start, &programs[num_stages])) {
+            return -1;
+        }
+        num_stages++;
+
+        if (*end != '|') {
+            break;
+        }
     }
 
     // Check if max number of processes are being run
-    if (!can_execute())
+    if (!can_execute(num_stages))
     {
         printf("Maximum number of processes reached\n");
         return 0;
     }
 
-    // Copy all the arguments if we hit a space
-    if (command[i] == ' ') {
-        arg_start = i + 1;
-        for (i = 0; command[i + arg_start] != '\0' && command[i + arg_start] != '\n'; i++) {
-            arg_buf[i] = (int8_t)command[i + arg_start];
+    for (i = 0; i + 1 < num_stages; i++) {
+        if (make_pipe(&ends[2 * i])) {
+            while (i-- > 0) {
+                unmake_pipe(&ends[2 * i]);
+            }
+            return -1;
         }
-        arg_buf[i] = '\0';
     }
 
+    // Every pcb before anything is mapped or loaded, so a failure leaves
+    // the caller's memory in place and only the pcbs and pipes to undo.
+    // No pipe end is in an fd yet, and dropping a stage's terminal or
+    // inherited fds closes nothing through the caller's fds.
+    for (i = 0; i < num_stages; i++) {
+        stages[i] = create_pcb();
+        if (stages[i] == NULL) {
+            while (i-- > 0) {
+                free_fds(stages[i]);
+                processes_flags &= ~(1 << stages[i]->pid);
+            }
+            for (i = 0; i + 1 < num_stages; i++) {
+                unmake_pipe(&ends[2 * i]);
+            }
+            return -1;
+        }
+    }
 
-    // Read first instruction
-    read_data(dentry.inode_num, 24, buffer, MAGIC_SIZE);
-    com_start = *((uint32_t*)buffer);
+    for (i = 0; i < num_stages; i++) {
+        // In place of whatever the stage got from its parent
+        if (i > 0) {
+            drop_fd(stages[i], 0, 1);
+            set_fd(stages[i], 0, ends[2 * (i - 1)]);
+            stages[i - 1]->stage_next = stages[i]->pid;
+            prepare_stage(stages[i]);
+        }
+        if (i + 1 < num_stages) {
+            drop_fd(stages[i], 1, 1);
+            set_fd(stages[i], 1, ends[2 * i + 1]);
+        }
+        stages[i]->stage_next = stages[0]->pid;
 
-    // Create pcb
-    pcb_t *pcb_new = create_pcb();
-    if(pcb_new == NULL) {
-        return -1;
+        strncpy(stages[i]->args, programs[i].args, MAX_ARGS_LENGTH);
+        stages[i]->entry = programs[i].entry;
+
+        // Map memory and move program code to execution start
+        remap(VIRTUAL_START, PHYSICAL_START + stages[i]->pid * FOUR_MB_BLOCK);
+        read_data(programs[i].fs, programs[i].inode, 0, (uint8_t *) EXECUTE_START, programs[i].length);
     }
 
     // update number of processes running in current terminal
-    terminal[term_cur-1].num_processes++;
-    terminal[term_cur-1].term_pid = pcb_new->pid;
+    terminal[term_cur-1].num_processes += num_stages;
+    terminal[term_cur-1].term_pid = stages[0]->pid;
     asm volatile (
         "movl %%ebp, %0\n\t"
         "movl %%esp, %1\n\t"
-        : "=r" (pcb_new->parent_ebp), "=r" (pcb_new->parent_esp)
+        : "=r" (stages[0]->parent_ebp), "=r" (stages[0]->parent_esp)
     );
 
-    // Map memory and move program code to execution start
-    remap(VIRTUAL_START, PHYSICAL_START + pcb_new->pid * FOUR_MB_BLOCK);
-    read_data(dentry.inode_num, 0, (uint8_t *) EXECUTE_START, FOUR_MB_BLOCK);
+    // Whichever stage halts last comes back here
+    for (i = 1; i < num_stages; i++) {
+        stages[i]->parent_ebp = stages[0]->parent_ebp;
+        stages[i]->parent_esp = stages[0]->parent_esp;
+    }
+
+    remap(VIRTUAL_START, PHYSICAL_START + stages[0]->pid * FOUR_MB_BLOCK);
 
     // Set up flags
     tss.ss0 = KERNEL_DS;
-    tss.esp0 = PHYSICAL_START - pcb_new->pid * EIGHT_KB_BLOCK - MAGIC_SIZE;
-
-    //pcb_new->parent->esp = esp_temp;
-    //pcb_new->parent->ebp = ebp_temp;
-    strncpy(pcb_new->args, arg_buf, MAX_ARGS_LENGTH);
+    tss.esp0 = PHYSICAL_START - stages[0]->pid * EIGHT_KB_BLOCK - MAGIC_SIZE;
 
     // Context switch
     asm volatile (
@@ -207,7 +708,7 @@ int32_t execute(const int8_t *command) {
         "leave\n\t"
         "ret\n\t"
         : // No outputs
-        : "r" (com_start)
+        : "r" (programs[0].entry)
         : "%eax", "%edx"
     );
 
@@ -227,18 +728,14 @@ int32_t execute(const int8_t *command) {
  *
 */  
 int32_t read(int32_t fd, void *buf, int32_t nbytes) {
-    if (fd < 0 || fd >= MAX_FILES || buf == NULL) {
-        return -1;
-    }
-
-    pcb_t *pcb = get_current_pcb(); // Get this somehow
+    file_t *file = get_file(fd);
 
-    if (!(pcb->files[fd].flags & FILE_OPEN)) {
+    if (file == NULL || buf == NULL) {
         // File has not been opened - invalid
         return -1;
     }
 
-    return pcb->files[fd].fileops.read(fd, (int8_t *)buf, nbytes);
+    return file->fileops.read(fd, (int8_t *)buf, nbytes);
 }
 
 /*
@@ -254,18 +751,14 @@ int32_t read(int32_t fd, void *buf, int32_t nbytes) {
  *
 */
 int32_t write(int32_t fd, const void *buf, int32_t nbytes) {
-    if (fd < 0 || fd >= MAX_FILES || buf == NULL) {
-        return -1;
-    }
-
-    pcb_t *pcb = get_current_pcb();
+    file_t *file = get_file(fd);
 
-    if (!(pcb->files[fd].flags & FILE_OPEN)) {
+    if (file == NULL || buf == NULL) {
         // File has not been opened - invalid
         return -1;
     }
 
-    return pcb->files[fd].fileops.write(fd, buf, nbytes);
+    return file->fileops.write(fd, buf, nbytes);
 }
 
 /*
@@ -275,7 +768,8 @@ int32_t write(int32_t fd, const void *buf, int32_t nbytes) {
  *
  * INPUTS: filename
  * OUTPUTS: 0 on sucess, -1 on failure
- * SIDE EFFECTS: allocates fd, setup data to handle file type
+ * SIDE EFFECTS: allocates the lowest free fd and an open-file table
+ *               entry, setup data to handle file type
  *
 */
 int32_t open(const int8_t *filename) {
@@ -283,54 +777,73 @@ int32_t open(const int8_t *filename) {
         return -1;
     }
 
+    // The mount table decides which file system the path is in
+    const int8_t *name;
+    mount_t *mount = resolve_path(filename, &name);
+    if (mount == NULL) {
+        return -1;
+    }
+
     dentry_t dentry;
-    if (read_dentry_by_name(filename, &dentry)) {
+    uint8_t in_tmpfs = mount->type == MOUNT_TMPFS;
+    uint8_t in_dev = mount->type == MOUNT_DEV;
+    if (in_tmpfs ? tmpfs_read_dentry(filename, &dentry)
+        : in_dev ? dev_read_dentry(filename, &dentry)
+                 : read_dentry_by_name(&mount->rofs, name, &dentry)) {
         // File not found
         return -1;
     }
 
     pcb_t *pcb = get_current_pcb();
 
-    int i;
-    for (i = 2; i < MAX_FILES; i++) {
-        if (!(pcb->files[i].flags & FILE_OPEN)) {
-            // Open slot for file
-            pcb->files[i].flags |= FILE_OPEN;
-            pcb->files[i].pos = 0;
-            break;
-        }
+    file_t *f = alloc_file();
+    if (f == NULL) {
+        // Every open-file table entry is taken
+        return -1;
     }
 
-    if (i == MAX_FILES) {
-        // 8 files are already open
+    int32_t fd = install_fd(pcb, f);
+    if (fd < 0) {
+        // The fd table is full
+        f->flags = 0;
         return -1;
     }
 
     switch ((file_type_t) dentry.file_type) {
         case rtc:
-            pcb->files[i].fileops = rtc_ops;
+            f->fileops = rtc_ops;
             break;
         case dir:
-            pcb->files[i].fileops = dir_ops;
+            f->fileops = in_tmpfs ? tmpfs_dir_ops : in_dev ? dev_dir_ops : dir_ops;
             break;
         case file:
-            pcb->files[i].fileops = file_ops;
+            f->fileops = in_tmpfs ? tmpfs_file_ops : file_ops;
+            break;
+        case block:
+            f->fileops = blockdev_ops;
+            break;
+        case tty:
+            f->fileops = dentry.inode_num == DEV_KMSG_INODE ? kmsg_ops : serial_ops;
             break;
         default:
             // Unknown filetype
-            pcb->files[i].flags &= ~FILE_OPEN;
+            forget_fd(pcb, fd);
+            f->flags = 0;
             return -1;
     }
 
-    if (pcb->files[i].fileops.open(filename)) {
+    if (f->fileops.open(filename)) {
         // Error opening
-        pcb->files[i].flags &= ~FILE_OPEN;
+        forget_fd(pcb, fd);
+        f->flags = 0;
         return -1;
     }
 
-    pcb->files[i].inode = dentry.inode_num;
+    f->inode = dentry.inode_num;
+    f->type = dentry.file_type;
+    f->fs = mount->type == MOUNT_ROFS ? &mount->rofs : NULL;
 
-    return i;
+    return fd;
 }
 
 /*
@@ -344,26 +857,13 @@ int32_t open(const int8_t *filename) {
  *
 */
 int32_t close(int32_t fd) {
-    if (fd < 0 || fd >= MAX_FILES) {
-        return -1;
-    }
-
-    pcb_t *pcb = get_current_pcb();
-
-    if (!(pcb->files[fd].flags & FILE_OPEN)) {
+    if (get_file(fd) == NULL) {
         // File isn't open, can't close
         return -1;
     }
 
-    // Close file
-    int32_t err = pcb->files[fd].fileops.close(fd);
-
-    // Set closed flag on no error
-    if (!err) {
-        pcb->files[fd].flags &= ~FILE_OPEN;
-    }
-
-    return err;
+    // The file itself closes with its last fd, the fd stays if that fails
+    return drop_fd(get_current_pcb(), fd, 0);
 }
 
 /*
@@ -400,7 +900,7 @@ int32_t getargs(int8_t *buf, int32_t nbytes) {
 /*
  * vidmap(uint8_t **screen_start)
  *
- * DESCRIPTION: maps video memory to virtual address
+ * DESCRIPTION: maps the terminal's page of video memory to virtual address
  *
  * INPUTS: screen_start
  * OUTPUTS: 0 on sucess, -1 on failure
@@ -415,7 +915,13 @@ int32_t vidmap(uint8_t **screen_start) {
     if ((int32_t) screen_start < VIRTUAL_START || (int32_t) screen_start > VIRTUAL_END){
         return -1;
     }
-    remapWithPageTable(VIRTUAL_END,VIDEOMEM);
+    // the page of video memory the process's terminal draws in, which
+    // stops scrolling in hardware so the screen stays where it is mapped
+    if (!get_current_pcb()->vidmapped) {
+        pin_video_page(term_cur - 1);
+        get_current_pcb()->vidmapped = 1;
+    }
+    remapWithPageTable(VIRTUAL_END, (uint32_t) terminal[term_cur - 1].vid_mem);
     *screen_start = (uint8_t *) VIRTUAL_END;
     return 0;
 }
@@ -440,6 +946,381 @@ int32_t sigreturn() {
     return -1;
 }
 
+/*
+ * stat(const int8_t *filename, stat_t *buf)
+ *
+ * DESCRIPTION: gets file information without opening the file
+ *
+ * INPUTS: filename - name of the file
+ * OUTPUTS: buf - type, inode, length and block count of the file
+ *          returns 0 on sucess, -1 on failure
+ * SIDE EFFECTS: none
+ *
+*/
+int32_t stat(const int8_t *filename, stat_t *buf) {
+    if (filename == NULL || buf == NULL) {
+        return -1;
+    }
+
+    const int8_t *name;
+    mount_t *mount = resolve_path(filename, &name);
+    if (mount == NULL) {
+        return -1;
+    }
+
+    if (mount->type == MOUNT_TMPFS) {
+        return tmpfs_stat_name(filename, buf);
+    }
+
+    if (mount->type == MOUNT_DEV) {
+        return dev_stat_name(filename, buf);
+    }
+
+    dentry_t dentry;
+    if (read_dentry_by_name(&mount->rofs, name, &dentry)) {
+        // File not found
+        return -1;
+    }
+
+    return read_stat(&mount->rofs, dentry.file_type, dentry.inode_num, buf);
+}
+
+/*
+ * fstat(int32_t fd, stat_t *buf)
+ *
+ * DESCRIPTION: gets file information for an open file
+ *
+ * INPUTS: fd - the open file
+ * OUTPUTS: buf - type, inode, length and block count of the file
+ *          returns 0 on sucess, -1 on failure
+ * SIDE EFFECTS: none
+ *
+*/
+int32_t fstat(int32_t fd, stat_t *buf) {
+    file_t *file = get_file(fd);
+
+    if (file == NULL || buf == NULL) {
+        // File has not been opened - invalid
+        return -1;
+    }
+
+    return file->fileops.stat(fd, buf);
+}
+
+/*
+ * create(const int8_t *filename)
+ *
+ * DESCRIPTION: creates an empty writable file and opens it
+ *
+ * INPUTS: filename - path of the file, must be in the tmpfs
+ * OUTPUTS: fd on sucess, -1 on failure
+ * SIDE EFFECTS: an existing file with the name is emptied
+ *
+*/
+int32_t create(const int8_t *filename) {
+    if (filename == NULL) {
+        return -1;
+    }
+
+    if (tmpfs_create(filename) < 0) {
+        // Only the tmpfs is writable
+        return -1;
+    }
+
+    return open(filename);
+}
+
+/*
+ * unlink(const int8_t *filename)
+ *
+ * DESCRIPTION: removes a file
+ *
+ * INPUTS: filename - path of the file, must be in the tmpfs
+ * OUTPUTS: 0 on sucess, -1 on failure
+ * SIDE EFFECTS: file data is freed once nothing has it open
+ *
+*/
+int32_t unlink(const int8_t *filename) {
+    if (filename == NULL) {
+        return -1;
+    }
+
+    return tmpfs_unlink(filename);
+}
+
+/*
+ * truncate(const int8_t *filename, uint32_t length)
+ *
+ * DESCRIPTION: sets the length of a file
+ *
+ * INPUTS: filename - path of the file, must be in the tmpfs
+ *         length - new length, zeros are read past the old end
+ * OUTPUTS: 0 on sucess, -1 on failure
+ * SIDE EFFECTS: frees pages past the new end
+ *
+*/
+int32_t truncate(const int8_t *filename, uint32_t length) {
+    if (filename == NULL) {
+        return -1;
+    }
+
+    return tmpfs_truncate(filename, length);
+}
+
+/*
+ * pipe(int32_t *fds)
+ *
+ * DESCRIPTION: creates a pipe, what is written to one end can be read
+ *              from the other
+ *
+ * INPUTS: fds - room for two file descriptors in the process's page
+ * OUTPUTS: fds - the read end then the write end
+ *          0 on sucess, -1 on failure
+ * SIDE EFFECTS: allocates two fds and a frame for the pipe's buffer
+ *
+*/
+int32_t pipe(int32_t *fds) {
+    if (!in_user_page(fds, 2 * sizeof(int32_t))) {
+        return -1;
+    }
+
+    pcb_t *pcb = get_current_pcb();
+
+    file_t *ends[2];
+    if (make_pipe(ends)) {
+        return -1;
+    }
+
+    int32_t read_fd = install_fd(pcb, ends[0]);
+    int32_t write_fd = read_fd < 0 ? -1 : install_fd(pcb, ends[1]);
+    if (write_fd < 0) {
+        // Not enough free fds
+        if (read_fd >= 0) {
+            forget_fd(pcb, read_fd);
+        }
+        unmake_pipe(ends);
+        return -1;
+    }
+
+    fds[0] = read_fd;
+    fds[1] = write_fd;
+    return 0;
+}
+
+/*
+ * sendfile(int32_t out_fd, int32_t in_fd, uint32_t *offset, int32_t count)
+ *
+ * DESCRIPTION: copies from one open file to another inside the kernel,
+ *              what a loop of read() and write() would do without the
+ *              trip through user memory
+ *
+ * INPUTS: out_fd - where the data goes
+ *         in_fd - where it comes from
+ *         offset - where to start reading in_fd, which keeps its
+ *                  position, or NULL to read from and move its position;
+ *                  must be in the process's page
+ *         count - most bytes to move
+ * OUTPUTS: offset - moved past what was sent
+ *          bytes sent, 0 at the end of in_fd, -1 on failure
+ * SIDE EFFECTS: may block like read() and write() on either file
+ *
+*/
+int32_t sendfile(int32_t out_fd, int32_t in_fd, uint32_t *offset, int32_t count) {
+    file_t *in = get_file(in_fd);
+    file_t *out = get_file(out_fd);
+
+    if (in == NULL || out == NULL || count < 0) {
+        // File has not been opened - invalid
+        return -1;
+    }
+
+    if (offset != NULL && !in_user_page(offset, sizeof(uint32_t))) {
+        return -1;
+    }
+
+    // Only files with a position can start somewhere else
+    uint8_t seekable = file_seekable(in);
+    if (offset != NULL && !seekable) {
+        return -1;
+    }
+
+    // A frame of its own, a pipe write can switch to a stage sending too
+    uint8_t *buf = alloc_frame();
+    if (buf == NULL) {
+        return -1;
+    }
+
+    int32_t saved_pos = in->pos;
+    if (offset != NULL) {
+        in->pos = *offset;
+    }
+
+    int32_t sent = 0;
+    int32_t err = 0;
+    while (sent < count) {
+        int32_t chunk = count - sent < FRAME_SIZE ? count - sent : FRAME_SIZE;
+        int32_t got = in->fileops.read(in_fd, buf, chunk);
+        if (got <= 0) {
+            err = got < 0;
+            break;
+        }
+
+        int32_t put = out->fileops.write(out_fd, buf, got);
+        if (put < got) {
+            // Whatever did not go out is read again next time
+            if (seekable) {
+                in->pos -= got - (put > 0 ? put : 0);
+            }
+            err = put < 0;
+            if (put > 0) {
+                sent += put;
+            }
+            break;
+        }
+        sent += put;
+    }
+
+    free_frame(buf);
+
+    if (offset != NULL) {
+        *offset = in->pos;
+        in->pos = saved_pos;
+    }
+
+    return sent == 0 && err ? -1 : sent;
+}
+
+/*
+ * dup(int32_t fd)
+ *
+ * DESCRIPTION: makes another fd for an open file, sharing its position
+ *
+ * INPUTS: fd - the open file
+ * OUTPUTS: the lowest free fd, -1 on failure
+ * SIDE EFFECTS: none
+ *
+*/
+int32_t dup(int32_t fd) {
+    file_t *file = get_file(fd);
+    if (file == NULL) {
+        return -1;
+    }
+
+    int32_t new_fd = install_fd(get_current_pcb(), file);
+    if (new_fd >= 0) {
+        file->refcount++;
+    }
+    return new_fd;
+}
+
+/*
+ * dup2(int32_t fd, int32_t new_fd)
+ *
+ * DESCRIPTION: points new_fd at the same open file as fd, closing what
+ *              new_fd had first, so stdin or stdout can be redirected
+ *
+ * INPUTS: fd - the open file
+ *         new_fd - fd to reuse, below MAX_FDS
+ * OUTPUTS: new_fd, -1 on failure
+ * SIDE EFFECTS: may grow the fd table
+ *
+*/
+int32_t dup2(int32_t fd, int32_t new_fd) {
+    pcb_t *pcb = get_current_pcb();
+    file_t *file = get_file(fd);
+
+    if (file == NULL || new_fd < 0 || new_fd >= MAX_FDS) {
+        return -1;
+    }
+
+    if (new_fd == fd) {
+        return new_fd;
+    }
+
+    if ((uint32_t) new_fd >= pcb->num_fds && grow_fds(pcb)) {
+        return -1;
+    }
+
+    // Even the terminal lets go of new_fd here, unlike with close
+    if (get_file(new_fd) != NULL) {
+        drop_fd(pcb, new_fd, 1);
+    }
+
+    set_fd(pcb, new_fd, file);
+    file->refcount++;
+    return new_fd;
+}
+
+/*
+ * ioctl(int32_t fd, uint32_t request, uint32_t arg)
+ *
+ * DESCRIPTION: changes how a terminal or the serial port is read.
+ *              IOCTL_NONBLOCK makes reads of the open file return 0 when
+ *              nothing is ready instead of waiting. IOCTL_RAW puts the
+ *              screen's terminal in raw mode, where each key is read as
+ *              it is pressed, unechoed, until it is set back or the
+ *              process halts.
+ *
+ * INPUTS: fd - the open file
+ *         request - IOCTL_NONBLOCK or IOCTL_RAW
+ *         arg - 1 to turn it on, 0 to turn it off
+ * OUTPUTS: 0 on sucess, -1 for other files or requests
+ * SIDE EFFECTS: none
+ *
+*/
+int32_t ioctl(int32_t fd, uint32_t request, uint32_t arg) {
+    file_t *file = get_file(fd);
+
+    if (file == NULL || file->type != tty) {
+        return -1;
+    }
+
+    switch (request) {
+        case IOCTL_NONBLOCK:
+            if (arg) {
+                file->flags |= FILE_NONBLOCK;
+            } else {
+                file->flags &= ~FILE_NONBLOCK;
+            }
+            return 0;
+        case IOCTL_RAW:
+            if (!(file->flags & FILE_CONSOLE)) {
+                return -1;
+            }
+            terminal_set_raw(arg);
+            get_current_pcb()->raw_tty = arg != 0;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/*
+ * pipeline_yield()
+ *
+ * DESCRIPTION: lets the next stage of the pipeline run, for a pipe end
+ *              that has to wait on another stage
+ *
+ * INPUTS: none
+ * OUTPUTS: 0 once this stage runs again, -1 if it is not in a pipeline
+ * SIDE EFFECTS: switches processes
+ *
+*/
+int32_t pipeline_yield() {
+    pcb_t *pcb = get_current_pcb();
+    uint32_t flags;
+
+    if (pcb->stage_next == pcb->pid) {
+        // Nothing else could get it unstuck
+        return -1;
+    }
+
+    cli_and_save(flags);
+    switch_stage(&pcb->esp, get_pcb(pcb->stage_next));
+    restore_flags(flags);
+    return 0;
+}
+
 /*
  * fail()
  *
@@ -503,23 +1384,37 @@ pcb_t *create_pcb() {
         pcb->parent_pid = terminal[term_cur - 1].term_pid;
     }
 
-    pcb->files[0].fileops = stdin_ops;
-    pcb->files[0].flags = FILE_OPEN;
-    pcb->files[0].pos = 0;
-
-    pcb->files[1].fileops = stdout_ops;
-    pcb->files[1].flags = FILE_OPEN;
-    pcb->files[1].pos = 0;
-
-    int i;
-    for (i = 2; i < MAX_FILES; i++) {
-        pcb->files[i].fileops = fail_ops;
-        pcb->files[i].flags = 0;
-        pcb->files[i].inode = 0;
-        pcb->files[i].pos = 0;
+    pcb->fds = pcb->fd_inline;
+    pcb->num_fds = MAX_FILES;
+    memset(pcb->fd_inline, 0, sizeof(pcb->fd_inline));
+    memset(pcb->fd_bitmap, 0, sizeof(pcb->fd_bitmap));
+
+    // stdin and stdout come from the parent if it pointed them somewhere
+    // else, so a shell can redirect them, to the serial port too;
+    // otherwise the terminal. With console=ttyS0 the first terminal's
+    // shell gets the serial port, and everything it starts inherits it.
+    pcb_t *parent = get_pcb(pcb->parent_pid);
+    uint8_t on_serial = pcb->parent_pid == pid && term_cur == 1 && serial_is_console();
+    int32_t fd;
+    for (fd = 0; fd < 2; fd++) {
+        file_t *inherited = pcb->parent_pid != pid && parent->fds[fd] != NULL
+                            && !(parent->fds[fd]->flags & FILE_CONSOLE) ? parent->fds[fd] : NULL;
+        if (inherited != NULL) {
+            inherited->refcount++;
+            set_fd(pcb, fd, inherited);
+        } else if (on_serial ? new_serial(pcb, fd) : new_tty(pcb, fd, fd == 0 ? &stdin_ops : &stdout_ops)) {
+            free_fds(pcb);
+            processes_flags &= ~(1 << pid);
+            return NULL;
+        }
     }
 
     memset(pcb->args, 0, MAX_ARGS_LENGTH);
+    pcb->entry = 0;
+    pcb->stage_next = pid;
+    pcb->vidmapped = 0;
+    pcb->raw_tty = 0;
+    io_release(&pcb->io);
 
     return pcb;
 }
@@ -545,6 +1440,60 @@ pcb_t *get_current_pcb() {
     return pcb;
 }
 
+/*
+ * get_file(int32_t fd)
+ *
+ * DESCRIPTION: gets the open file behind one of the current process's fds
+ *
+ * INPUTS: fd - file descriptor
+ * OUTPUTS: the open file, NULL if fd is not in use
+ * SIDE EFFECTS: none
+ *
+*/
+file_t *get_file(int32_t fd) {
+    pcb_t *pcb = get_current_pcb();
+
+    if (fd < 0 || (uint32_t) fd >= pcb->num_fds) {
+        return NULL;
+    }
+
+    return pcb->fds[fd];
+}
+
+/*
+ * in_user_page(const void *ptr, uint32_t length)
+ *
+ * DESCRIPTION: checks that memory lies in the process's 4MB page, so the
+ *              kernel can read or write it, and keep using it across
+ *              syscalls
+ *
+ * INPUTS: ptr - start
+ *         length - bytes
+ * OUTPUTS: 1 if it does, 0 otherwise
+ * SIDE EFFECTS: none
+ *
+*/
+uint32_t in_user_page(const void *ptr, uint32_t length) {
+    uint32_t start = (uint32_t) ptr;
+    return start >= VIRTUAL_START && start < VIRTUAL_END && length <= VIRTUAL_END - start;
+}
+
+/*
+ * file_seekable(file_t *f)
+ *
+ * DESCRIPTION: checks whether an open file's position is a byte offset
+ *              that can be set, as for pread()-style reads; pipes, ttys,
+ *              directories and the log use it for something else
+ *
+ * INPUTS: f - the open file
+ * OUTPUTS: 1 for a regular file or a block device, 0 otherwise
+ * SIDE EFFECTS: none
+ *
+*/
+uint8_t file_seekable(const file_t *f) {
+    return f->type == file || f->type == block;
+}
+
 /*
  * get_pcb(uint32_t pid)
  *
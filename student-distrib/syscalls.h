@@ -2,14 +2,29 @@
 #define SYSCALLS_H_
 
 #include "types.h"
+#include "ioring.h"
+#include "rofs.h"
 
-#define MAX_FILES 8
+#define MAX_FILES 8             // fds every process has room for at first
+#define MAX_FDS 256             // Most fds a process's table grows to
+#define FD_BITMAP_WORDS (MAX_FDS / 32)
+#define MAX_OPEN_FILES 128      // Open files in the whole system
 #define MAX_ARGS_LENGTH 128
 #define MAX_PROCESSES_MASK 0x3F
 #define MAX_PROCESSES 6
 
 // Flags
-#define FILE_OPEN 0x00000001
+#define FILE_OPEN 0x00000001            // The open-file table entry is in use
+#define FILE_PIPE_WRITER 0x00000002     // The write end of a pipe
+#define FILE_CONSOLE 0x00000004         // A process's own screen and keyboard
+#define FILE_NONBLOCK 0x00000008        // Reads return 0 instead of waiting
+
+// ioctl requests, for terminals and the serial port
+#define IOCTL_NONBLOCK 1                // Set or clear FILE_NONBLOCK
+#define IOCTL_RAW 2                     // Raw or canonical mode, the screen only
+
+// Most programs one command can chain with '|'
+#define MAX_STAGES 4
 
 #define COMMAND_SIZE 128
 
@@ -29,37 +44,51 @@
 #define PHYSICAL_START 0x800000
 #define EXECUTE_START  0x8048000
 
-#define VIDEOMEM    0xB8000
-
 #define PCB_MASK 0x00FFE000
 
+struct poll_table;
+
 typedef struct fileops {
     int32_t (*open) (const int8_t *filename);
     int32_t (*close) (int32_t fd);
     int32_t (*read) (int32_t fd, void *buf, int32_t nbytes);
     int32_t (*write) (int32_t fd, const void *buf, int32_t nbytes);
+    int32_t (*stat) (int32_t fd, stat_t *buf);
+    int32_t (*poll) (int32_t fd, struct poll_table *pt);    // POLLIN and so on
 } fileops_t;
 
 typedef struct file {
     int32_t inode;
+    int32_t type;
     int32_t flags;
     int32_t pos;
+    rofs_t *fs;         // Image a rofs file or directory was opened from
     fileops_t fileops;
+    uint32_t refcount;  // fds pointing at it, in every process
 } file_t;
 
 typedef struct pcb {
-    file_t files[MAX_FILES];
+    file_t **fds;                       // fd table, fd_inline until it grows
+    uint32_t num_fds;                   // Slots in fds
+    uint32_t fd_bitmap[FD_BITMAP_WORDS];    // Bit set for each fd in use
+    file_t *fd_inline[MAX_FILES];
     uint8_t pid;
     int8_t args[MAX_ARGS_LENGTH];
-    uint32_t esp;
+    uint32_t esp;           // Kernel stack saved while another pipeline stage runs
     uint32_t ebp;
+    uint32_t entry;         // First instruction of the program
+    uint32_t stage_next;    // Next stage of the pipeline, its own pid if none
+    uint32_t vidmapped;     // Pinned its terminal's screen with vidmap
+    uint32_t raw_tty;       // Put its terminal in raw mode
 
     uint32_t parent_pid;
     uint32_t parent_esp;
     uint32_t parent_ebp;
+
+    io_context_t io;    // Submission and completion ring, if any
 } pcb_t;
 
-uint8_t can_execute();
+uint8_t can_execute(uint32_t count);
 
 int32_t halt(uint8_t status);
 
@@ -81,6 +110,28 @@ int32_t set_handler(int32_t signum, void *handler_address);
 
 int32_t sigreturn();
 
+int32_t stat(const int8_t *filename, stat_t *buf);
+
+int32_t fstat(int32_t fd, stat_t *buf);
+
+int32_t create(const int8_t *filename);
+
+int32_t unlink(const int8_t *filename);
+
+int32_t truncate(const int8_t *filename, uint32_t length);
+
+int32_t pipe(int32_t *fds);
+
+int32_t sendfile(int32_t out_fd, int32_t in_fd, uint32_t *offset, int32_t count);
+
+int32_t dup(int32_t fd);
+
+int32_t dup2(int32_t fd, int32_t new_fd);
+
+int32_t ioctl(int32_t fd, uint32_t request, uint32_t arg);
+
+int32_t pipeline_yield();
+
 int32_t fail();
 
 pcb_t *create_pcb();
@@ -89,5 +140,11 @@ pcb_t *get_current_pcb();
 
 pcb_t *get_pcb(uint32_t pid);
 
+file_t *get_file(int32_t fd);
+
+uint8_t file_seekable(const file_t *f);
+
+uint32_t in_user_page(const void *ptr, uint32_t length);
+
 
 #endif
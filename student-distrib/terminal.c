@@ -9,8 +9,8 @@
 /* global variables */
 volatile terminal_t terminal[MAX_TERMINALS];
 volatile int term_num;
-volatile int term_cur;      // keep track of current terminal
-volatile uint8_t *key_buffer;
+volatile int term_cur = 1;  // keep track of current terminal, the first while booting
+static wait_queue_t input_wait[MAX_TERMINALS];  // woken when input arrives
 
 uint32_t esp_temp;
 uint32_t ebp_temp;
@@ -60,33 +60,35 @@ void init_terminals () {
     int32_t i;
     for (i = 0; i < MAX_TERMINALS ; i++){
         terminal[i].num = i+1;
+        terminal[i].raw = 0;
+        terminal[i].key_buffer_len = 0;
         terminal[i].key_buffer_pos = 0;
+        terminal[i].input_head = 0;
+        terminal[i].input_tail = 0;
+        terminal[i].input_lines = 0;
         terminal[i].pos_x = 0;
         terminal[i].pos_y = 0;
         terminal[i].esp = 0;
         terminal[i].ebp = 0;
         terminal[i].num_processes = 0;
         terminal[i].init = 0;
+        terminal[i].esc_state = ESC_NONE;
+        terminal[i].saved_x = 0;
+        terminal[i].saved_y = 0;
         for (j = 0; j < KEY_BUFFER_SIZE; j++){
             terminal[i].key_buffer[j] = '\0';
         }
     }
-    // map terminal to memory. each terminal has it's own memory
-    remapToPage(TERM_MEM, TERM_1_MEM, 1);
-    remapToPage(TERM_MEM, TERM_2_MEM, 2);
-    remapToPage(TERM_MEM, TERM_3_MEM, 3);
-    terminal[0].vid_mem = (uint8_t *)TERM_1_MEM;
-    terminal[1].vid_mem = (uint8_t *)TERM_2_MEM;
-    terminal[2].vid_mem = (uint8_t *)TERM_3_MEM;
-    // clear video memory and set terminal color
-    for(i = 0; i < NUM_ROWS*NUM_COLS; i++) {
-        *(uint8_t *)(TERM_1_MEM + (i << 1)) = ' ';
-        *(uint8_t *)(TERM_1_MEM + (i << 1) + 1) = ATTRIB_B;
-        *(uint8_t *)(TERM_2_MEM + (i << 1)) = ' ';
-        *(uint8_t *)(TERM_2_MEM + (i << 1) + 1) = ATTRIB_G;
-        *(uint8_t *)(TERM_3_MEM + (i << 1)) = ' ';
-        *(uint8_t *)(TERM_3_MEM + (i << 1) + 1) = ATTRIB_Y;
+    // each terminal draws in its own page of VGA memory, whether or not
+    // it is the one on screen
+    for (i = 0; i < MAX_TERMINALS; i++) {
+        terminal[i].vid_mem = (uint8_t *)(VIDEO + i * VIDEO_PAGE_SIZE);
     }
+    // clear video memory and set terminal color, the whole page since the
+    // screen scrolls down it
+    init_video_page(0, ATTRIB_B);
+    init_video_page(1, ATTRIB_G);
+    init_video_page(2, ATTRIB_Y);
     // start first terminals
     term_cur = 1;
     terminal_start(1);
@@ -111,14 +113,15 @@ int32_t switch_terminal(int term) {
     }
     
     if (terminal[term-1].init == 0){
-        if (!can_execute()) {
+        if (!can_execute(1)) {
             printf("\nPlease close processes before opening another teminal\n391OS> ");
             sti();
             return 0;
         }
     }
 
-    // Always save
+    // Always save. Interrupts stay off until show_terminal has the new
+    // page and position, so nothing draws in between.
     terminal_save(term_cur);
 
     // Update current term
@@ -135,6 +138,32 @@ int32_t switch_terminal(int term) {
     return 0;
 }
 
+/*
+ * show_terminal(int term)
+ *
+ * DESCRIPTION: puts a terminal on screen by pointing the VGA at its page,
+ *              nothing is copied. Output and the cursor go to that page
+ *              at the terminal's saved position from now on, and so does
+ *              a vidmap'd screen. The console is held until page and
+ *              position match, so the log is never drawn at the old
+ *              terminal's position on the new page.
+ *
+ * INPUTS:      term - which terminal to show
+ * OUTPUTS:     none
+ * SIDE EFFECTS: programs the CRTC start address and cursor
+ *
+*/
+static void show_terminal(int term)
+{
+    console_hold();
+    set_video_page(term - 1);
+    set_screen_pos(terminal[term-1].pos_x, terminal[term-1].pos_y);
+    show_video_page(term - 1);
+    update_cursor_loc(get_screen_x(),get_screen_y());
+    console_release();
+    remapVideoPage((uint32_t)terminal[term-1].vid_mem);
+}
+
 /*
  * terminal_start(int term)
  *
@@ -148,11 +177,7 @@ int32_t switch_terminal(int term) {
 int32_t terminal_start(int term)
 {
     terminal[term-1].init = 1;
-    key_buffer = terminal[term-1].key_buffer;
-    key_buffer_pos = terminal[term-1].key_buffer_pos;
-    set_screen_pos(terminal[term-1].pos_x, terminal[term-1].pos_y);
-    update_cursor_loc(get_screen_x(),get_screen_y());
-    memcpy((uint8_t *)VIDEO, (uint8_t *)terminal[term-1].vid_mem, 2*NUM_ROWS*NUM_COLS);
+    show_terminal(term);
     printf("    _      ____     ___    _       _        ___             ___    ____  \n");
     printf("   / \\    |  _ \\   / _ \\  | |     | |      / _ \\           / _ \\  / ___| \n");
     printf("  / _ \\   | |_) | | | | | | |     | |     | | | |         | | | | \\___ \\ \n");
@@ -171,7 +196,8 @@ int32_t terminal_start(int term)
  *
  * INPUTS:      term - which terminal to save
  * OUTPUTS:     0 on success, -1 on failure
- * SIDE EFFECTS: copies video memory to terminal memory, sets stackframe, tss.
+ * SIDE EFFECTS: sets stackframe, tss. The screen stays in the terminal's
+ *               page of video memory.
  *
 */
 int32_t terminal_save(int term){
@@ -181,10 +207,8 @@ int32_t terminal_save(int term){
     );
     terminal[term-1].esp = esp_temp;
     terminal[term-1].ebp = ebp_temp;
-    terminal[term-1].key_buffer_pos = key_buffer_pos;
     terminal[term-1].pos_x = get_screen_x();
     terminal[term-1].pos_y = get_screen_y();
-    memcpy((uint8_t *)terminal[term-1].vid_mem, (uint8_t *)VIDEO, 2*NUM_ROWS*NUM_COLS);
     return 0;
 }
 
@@ -195,7 +219,7 @@ int32_t terminal_save(int term){
  *
  * INPUTS:      term - which terminal to load
  * OUTPUTS:     0 on success, -1 on failure
- * SIDE EFFECTS: copies terminal memory to video memory, sets stackframe, tss.
+ * SIDE EFFECTS: displays the terminal's page, sets stackframe, tss.
  *
 */
 int32_t terminal_load(int term){
@@ -205,11 +229,7 @@ int32_t terminal_load(int term){
     tss.ss0 = KERNEL_DS;
     tss.esp0 = PHYSICAL_START - terminal[term-1].term_pid * EIGHT_KB_BLOCK - MAGIC_SIZE;
     remap(VIRTUAL_START, PHYSICAL_START + terminal[term-1].term_pid * FOUR_MB_BLOCK);
-    key_buffer = terminal[term-1].key_buffer;
-    key_buffer_pos = terminal[term-1].key_buffer_pos;
-    set_screen_pos(terminal[term-1].pos_x, terminal[term-1].pos_y);
-    update_cursor_loc(get_screen_x(),get_screen_y());
-    memcpy((uint8_t *)VIDEO, (uint8_t *)terminal[term-1].vid_mem, 2*NUM_ROWS*NUM_COLS);
+    show_terminal(term);
     
     asm volatile ("movl %0, %%esp \n\t"
         "movl %1, %%ebp \n\t"
@@ -222,6 +242,214 @@ int32_t terminal_load(int term){
 }
 
 
+/*
+ * queue_input(t, s, n)
+ *
+ * DESCRIPTION: adds bytes for terminal_read, all of them or none, so a
+ *              line or an escape sequence is never cut up
+ *
+ * INPUTS:       t - the terminal
+ *               s - the bytes
+ *               n - how many
+ * OUTPUTS:      0 on success, -1 if there is no room
+ * SIDE EFFECTS: none
+ *
+ */
+static int32_t queue_input(volatile terminal_t *t, const volatile uint8_t *s, uint32_t n) {
+    uint32_t tail = t->input_tail;
+    uint32_t i;
+
+    if (n > TERM_INPUT_SIZE - (tail - t->input_head)) {
+        return -1;
+    }
+
+    for (i = 0; i < n; i++) {
+        t->input[(tail + i) & (TERM_INPUT_SIZE - 1)] = s[i];
+        if (s[i] == '\n') {
+            t->input_lines++;
+        }
+    }
+
+    // The reader only looks at what is below input_tail
+    t->input_tail = tail + n;
+    wake_up(&input_wait[t->num - 1]);
+    return 0;
+}
+
+/*
+ * move_cursor(delta)
+ *
+ * DESCRIPTION: moves the cursor forward or back through the line, which
+ *              can wrap onto the next row
+ *
+ * INPUTS:       delta - cells to move, negative to go back
+ * OUTPUTS:      none
+ * SIDE EFFECTS: moves the screen position and the cursor
+ *
+ */
+static void move_cursor(int delta) {
+    int pos = get_screen_y() * NUM_COLS + get_screen_x() + delta;
+
+    if (pos < 0) {
+        pos = 0;
+    } else if (pos >= NUM_ROWS * NUM_COLS) {
+        pos = NUM_ROWS * NUM_COLS - 1;
+    }
+
+    set_screen_pos(pos % NUM_COLS, pos / NUM_COLS);
+    update_cursor_loc(pos % NUM_COLS, pos / NUM_COLS);
+}
+
+/*
+ * echo_tail(t, erase)
+ *
+ * DESCRIPTION: redraws the line from the cursor to its end after an edit,
+ *              blanking cells it no longer reaches, and puts the cursor
+ *              back
+ *
+ * INPUTS:       t - the terminal
+ *               erase - cells past the end to blank
+ * OUTPUTS:      none
+ * SIDE EFFECTS: draws on the screen
+ *
+ */
+static void echo_tail(volatile terminal_t *t, uint32_t erase) {
+    uint32_t n = t->key_buffer_len - t->key_buffer_pos;
+
+    putn((uint8_t *) &t->key_buffer[t->key_buffer_pos], n);
+    while (erase-- > 0) {
+        putn((uint8_t *) " ", 1);
+        n++;
+    }
+    move_cursor(-n);
+}
+
+/*
+ * canon_input(t, key)
+ *
+ * DESCRIPTION: edits the line being typed: characters go in at the
+ *              cursor, backspace takes out the one before it, left and
+ *              right move it, ctrl+l clears the screen and the line, and
+ *              enter hands the line with a '\n' to terminal_read. A line
+ *              that does not fit in what is waiting to be read stays to be
+ *              entered again.
+ *
+ * INPUTS:       t - the terminal
+ *               key - a character or TERM_KEY_*
+ * OUTPUTS:      none
+ * SIDE EFFECTS: echoes on the screen
+ *
+ */
+static void canon_input(volatile terminal_t *t, uint32_t key) {
+    uint32_t pos = t->key_buffer_pos;
+    uint32_t len = t->key_buffer_len;
+
+    switch (key) {
+        case '\n':
+            t->key_buffer[len] = '\n';
+            if (queue_input(t, t->key_buffer, len + 1)) {
+                return;
+            }
+            move_cursor(len - pos);
+            putn((uint8_t *) "\n", 1);
+            t->key_buffer_len = 0;
+            t->key_buffer_pos = 0;
+            break;
+        case '\b':
+            if (pos == 0) {
+                return;
+            }
+            memmove((uint8_t *) &t->key_buffer[pos - 1], (uint8_t *) &t->key_buffer[pos], len - pos);
+            t->key_buffer_len--;
+            t->key_buffer_pos--;
+            move_cursor(-1);
+            echo_tail(t, 1);
+            break;
+        case TERM_KEY_LEFT:
+            if (pos > 0) {
+                t->key_buffer_pos--;
+                move_cursor(-1);
+            }
+            break;
+        case TERM_KEY_RIGHT:
+            if (pos < len) {
+                t->key_buffer_pos++;
+                move_cursor(1);
+            }
+            break;
+        case 'l' & CTRL_MASK:
+            clear();
+            t->key_buffer_len = 0;
+            t->key_buffer_pos = 0;
+            break;
+        default:
+            // Room is kept for the '\n'
+            if (key < ' ' || key > '~' || len >= KEY_BUFFER_SIZE - 1) {
+                return;
+            }
+            memmove((uint8_t *) &t->key_buffer[pos + 1], (uint8_t *) &t->key_buffer[pos], len - pos);
+            t->key_buffer[pos] = key;
+            t->key_buffer_len++;
+            echo_tail(t, 0);
+            t->key_buffer_pos++;
+            move_cursor(1);
+            break;
+    }
+}
+
+/*
+ * terminal_input(key)
+ *
+ * DESCRIPTION: runs a key through the foreground terminal's line
+ *              discipline. Raw mode passes characters on as they are,
+ *              enter as '\n', backspace as '\b' and arrows as ESC [ A
+ *              to ESC [ D, dropping any that do not fit.
+ *
+ * INPUTS:       key - a character or TERM_KEY_*
+ * OUTPUTS:      none
+ * SIDE EFFECTS: see canon_input
+ *
+ */
+void terminal_input(uint32_t key) {
+    volatile terminal_t *t = &terminal[term_cur - 1];
+    uint8_t seq[3] = {ESC, '['};
+
+    if (!t->raw) {
+        canon_input(t, key);
+    } else if (key >= TERM_KEY_UP) {
+        seq[2] = 'A' + key - TERM_KEY_UP;
+        queue_input(t, seq, 3);
+    } else {
+        seq[0] = key;
+        queue_input(t, seq, 1);
+    }
+}
+
+/*
+ * terminal_set_raw(raw)
+ *
+ * DESCRIPTION: switches the foreground terminal between canonical and raw
+ *              mode. Whatever was typed of a line goes to terminal_read
+ *              as it is when raw mode starts.
+ *
+ * INPUTS:       raw - 1 for raw mode, 0 for canonical
+ * OUTPUTS:      none
+ * SIDE EFFECTS: none
+ *
+ */
+void terminal_set_raw(uint32_t raw) {
+    volatile terminal_t *t = &terminal[term_cur - 1];
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (raw && !t->raw && !queue_input(t, t->key_buffer, t->key_buffer_len)) {
+        t->key_buffer_len = 0;
+        t->key_buffer_pos = 0;
+    }
+    t->raw = raw != 0;
+    restore_flags(flags);
+}
+
 /*
  * terminal_read()
  *
@@ -230,33 +458,265 @@ int32_t terminal_load(int term){
  * INPUTS:       fd - file descriptor
  *               buf - keyboard buffer to be read
  *               nbytes - number of bytes to read
- * OUTPUTS:      number of bytes read
- * SIDE EFFECTS: returns data from one line that has been
- *               terminated by pressing enter or as much fits
- *               on one line.
+ * OUTPUTS:      number of bytes read, 0 if the file is nonblocking and
+ *               nothing is ready
+ * SIDE EFFECTS: waits for a line ended by enter, in raw mode for any
+ *               key, then returns that line, including the '\n', or as
+ *               much of it as fits; the rest is left for the next read.
+ *               In raw mode it returns everything waiting that fits.
  *
  */
 int32_t terminal_read (int32_t fd, void *buf, int32_t nbytes) {
-    while (!enter_pressed) {
-        // Wait
+    volatile terminal_t *t = &terminal[term_cur - 1];
+    uint8_t *byte_buf = (uint8_t *) buf;
+    int32_t bytes_read = 0;
+    uint32_t flags;
+    uint8_t c;
+
+    if (nbytes <= 0) {
+        return 0;
     }
 
-    enter_pressed = 0;
+    while (!terminal_ready()) {
+        if (get_file(fd)->flags & FILE_NONBLOCK) {
+            return 0;
+        }
+        asm volatile ("sti; hlt" : : : "memory");
+    }
 
-    int8_t *byte_buf = (int8_t *) buf;
+    while (bytes_read < nbytes && t->input_head != t->input_tail) {
+        c = t->input[t->input_head & (TERM_INPUT_SIZE - 1)];
+        t->input_head++;
+        byte_buf[bytes_read++] = c;
+        if (c == '\n') {
+            cli_and_save(flags);
+            t->input_lines--;
+            restore_flags(flags);
+            if (!t->raw) {
+                break;
+            }
+        }
+    }
 
-    int32_t bytes_read = 0;
-    int32_t i = 0;
-    // copy key_buffer
-    while (key_buffer[i] != '\0' && i < nbytes){
-      byte_buf[i] = key_buffer[i];
-      bytes_read++;
-      i++;
+    return bytes_read;
+}
+
+/*
+ * terminal_ready()
+ *
+ * DESCRIPTION: checks for a finished line, or in raw mode any key
+ *
+ * INPUTS:       none
+ * OUTPUTS:      1 if terminal_read would return without waiting
+ * SIDE EFFECTS: none
+ *
+ */
+int32_t terminal_ready () {
+    volatile terminal_t *t = &terminal[term_cur - 1];
+    return t->raw ? t->input_head != t->input_tail : t->input_lines != 0;
+}
+
+/*
+ * terminal_poll()
+ *
+ * DESCRIPTION: readiness callback for stdin, woken when a line or in raw
+ *              mode a key arrives
+ *
+ * INPUTS:       fd - ignored
+ *               pt - the poll call's table
+ * OUTPUTS:      POLLIN if terminal_read would return without waiting
+ * SIDE EFFECTS: none
+ *
+ */
+int32_t terminal_poll (int32_t fd, poll_table_t *pt) {
+    poll_wait(pt, &input_wait[term_cur - 1]);
+    return terminal_ready() ? POLLIN : 0;
+}
+
+/* ANSI color numbers to VGA ones, which have red and blue swapped */
+static uint8_t ansi_colors[8] = {0, 4, 2, 6, 1, 5, 3, 7};
+
+/*
+ * csi_param(t, i)
+ *
+ * DESCRIPTION: gets a parameter of the escape sequence just parsed
+ *
+ * INPUTS:       t - the terminal
+ *               i - which parameter
+ * OUTPUTS:      its value, 0 if it was left out
+ * SIDE EFFECTS: none
+ *
+ */
+static uint32_t csi_param(volatile terminal_t *t, uint32_t i) {
+    return i < t->esc_nparams ? t->esc_params[i] : 0;
+}
+
+/*
+ * csi_sgr(t)
+ *
+ * DESCRIPTION: sets colors for ESC [ ... m: 0 resets, 1 and 22 turn
+ *              bright text on and off, 30-37 and 40-47 pick the text and
+ *              background colors, 39 and 49 go back to the terminal's
+ *              own, 90-97 are bright text colors
+ *
+ * INPUTS:       t - the terminal
+ * OUTPUTS:      none
+ * SIDE EFFECTS: changes how text is drawn from now on
+ *
+ */
+static void csi_sgr(volatile terminal_t *t) {
+    uint8_t attrib = get_text_attrib();
+    uint8_t def = get_default_attrib();
+    uint32_t i = 0;
+
+    do {
+        uint32_t p = csi_param(t, i);
+        if (p == 0) {
+            attrib = def;
+        } else if (p == 1) {
+            attrib |= 0x08;
+        } else if (p == 22) {
+            attrib &= ~0x08;
+        } else if (p >= 30 && p <= 37) {
+            attrib = (attrib & 0xF8) | ansi_colors[p - 30];
+        } else if (p == 39) {
+            attrib = (attrib & 0xF0) | (def & 0x0F);
+        } else if (p >= 40 && p <= 47) {
+            // the top bit would blink, so backgrounds stay dark
+            attrib = (attrib & 0x0F) | (ansi_colors[p - 40] << 4);
+        } else if (p == 49) {
+            attrib = (attrib & 0x0F) | (def & 0xF0);
+        } else if (p >= 90 && p <= 97) {
+            attrib = (attrib & 0xF0) | 0x08 | ansi_colors[p - 90];
+        }
+    } while (++i < t->esc_nparams);
+
+    set_text_attrib(attrib);
+}
+
+/*
+ * csi_dispatch(t, final)
+ *
+ * DESCRIPTION: carries out an ESC [ sequence once its final byte is in.
+ *              Supported are cursor moves (A B C D G d H f), erasing the
+ *              screen (J) or line (K), colors (m), and saving and
+ *              restoring the cursor (s u). Others are ignored.
+ *
+ * INPUTS:       t - the terminal
+ *               final - the letter ending the sequence
+ * OUTPUTS:      none
+ * SIDE EFFECTS: moves the cursor position, changes the screen
+ *
+ */
+static void csi_dispatch(volatile terminal_t *t, uint8_t final) {
+    int x = get_screen_x();
+    int y = get_screen_y();
+    int n = csi_param(t, 0) ? csi_param(t, 0) : 1;
+    int pos = NUM_COLS * y + x;
+    int line = NUM_COLS * y;
+
+    switch (final) {
+        case 'A': y -= n; break;
+        case 'B': y += n; break;
+        case 'C': x += n; break;
+        case 'D': x -= n; break;
+        case 'G': x = n - 1; break;
+        case 'd': y = n - 1; break;
+        case 'H':
+        case 'f':
+            y = n - 1;
+            x = (csi_param(t, 1) ? csi_param(t, 1) : 1) - 1;
+            break;
+        case 'J':
+            if (csi_param(t, 0) == 0) {
+                erase_cells(pos, NUM_ROWS * NUM_COLS);
+            } else if (csi_param(t, 0) == 1) {
+                erase_cells(0, pos + 1);
+            } else {
+                erase_cells(0, NUM_ROWS * NUM_COLS);
+            }
+            return;
+        case 'K':
+            if (csi_param(t, 0) == 0) {
+                erase_cells(pos, line + NUM_COLS);
+            } else if (csi_param(t, 0) == 1) {
+                erase_cells(line, pos + 1);
+            } else {
+                erase_cells(line, line + NUM_COLS);
+            }
+            return;
+        case 'm':
+            csi_sgr(t);
+            return;
+        case 's':
+            t->saved_x = x;
+            t->saved_y = y;
+            return;
+        case 'u':
+            x = t->saved_x;
+            y = t->saved_y;
+            break;
+        default:
+            return;
     }
 
-    clear_buffer();
+    // the cursor stays on screen
+    x = x < 0 ? 0 : (x >= NUM_COLS ? NUM_COLS - 1 : x);
+    y = y < 0 ? 0 : (y >= NUM_ROWS ? NUM_ROWS - 1 : y);
+    set_screen_pos(x, y);
+}
 
-    return bytes_read;
+/*
+ * escape_byte(t, c)
+ *
+ * DESCRIPTION: feeds one byte of an escape sequence to the parser. Only
+ *              ESC [ sequences do anything; anything else after ESC, or
+ *              a control character inside a sequence, ends it. Another
+ *              ESC drops the sequence so far and starts a new one.
+ *
+ * INPUTS:       t - the terminal
+ *               c - the byte
+ * OUTPUTS:      none
+ * SIDE EFFECTS: runs the sequence once it is complete
+ *
+ */
+static void escape_byte(volatile terminal_t *t, uint8_t c) {
+    if (c == ESC) {
+        t->esc_state = ESC_START;
+    } else if (t->esc_state == ESC_START) {
+        if (c == '[') {
+            t->esc_state = ESC_CSI;
+            t->esc_private = 0;
+            t->esc_nparams = 0;
+            t->esc_params[0] = 0;
+        } else {
+            t->esc_state = ESC_NONE;
+        }
+    } else if (c >= '0' && c <= '9') {
+        if (t->esc_nparams == 0) {
+            t->esc_nparams = 1;
+        }
+        if (t->esc_params[t->esc_nparams - 1] < 10000) {
+            t->esc_params[t->esc_nparams - 1] = t->esc_params[t->esc_nparams - 1] * 10 + c - '0';
+        }
+    } else if (c == ';') {
+        if (t->esc_nparams == 0) {
+            t->esc_nparams = 1;
+        }
+        if (t->esc_nparams < ESC_MAX_PARAMS) {
+            t->esc_params[t->esc_nparams++] = 0;
+        }
+    } else if (c >= '<' && c <= '?') {
+        t->esc_private = 1;
+    } else if (c >= 0x40 && c <= 0x7E) {
+        t->esc_state = ESC_NONE;
+        if (!t->esc_private) {
+            csi_dispatch(t, c);
+        }
+    } else if (c < 0x20 || c > 0x2F) {
+        // not an intermediate byte either, give up on the sequence
+        t->esc_state = ESC_NONE;
+    }
 }
 
 /*
@@ -268,23 +728,37 @@ int32_t terminal_read (int32_t fd, void *buf, int32_t nbytes) {
  *               buf - keyboard buffer to write
  *               nbytes - number of bytes to written
  * OUTPUTS:      number of bytes written
- * SIDE EFFECTS: data displayed to screen immediately.
+ * SIDE EFFECTS: data displayed to screen immediately, plain text a run at
+ *               a time. ANSI escape sequences move the cursor, erase and
+ *               set colors, so a program can change only some cells.
+ *               The cursor is updated once at the end. The console is
+ *               held throughout, so the log and key echo wait for it.
  *
  */
 int32_t terminal_write(int32_t fd, const void *buf, int32_t nbytes) {
 
-    const int8_t *byte_buf = (int8_t *) buf;
+    const uint8_t *byte_buf = (uint8_t *) buf;
+    volatile terminal_t *t = &terminal[term_cur - 1];
 
-    int32_t i;
     int32_t bytes_written = 0;
-    for (i = 0; i < nbytes; i++){
-        if (byte_buf[i] != '\0'){
-            // write the char to the terminal
-            putc(byte_buf[i]);
-            bytes_written++;
-        } else {
-            break;
+    int32_t run = 0;    // start of the text not drawn yet
+
+    console_hold();
+    // stop at the first NUL
+    while (bytes_written < nbytes && byte_buf[bytes_written] != '\0'){
+        if (t->esc_state != ESC_NONE) {
+            escape_byte(t, byte_buf[bytes_written]);
+            run = bytes_written + 1;
+        } else if (byte_buf[bytes_written] == ESC) {
+            draw_text(byte_buf + run, bytes_written - run);
+            t->esc_state = ESC_START;
+            run = bytes_written + 1;
         }
+        bytes_written++;
     }
+
+    draw_text(byte_buf + run, bytes_written - run);
+    update_cursor_loc(get_screen_x(), get_screen_y());
+    console_release();
     return bytes_written;
 }
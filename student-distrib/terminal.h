@@ -3,13 +3,10 @@
 
 #include "types.h"
 #include "keyboard.h"
+#include "poll.h"
 #include "syscalls.h"
 
 #define MAX_TERMINALS 	3
-#define TERM_MEM 		0x6400000		// 100MB
-#define TERM_1_MEM 		0x6401000		// 100MB+4KB
-#define TERM_2_MEM 		0x6402000		// 100MB+2*4KB
-#define TERM_3_MEM 		0x6403000		// 100MB+3*4KB
 #define KEY_BUFFER_SIZE 128
 #define VIDEO 			0xB8000
 #define NUM_COLS 		80
@@ -18,13 +15,36 @@
 #define ATTRIB_Y 		0xE
 #define ATTRIB_B 		0xB
 #define CMD_HIST_MAX		10
+#define ESC 			0x1B
+#define ESC_MAX_PARAMS	8
+// where terminal_write is in an escape sequence
+#define ESC_NONE		0
+#define ESC_START		1	// just had ESC
+#define ESC_CSI			2	// in ESC [ ... up to the final byte
+// keys that are not characters, passed to terminal_input
+#define TERM_KEY_UP		0x100
+#define TERM_KEY_DOWN	0x101
+#define TERM_KEY_RIGHT	0x102
+#define TERM_KEY_LEFT	0x103
+// bytes waiting for read(), a power of two
+#define TERM_INPUT_SIZE	1024
 
 
 typedef struct {
 
 	uint8_t num;	// which of the three terminals
+
+	// line discipline: in canonical mode keys are echoed and edited in
+	// key_buffer, and a finished line goes into input; in raw mode each
+	// key goes straight into input without echo
+	uint8_t raw;
 	uint8_t key_buffer[KEY_BUFFER_SIZE];
-	uint32_t key_buffer_pos;
+	uint32_t key_buffer_len;
+	uint32_t key_buffer_pos;	// where the cursor is in the line
+	uint8_t input[TERM_INPUT_SIZE];
+	uint32_t input_head;	// moved only by terminal_read
+	uint32_t input_tail;	// moved only by the keyboard
+	uint32_t input_lines;	// '\n's in input
 
 	// cursor x,y location
 	int pos_x;
@@ -36,18 +56,25 @@ typedef struct {
 
 	uint8_t term_pid;
 
-	uint8_t *vid_mem;	// pointer to video memory for terminal
+	uint8_t *vid_mem;	// the terminal's own page of VGA memory
 
 	int num_processes;
 
 	int init;	// has the terminal been launched? yes(1), no(0)
 
+	// escape sequence being parsed, which can span writes
+	uint8_t esc_state;
+	uint8_t esc_private;	// ESC [ ? ..., none of which are supported
+	uint32_t esc_nparams;
+	uint32_t esc_params[ESC_MAX_PARAMS];
+	// cursor kept by ESC [ s for ESC [ u
+	int saved_x;
+	int saved_y;
+
 } terminal_t;
 
 extern volatile terminal_t terminal[MAX_TERMINALS];
 extern volatile int term_cur;
-/* key buffer */
-extern volatile uint8_t *key_buffer;
 
 /* terminal driver system calls */
 extern int32_t terminal_open(const int8_t *filename);
@@ -58,6 +85,10 @@ extern int32_t terminal_start(int term);
 extern int32_t terminal_save(int term);
 extern int32_t terminal_load(int term);
 extern int32_t terminal_read (int32_t fd, void *buf, int32_t nbytes);
+extern int32_t terminal_ready ();
+extern int32_t terminal_poll (int32_t fd, poll_table_t *pt);
+extern void terminal_input (uint32_t key);
+extern void terminal_set_raw (uint32_t raw);
 extern int32_t terminal_write (int32_t fd, const void *buf, int32_t nbytes);
 
 #endif
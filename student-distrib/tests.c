@@ -1,5 +1,922 @@
 #include "tests.h"
 
+#include "ata.h"
+#include "bcache.h"
+#include "crc32c.h"
 #include "keyboard.h"
 #include "lib.h"
+#include "mount.h"
+#include "paging.h"
+#include "pipe.h"
+#include "pit.h"
+#include "printk.h"
+#include "ramdisk.h"
 #include "rofs.h"
+#include "serial.h"
+#include "syscalls.h"
+#include "terminal.h"
+
+static uint8_t bench_buf[BENCH_CHUNK];
+static uint32_t bench_seed = 1;
+
+// Paths of files picked for the lookup benchmark
+static int8_t bench_paths[BENCH_PATHS][BENCH_PATH_LENGTH];
+static uint32_t num_bench_paths;
+
+/*
+ * print_rate(what, bytes, ms)
+ *
+ * DESCRIPTION: Prints a throughput as MB/s with one decimal place
+ *
+ * INPUTS: 	what - label for the measurement
+ *          bytes - bytes moved
+ *          ms - milliseconds it took
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints to the screen
+ *
+ */
+static void print_rate(int8_t *what, uint32_t bytes, uint32_t ms) {
+    uint32_t kb_per_s = ms ? (bytes >> 10) * 1000 / ms : 0;
+    printf("  %s: %u.%u MB/s\n", what, kb_per_s >> 10, ((kb_per_s & 0x3FF) * 10) >> 10);
+}
+
+/*
+ * print_hit_rate(what, hits, misses)
+ *
+ * DESCRIPTION: Prints a cache hit rate as a percentage
+ *
+ * INPUTS: 	what - label for the cache
+ *          hits - lookups that hit
+ *          misses - lookups that missed
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints to the screen
+ */
+static void print_hit_rate(int8_t *what, uint32_t hits, uint32_t misses) {
+    uint32_t lookups = hits + misses;
+    // Keep hits * 100 from overflowing
+    while (lookups > 0xFFFFFF) {
+        hits >>= 1;
+        lookups >>= 1;
+    }
+    printf("  %s hit rate: %u%%\n", what, lookups ? hits * 100 / lookups : 0);
+}
+
+/*
+ * bench_random()
+ *
+ * DESCRIPTION: Small linear congruential generator, the same sequence
+ *              every boot so runs compare
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * RETURNS: a pseudo random number below 2^24
+ * SIDE EFFECTS: advances the seed
+ */
+static uint32_t bench_random(void) {
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return bench_seed >> 8;
+}
+
+/*
+ * bench_read_all(fs, chunk)
+ *
+ * DESCRIPTION: Reads every regular file in an image front to back in
+ *              chunk sized pieces
+ *
+ * INPUTS: 	fs - the image
+ *          chunk - bytes per read, at most BENCH_CHUNK
+ * OUTPUTS: none
+ *
+ * RETURNS: bytes read
+ * SIDE EFFECTS: none
+ */
+static uint32_t bench_read_all(rofs_t *fs, uint32_t chunk) {
+    dentry_t dentry;
+    uint32_t total = 0;
+    uint32_t i;
+    for (i = 0; read_dentry_by_index(fs, i, &dentry) == 0; i++) {
+        if (dentry.file_type != file) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        int32_t bytes;
+        while ((bytes = read_data(fs, dentry.inode_num, offset, bench_buf, chunk)) > 0) {
+            offset += bytes;
+        }
+        total += offset;
+    }
+    return total;
+}
+
+/*
+ * bench_load_all(fs, loads)
+ *
+ * DESCRIPTION: Loads every executable in an image to the program start
+ *              the same way execute() does
+ *
+ * INPUTS: 	fs - the image
+ * OUTPUTS: loads - number of programs loaded
+ *
+ * RETURNS: bytes loaded
+ * SIDE EFFECTS: Overwrites the program image of pid 0
+ */
+static uint32_t bench_load_all(rofs_t *fs, uint32_t *loads) {
+    dentry_t dentry;
+    uint8_t magic[MAGIC_SIZE];
+    uint32_t total = 0;
+    uint32_t i;
+    for (i = 0; read_dentry_by_index(fs, i, &dentry) == 0; i++) {
+        if (dentry.file_type != file
+            || read_data(fs, dentry.inode_num, 0, magic, MAGIC_SIZE) != MAGIC_SIZE
+            || magic[0] != MAGIC0 || magic[1] != MAGIC1
+            || magic[2] != MAGIC2 || magic[3] != MAGIC3) {
+            continue;
+        }
+
+        int32_t bytes = read_data(fs, dentry.inode_num, 0, (uint8_t *) EXECUTE_START,
+            VIRTUAL_END - EXECUTE_START);
+        if (bytes > 0) {
+            total += bytes;
+            (*loads)++;
+        }
+    }
+    return total;
+}
+
+/*
+ * walk_files(fs, dir_inode, path, length, depth, seen, stride)
+ *
+ * DESCRIPTION: Visits every regular file below a directory, remembering
+ *              the path of every stride'th one in bench_paths
+ *
+ * INPUTS: 	fs - the image, with directories
+ *          dir_inode - directory to walk
+ *          path - buffer holding the directory's path
+ *          length - characters of path in use
+ *          depth - how deep the directory is
+ *          stride - keep one path in this many, 0 to only count
+ * OUTPUTS: seen - count of files visited so far
+ *
+ * SIDE EFFECTS: fills bench_paths
+ */
+static void walk_files(rofs_t *fs, uint32_t dir_inode, int8_t *path, uint32_t length,
+                       uint32_t depth, uint32_t *seen, uint32_t stride) {
+    dentry_t dentry;
+    uint32_t i;
+
+    for (i = 0; read_dir_entry(fs, dir_inode, i, &dentry) == 0; i++) {
+        uint32_t name_length = strlen(dentry.file_name);
+        if (name_length > FILE_NAME_LENGTH) {
+            name_length = FILE_NAME_LENGTH;
+        }
+
+        if (!strncmp(dentry.file_name, ".", 2) || !strncmp(dentry.file_name, "..", 3)
+            || length + name_length + 2 > BENCH_PATH_LENGTH) {
+            continue;
+        }
+
+        memcpy(path + length, dentry.file_name, name_length);
+        path[length + name_length] = '\0';
+
+        if (dentry.file_type == dir && depth < BENCH_MAX_DEPTH) {
+            path[length + name_length] = '/';
+            walk_files(fs, dentry.inode_num, path, length + name_length + 1, depth + 1, seen, stride);
+        } else if (dentry.file_type == file) {
+            if (stride && *seen % stride == 0 && num_bench_paths < BENCH_PATHS) {
+                strcpy(bench_paths[num_bench_paths++], path);
+            }
+            (*seen)++;
+        }
+    }
+}
+
+/*
+ * bench_lookup(fs)
+ *
+ * DESCRIPTION: Times read_dentry_by_name on files spread evenly over the
+ *              whole image, full paths included for images with
+ *              directories
+ *
+ * INPUTS: 	fs - the image
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results
+ */
+static void bench_lookup(rofs_t *fs) {
+    int8_t path[BENCH_PATH_LENGTH];
+    dentry_t dentry;
+    uint32_t files = 0;
+    uint32_t i;
+
+    num_bench_paths = 0;
+    if (fs->root_inode == DIR_END) {
+        for (i = 0; read_dentry_by_index(fs, i, &dentry) == 0 && num_bench_paths < BENCH_PATHS; i++) {
+            if (dentry.file_type == file) {
+                strncpy(bench_paths[num_bench_paths], dentry.file_name, FILE_NAME_LENGTH);
+                bench_paths[num_bench_paths++][FILE_NAME_LENGTH] = '\0';
+                files++;
+            }
+        }
+    } else {
+        walk_files(fs, fs->root_inode, path, 0, 0, &files, 0);
+        uint32_t seen = 0;
+        walk_files(fs, fs->root_inode, path, 0, 0, &seen, files / BENCH_PATHS + 1);
+    }
+
+    if (num_bench_paths == 0) {
+        return;
+    }
+
+    uint32_t lookups = 0;
+    uint32_t start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        for (i = 0; i < num_bench_paths; i++) {
+            if (read_dentry_by_name(fs, bench_paths[i], &dentry) == 0) {
+                lookups++;
+            }
+        }
+    }
+
+    uint32_t ms = pit_ticks - start;
+    printf("  %u files, lookups: %u per second (%s)\n", files, lookups * 1000 / ms,
+        fs->root_inode == DIR_END ? "flat" : "directories");
+}
+
+/*
+ * bench_crc32c()
+ *
+ * DESCRIPTION: Measures how fast each CRC32C implementation checksums
+ *              4KB blocks, the size rofs verifies
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results, needs the PIT running
+ */
+static void bench_crc32c(void) {
+    volatile uint32_t crc = 0;
+    uint32_t bytes = 0;
+    uint32_t start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        crc = crc32c_slice8(crc, bench_buf, BLOCK_SIZE);
+        bytes += BLOCK_SIZE;
+    }
+    print_rate("crc32c slice-by-8", bytes, pit_ticks - start);
+
+    if (!crc32c_has_sse42()) {
+        printf("  crc32c sse4.2: not supported\n");
+        return;
+    }
+
+    bytes = 0;
+    start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        crc = crc32c_sse42(crc, bench_buf, BLOCK_SIZE);
+        bytes += BLOCK_SIZE;
+    }
+    print_rate("crc32c sse4.2", bytes, pit_ticks - start);
+}
+
+/*
+ * bench_rofs()
+ *
+ * DESCRIPTION: Goes through each mounted image in turn and measures
+ *              sequential read and program load throughput and name
+ *              lookup speed, so a version 1 and a version 2 image of the
+ *              same files can be compared side by side.
+ *              For compressed images the ratio and the block cache hit
+ *              rate are reported too, and checksummed images are also
+ *              read with every block verified, next to the raw CRC32C
+ *              speed.
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results, needs paging, the PIT and the mounts
+ */
+void bench_rofs(void) {
+    mount_t *mount;
+    uint32_t i;
+
+    // Programs get loaded where pid 0 would run
+    remap(VIRTUAL_START, PHYSICAL_START);
+
+    bench_crc32c();
+
+    for (i = 0; i < MAX_MOUNTS; i++) {
+        mount = get_mount(i);
+        if (mount == NULL || mount->type != MOUNT_ROFS) {
+            continue;
+        }
+
+        rofs_t *fs = &mount->rofs;
+        printf("/%s: rofs version %d\n", mount->name, rofs_version(fs));
+
+        uint32_t bytes = 0;
+        uint32_t start = pit_ticks;
+        while (pit_ticks - start < BENCH_MS) {
+            bytes += bench_read_all(fs, BENCH_CHUNK);
+        }
+        print_rate("sequential read", bytes, pit_ticks - start);
+
+        bytes = 0;
+        start = pit_ticks;
+        while (pit_ticks - start < BENCH_MS) {
+            bytes += bench_read_all(fs, BENCH_SMALL_CHUNK);
+        }
+        print_rate("1KB reads", bytes, pit_ticks - start);
+
+        uint32_t loads = 0;
+        bytes = 0;
+        start = pit_ticks;
+        while (pit_ticks - start < BENCH_MS) {
+            bytes += bench_load_all(fs, &loads);
+        }
+        print_rate("exec load", bytes, pit_ticks - start);
+        printf("  exec loads: %u per second\n", loads * 1000 / (pit_ticks - start));
+
+        bench_lookup(fs);
+
+        if (fs->checksums != NULL) {
+            // Every pass starts cold, so each block read is verified again
+            bytes = 0;
+            start = pit_ticks;
+            while (pit_ticks - start < BENCH_MS) {
+                rofs_forget_verified(fs);
+                bytes += bench_read_all(fs, BENCH_CHUNK);
+            }
+            print_rate("verifying read", bytes, pit_ticks - start);
+        }
+
+        rofs_stats_t stats;
+        rofs_get_stats(fs, &stats);
+        if (stats.stored_bytes < stats.logical_bytes) {
+            printf("  compression: %u -> %u bytes (%u%%)\n", stats.logical_bytes,
+                stats.stored_bytes, stats.stored_bytes * 100 / stats.logical_bytes);
+            print_hit_rate("block cache", stats.cache_hits, stats.cache_misses);
+        }
+    }
+}
+
+/*
+ * bench_cached_reads(dev, what, range)
+ *
+ * DESCRIPTION: Reads random buffers of a device through the buffer
+ *              cache and reports the speed and hit rate
+ *
+ * INPUTS: 	dev - the device
+ *          what - label for the pattern
+ *          range - buffers to pick from, starting at 0
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results
+ */
+static void bench_cached_reads(block_device_t *dev, int8_t *what, uint32_t range) {
+    bcache_stats_t before, after;
+    uint32_t bytes = 0;
+
+    bcache_get_stats(&before);
+    uint32_t start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        buffer_t *b = bread(dev, bench_random() % range);
+        if (b == NULL) {
+            printf("  %s: read failed\n", what);
+            return;
+        }
+        memcpy(bench_buf, b->data, BUFFER_SIZE);
+        brelse(b);
+        bytes += BUFFER_SIZE;
+    }
+    print_rate(what, bytes, pit_ticks - start);
+
+    bcache_get_stats(&after);
+    print_hit_rate(what, after.hits - before.hits, after.misses - before.misses);
+}
+
+/*
+ * bench_block()
+ *
+ * DESCRIPTION: Measures the ramdisk on its own and through the buffer
+ *              cache: raw reads, write-back of the whole device, then
+ *              random reads that fit in the cache and ones that do not,
+ *              so the hit rate shows what the cache buys apart from the
+ *              speed of the medium
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results, overwrites the ramdisk
+ */
+void bench_block(void) {
+    block_device_t *dev = find_block_device(RAMDISK_NAME);
+    bcache_stats_t before, after;
+    uint32_t b;
+
+    if (dev == NULL) {
+        return;
+    }
+
+    uint32_t per_buffer = BUFFER_SIZE / dev->block_size;
+    uint32_t buffers = dev->num_blocks / per_buffer;
+    printf("%s: %u KB, %u buffer cache\n", dev->name, buffers * (BUFFER_SIZE >> 10), NUM_BUFFERS);
+
+    uint32_t bytes = 0;
+    uint32_t start = pit_ticks;
+    for (b = 0; pit_ticks - start < BENCH_MS; b = (b + 1) % buffers) {
+        if (block_transfer(dev, b * per_buffer, per_buffer, bench_buf, 0)) {
+            printf("  raw read failed\n");
+            return;
+        }
+        bytes += BUFFER_SIZE;
+    }
+    print_rate("raw read", bytes, pit_ticks - start);
+
+    bcache_invalidate(dev);
+    bcache_get_stats(&before);
+    bytes = 0;
+    start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        for (b = 0; b < buffers; b++) {
+            buffer_t *buf = bgrab(dev, b);
+            if (buf == NULL) {
+                printf("  cached write failed\n");
+                return;
+            }
+            memcpy(buf->data, bench_buf, BUFFER_SIZE);
+            bdirty(buf);
+            brelse(buf);
+        }
+        bcache_sync(dev);
+        bytes += buffers * BUFFER_SIZE;
+    }
+    print_rate("write-back", bytes, pit_ticks - start);
+    bcache_get_stats(&after);
+    printf("  buffers written back: %u\n", after.writebacks - before.writebacks);
+
+    bcache_invalidate(dev);
+    bench_cached_reads(dev, "hot random read", NUM_BUFFERS / 2);
+    bench_cached_reads(dev, "cold random read", buffers);
+}
+
+/*
+ * bench_raw_disk(dev, what, random, write)
+ *
+ * DESCRIPTION: Moves data straight to or from a drive, bypassing the
+ *              buffer cache: BENCH_CHUNK sized commands front to back, or
+ *              BUFFER_SIZE ones at random places
+ *
+ * INPUTS: 	dev - the drive
+ *          what - label for the pattern
+ *          random - 1 for random places
+ *          write - 1 to write, which destroys what is on the drive
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results
+ */
+static void bench_raw_disk(block_device_t *dev, int8_t *what, uint32_t random, uint32_t write) {
+    uint32_t per_chunk = (random ? BUFFER_SIZE : BENCH_CHUNK) / dev->block_size;
+    uint32_t chunks = dev->num_blocks / per_chunk;
+    uint32_t bytes = 0;
+    uint32_t c = 0;
+
+    if (chunks == 0) {
+        return;
+    }
+
+    uint32_t start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        if (random) {
+            c = bench_random() % chunks;
+        }
+        if (block_transfer(dev, c * per_chunk, per_chunk, bench_buf, write)) {
+            printf("  %s: failed at block %u\n", what, c * per_chunk);
+            return;
+        }
+        bytes += per_chunk * dev->block_size;
+        c = (c + 1) % chunks;
+    }
+    print_rate(what, bytes, pit_ticks - start);
+}
+
+/*
+ * bench_drive(dev)
+ *
+ * DESCRIPTION: Measures one IDE drive. Reads go sequentially, by DMA and
+ *              PIO when the drive has both, at random, and front to back
+ *              through the buffer cache where readahead keeps the drive
+ *              busy while the data is copied out. A drive whose first
+ *              sector has no boot signature is taken to be a scratch disk
+ *              and gets the sequential and random write passes too.
+ *
+ * INPUTS: 	dev - the drive
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results, overwrites scratch disks
+ */
+static void bench_drive(block_device_t *dev) {
+    uint32_t per_buffer = BUFFER_SIZE / dev->block_size;
+    uint32_t buffers = dev->num_blocks / per_buffer;
+    bcache_stats_t before, after;
+    uint32_t scratch;
+    uint32_t b;
+
+    if (block_transfer(dev, 0, 1, bench_buf, 0)) {
+        printf("%s: unreadable\n", dev->name);
+        return;
+    }
+    scratch = bench_buf[BOOT_SIGNATURE] != BOOT_SIGNATURE_0 || bench_buf[BOOT_SIGNATURE + 1] != BOOT_SIGNATURE_1;
+    printf("%s: %u KB%s\n", dev->name, dev->num_blocks / (1024 / dev->block_size),
+           scratch ? ", scratch" : ", has a boot sector, read only");
+
+    if (ata_uses_dma(dev)) {
+        bench_raw_disk(dev, "sequential read, DMA", 0, 0);
+        ata_set_dma(dev, 0);
+        bench_raw_disk(dev, "sequential read, PIO", 0, 0);
+        ata_set_dma(dev, 1);
+    } else {
+        bench_raw_disk(dev, "sequential read, PIO", 0, 0);
+    }
+    bench_raw_disk(dev, "random read", 1, 0);
+
+    bcache_invalidate(dev);
+    bcache_get_stats(&before);
+    uint32_t bytes = 0;
+    uint32_t start = pit_ticks;
+    for (b = 0; pit_ticks - start < BENCH_MS; b = (b + 1) % buffers) {
+        buffer_t *buf = bread(dev, b);
+        if (buf == NULL) {
+            printf("  cached read failed\n");
+            return;
+        }
+        memcpy(bench_buf, buf->data, BUFFER_SIZE);
+        brelse(buf);
+        bytes += BUFFER_SIZE;
+    }
+    print_rate("sequential cached read", bytes, pit_ticks - start);
+    bcache_get_stats(&after);
+    printf("  buffers read ahead: %u\n", after.readaheads - before.readaheads);
+    print_hit_rate("sequential cached read", after.hits - before.hits, after.misses - before.misses);
+
+    if (scratch) {
+        bcache_invalidate(dev);
+        bench_raw_disk(dev, "sequential write", 0, 1);
+        bench_raw_disk(dev, "random write", 1, 1);
+    }
+}
+
+/*
+ * bench_disk()
+ *
+ * DESCRIPTION: Runs the drive benchmarks on every IDE drive found. Attach
+ *              a zeroed image as a second drive (or as the only one when
+ *              booting with -kernel) to see the write passes.
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results, overwrites scratch disks
+ */
+void bench_disk(void) {
+    int8_t name[] = "hda";
+    uint32_t i;
+
+    for (i = 0; i < ATA_DRIVES; i++) {
+        block_device_t *dev;
+        name[2] = 'a' + i;
+        if ((dev = find_block_device(name)) != NULL) {
+            bench_drive(dev);
+        }
+    }
+}
+
+/*
+ * bench_pipe()
+ *
+ * DESCRIPTION: Pushes data through a pipe's ring a chunk at a time, one
+ *              write then one read, for chunk sizes up to the whole
+ *              buffer. Small chunks show the per call cost, big ones the
+ *              copying.
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results
+ */
+void bench_pipe(void) {
+    static int8_t *labels[] = {"16 byte chunks", "64 byte chunks", "256 byte chunks",
+                               "1KB chunks", "4KB chunks"};
+    static uint32_t chunks[] = {16, 64, 256, 1024, PIPE_SIZE};
+    int32_t index = pipe_create();
+    uint32_t i;
+
+    if (index < 0) {
+        return;
+    }
+
+    printf("pipe: %u byte ring\n", PIPE_SIZE);
+    for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        uint32_t bytes = 0;
+        uint32_t start = pit_ticks;
+        while (pit_ticks - start < BENCH_MS) {
+            if (pipe_put(index, bench_buf, chunks[i]) != chunks[i]
+                || pipe_get(index, bench_buf, chunks[i]) != chunks[i]) {
+                printf("  pipe transfer failed\n");
+                break;
+            }
+            bytes += chunks[i];
+        }
+        print_rate(labels[i], bytes, pit_ticks - start);
+    }
+
+    pipe_release(index, 0);
+    pipe_release(index, 1);
+}
+
+/*
+ * bench_terminal()
+ *
+ * DESCRIPTION: Writes lines of text to the screen the way terminal_write
+ *              used to, a putc per byte with the cursor moved after each,
+ *              and through terminal_write, which draws a whole write and
+ *              moves the cursor once. The screen is wiped before the
+ *              results are printed.
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results
+ */
+void bench_terminal(void) {
+    uint32_t bytes[2] = {0, 0};
+    uint32_t ms[2];
+    uint32_t i, start;
+
+    // Lines of 60 letters, about what cat shows
+    for (i = 0; i < BENCH_SMALL_CHUNK; i++) {
+        bench_buf[i] = i % 61 == 60 ? '\n' : 'a' + i % 26;
+    }
+
+    start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        for (i = 0; i < BENCH_SMALL_CHUNK; i++) {
+            putc(bench_buf[i]);
+        }
+        bytes[0] += BENCH_SMALL_CHUNK;
+    }
+    ms[0] = pit_ticks - start;
+
+    start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        bytes[1] += terminal_write(1, bench_buf, BENCH_SMALL_CHUNK);
+    }
+    ms[1] = pit_ticks - start;
+
+    memset(bench_buf, '\n', NUM_ROWS);
+    putn(bench_buf, NUM_ROWS);
+    set_screen_pos(0, 0);
+    update_cursor_loc(0, 0);
+
+    printf("terminal: %u byte writes\n", BENCH_SMALL_CHUNK);
+    print_rate("putc per byte", bytes[0], ms[0]);
+    print_rate("terminal_write", bytes[1], ms[1]);
+}
+
+/*
+ * print_switch(what, switches, ms)
+ *
+ * DESCRIPTION: Prints how long one terminal switch took on average
+ *
+ * INPUTS: 	what - label for the measurement
+ *          switches - switches done
+ *          ms - milliseconds they took
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints to the screen
+ */
+static void print_switch(int8_t *what, uint32_t switches, uint32_t ms) {
+    printf("  %s: %u ns per switch\n", what, switches ? ms * 1000000 / switches : 0);
+}
+
+/*
+ * bench_switch()
+ *
+ * DESCRIPTION: Times the screen side of a terminal switch both ways: the
+ *              old save and restore, copying the screen out to a backing
+ *              buffer and another one in, and pointing the VGA at another
+ *              terminal's page. Both move the cursor once.
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results, leaves the first page on screen
+ */
+void bench_switch(void) {
+    uint32_t switches[2] = {0, 0};
+    uint32_t ms[2];
+    uint32_t start;
+    uint32_t screen = 2 * NUM_ROWS * NUM_COLS;
+
+    // Both backing buffers hold the screen, so it looks the same after
+    memcpy(bench_buf, (uint8_t *)VIDEO, screen);
+    memcpy(bench_buf + screen, (uint8_t *)VIDEO, screen);
+
+    start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        uint8_t *save = bench_buf + (switches[0] & 1) * screen;
+        uint8_t *load = bench_buf + (~switches[0] & 1) * screen;
+        memcpy(save, (uint8_t *)VIDEO, screen);
+        memcpy((uint8_t *)VIDEO, load, screen);
+        update_cursor_loc(get_screen_x(), get_screen_y());
+        switches[0]++;
+    }
+    ms[0] = pit_ticks - start;
+
+    start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        uint32_t page = switches[1] % MAX_TERMINALS;
+        set_video_page(page);
+        show_video_page(page);
+        update_cursor_loc(get_screen_x(), get_screen_y());
+        switches[1]++;
+    }
+    ms[1] = pit_ticks - start;
+
+    set_video_page(0);
+    show_video_page(0);
+    update_cursor_loc(get_screen_x(), get_screen_y());
+
+    printf("terminal switch:\n");
+    print_switch("copy screen out and in", switches[0], ms[0]);
+    print_switch("flip VGA page", switches[1], ms[1]);
+}
+
+/*
+ * scroll_lines()
+ *
+ * DESCRIPTION: Prints short lines one write each at the bottom of the
+ *              screen, so every write scrolls once, for BENCH_MS
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * RETURNS: lines per second
+ * SIDE EFFECTS: Prints to the screen
+ */
+static uint32_t scroll_lines(void) {
+    static uint8_t line[] = "scrolling one line at a time\n";
+    uint32_t lines = 0;
+    uint32_t start = pit_ticks;
+    uint32_t ms;
+
+    set_screen_pos(0, NUM_ROWS - 1);
+    while (pit_ticks - start < BENCH_MS) {
+        terminal_write(1, line, sizeof(line) - 1);
+        lines++;
+    }
+
+    ms = pit_ticks - start;
+    return ms ? lines * 1000 / ms : 0;
+}
+
+/*
+ * bench_scroll()
+ *
+ * DESCRIPTION: Scrolls the screen line by line with the CRTC start
+ *              address following the text down VGA memory, then with the
+ *              software fallback that copies the screen up a row
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results, wipes the screen first
+ */
+void bench_scroll(void) {
+    uint32_t hw, sw;
+
+    hw = scroll_lines();
+    set_hw_scroll(0);
+    sw = scroll_lines();
+    set_hw_scroll(1);
+
+    memset(bench_buf, '\n', NUM_ROWS);
+    putn(bench_buf, NUM_ROWS);
+    set_screen_pos(0, 0);
+    update_cursor_loc(0, 0);
+
+    printf("scroll:\n");
+    printf("  start address: %u lines/s\n", hw);
+    printf("  copy: %u lines/s\n", sw);
+}
+
+/*
+ * per_second(count, ms)
+ *
+ * DESCRIPTION: Turns a count of bytes, lines or anything else done in
+ *              some milliseconds into a rate, without count * 1000
+ *              overflowing
+ *
+ * INPUTS: 	count - how many were done
+ *          ms - milliseconds it took
+ * OUTPUTS: none
+ *
+ * RETURNS: count per second, 0 if no time passed
+ * SIDE EFFECTS: none
+ */
+static uint32_t per_second(uint32_t count, uint32_t ms) {
+    return ms ? count / ms * 1000 + count % ms * 1000 / ms : 0;
+}
+
+/*
+ * bench_serial()
+ *
+ * DESCRIPTION: Sends lines out of COM1 by polling the line status and
+ *              filling the FIFO whenever it empties, then through
+ *              serial_write, which queues them for the IRQ4 handler. Each
+ *              pass counts what actually left the UART.
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results, writes to the serial port
+ */
+void bench_serial(void) {
+    uint32_t bytes[2] = {0, 0};
+    uint32_t ms[2];
+    uint32_t i, j, start;
+
+    if (!serial_present()) {
+        printf("serial: no UART on COM1\n");
+        return;
+    }
+
+    for (i = 0; i < BENCH_SERIAL_CHUNK; i++) {
+        bench_buf[i] = i % 64 == 63 ? '\n' : 'a' + i % 26;
+    }
+
+    // The ring is empty after draining, so the handler leaves the UART be
+    serial_drain();
+    start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        for (i = 0; i < BENCH_SERIAL_CHUNK; i += UART_FIFO_SIZE) {
+            while (!(inb(COM1_PORT + UART_LSR) & UART_LSR_THRE)) {
+                // Spin
+            }
+            for (j = i; j < i + UART_FIFO_SIZE; j++) {
+                outb(bench_buf[j], COM1_PORT + UART_DATA);
+            }
+        }
+        bytes[0] += BENCH_SERIAL_CHUNK;
+    }
+    serial_drain();
+    ms[0] = pit_ticks - start;
+
+    start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        bytes[1] += serial_write(0, bench_buf, BENCH_SERIAL_CHUNK);
+    }
+    serial_drain();
+    ms[1] = pit_ticks - start;
+
+    printf("serial: %u baud, %u byte writes\n", SERIAL_BAUD, BENCH_SERIAL_CHUNK);
+    printf("  polled: %u bytes/s\n", per_second(bytes[0], ms[0]));
+    printf("  interrupts: %u bytes/s\n", per_second(bytes[1], ms[1]));
+}
+
+/*
+ * bench_printk()
+ *
+ * DESCRIPTION: Logs the same line with printk, below the console level so
+ *              only the log sees it, then prints it with printf, counting
+ *              how many of each fit in a pass
+ *
+ * INPUTS: 	none
+ * OUTPUTS: none
+ *
+ * SIDE EFFECTS: Prints results, fills the log and the screen
+ */
+void bench_printk(void) {
+    uint32_t calls[2] = {0, 0};
+    uint32_t ms[2];
+    uint32_t start;
+
+    start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        printk(KERN_DEBUG, "bench: line %u of %s\n", calls[0], "printk");
+        calls[0]++;
+    }
+    ms[0] = pit_ticks - start;
+
+    start = pit_ticks;
+    while (pit_ticks - start < BENCH_MS) {
+        printf("bench: line %u of %s\n", calls[1], "printf");
+        calls[1]++;
+    }
+    ms[1] = pit_ticks - start;
+
+    printf("printk: %u lines/s\n", per_second(calls[0], ms[0]));
+    printf("printf: %u lines/s\n", per_second(calls[1], ms[1]));
+}
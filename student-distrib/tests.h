@@ -3,4 +3,41 @@
 
 #include "rtc.h"
 
+/* Time spent on each benchmark pass */
+#define BENCH_MS        250
+/* Bytes asked for by each read() in the sequential benchmark */
+#define BENCH_CHUNK     0x4000
+/* Bytes asked for by each read() from cat, the small read case */
+#define BENCH_SMALL_CHUNK 1024
+/* Bytes sent at a time out of the serial port, a multiple of its FIFO */
+#define BENCH_SERIAL_CHUNK 256
+/* Paths sampled for the lookup benchmark, and how long each can be */
+#define BENCH_PATHS     256
+#define BENCH_PATH_LENGTH 128
+/* Deepest directory the lookup benchmark walks into */
+#define BENCH_MAX_DEPTH 8
+/* Where a boot sector ends with 0x55 0xAA; drives without it are scratch */
+#define BOOT_SIGNATURE  510
+#define BOOT_SIGNATURE_0 0x55
+#define BOOT_SIGNATURE_1 0xAA
+
+/* Compares reading and loading programs out of every mounted rofs image */
+void bench_rofs(void);
+/* Compares the ramdisk with and without the buffer cache */
+void bench_block(void);
+/* Sequential and random reads and writes on the IDE drives */
+void bench_disk(void);
+/* Moves data through a pipe's ring in chunks of several sizes */
+void bench_pipe(void);
+/* Terminal output a byte at a time against whole writes */
+void bench_terminal(void);
+/* Terminal switches by copying the screen against flipping VGA pages */
+void bench_switch(void);
+/* Scrolling by moving the VGA start address against copying the screen */
+void bench_scroll(void);
+/* Serial output polled against queued for the transmit interrupt */
+void bench_serial(void);
+/* Logging a line against printing it */
+void bench_printk(void);
+
 #endif
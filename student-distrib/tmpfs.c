@@ -0,0 +1,395 @@
+#include "tmpfs.h"
+
+#include "lib.h"
+#include "mount.h"
+#include "syscalls.h"
+
+static tmpfs_node_t nodes[TMPFS_MAX_FILES];
+
+/*
+ * tmpfs_name(filename)
+ *
+ * DESCRIPTION: Resolves a path through the mount table
+ *
+ * INPUTS: 	filename - full path
+ * OUTPUTS: none
+ *
+ * RETURNS: the name within the tmpfs, "." for its directory, or NULL if
+ *          the path is not in it
+ * SIDE EFFECTS: none
+ */
+static const int8_t *tmpfs_name(const int8_t *filename) {
+    const int8_t *name;
+    mount_t *mount = resolve_path(filename, &name);
+    if (mount == NULL || mount->type != MOUNT_TMPFS || name[0] == '\0') {
+        return NULL;
+    }
+
+    return name;
+}
+
+/*
+ * is_tmpfs_dir(filename)
+ *
+ * DESCRIPTION: Checks whether a path names the tmpfs directory itself
+ *
+ * INPUTS: 	filename - full path
+ * OUTPUTS: none
+ *
+ * RETURNS: 1 if it does, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+static int32_t is_tmpfs_dir(const int8_t *filename) {
+    const int8_t *name = tmpfs_name(filename);
+    return name != NULL && !strncmp(name, ".", 2);
+}
+
+/*
+ * find_node(filename)
+ *
+ * DESCRIPTION: Looks up a linked node by path
+ *
+ * INPUTS: 	filename - full path
+ * OUTPUTS: none
+ *
+ * RETURNS: node index, or -1 if there is no such file
+ * SIDE EFFECTS: none
+ */
+static int32_t find_node(const int8_t *filename) {
+    const int8_t *name = tmpfs_name(filename);
+    int32_t i;
+
+    if (name == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < TMPFS_MAX_FILES; i++) {
+        if ((nodes[i].flags & (TMPFS_IN_USE | TMPFS_UNLINKED)) != TMPFS_IN_USE) {
+            continue;
+        }
+
+        if (!strncmp(name, nodes[i].file_name, FILE_NAME_LENGTH)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * set_length(node, length)
+ *
+ * DESCRIPTION: Grows or shrinks a file. Shrinking drops the pages past
+ *              the new end and zeroes the tail of the last one, so a
+ *              later grow reads back zeros.
+ *
+ * INPUTS: 	node - the node to resize
+ *          length - the new length
+ * OUTPUTS: none
+ *
+ * RETURNS: -1 if the length is too large, 0 otherwise
+ * SIDE EFFECTS: may free frames
+ */
+static int32_t set_length(tmpfs_node_t *node, uint32_t length) {
+    if (length > MAX_CACHE_LENGTH) {
+        return -1;
+    }
+
+    if (length < node->length) {
+        page_cache_truncate(&node->cache, (length + PAGE_SIZE - 1) >> PAGE_SHIFT);
+
+        uint8_t *page = page_cache_lookup(&node->cache, length >> PAGE_SHIFT);
+        if (page != NULL) {
+            memset(page + (length & PAGE_MASK), 0, PAGE_SIZE - (length & PAGE_MASK));
+        }
+    }
+
+    node->length = length;
+    return 0;
+}
+
+/*
+ * tmpfs_read_dentry(filename, dentry)
+ *
+ * DESCRIPTION: Attempts to read a tmpfs directory entry by path. The
+ *              tmpfs directory itself is where it is mounted.
+ *
+ * INPUTS: 	filename - full path
+ * OUTPUTS: dentry - the populated directory entry
+ *
+ * RETURNS: -1 on error, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+int32_t tmpfs_read_dentry(const int8_t *filename, dentry_t *dentry) {
+    if (is_tmpfs_dir(filename)) {
+        memset(dentry, 0, sizeof(dentry_t));
+        strncpy(dentry->file_name, ".", FILE_NAME_LENGTH);
+        dentry->file_type = dir;
+        return 0;
+    }
+
+    int32_t index = find_node(filename);
+    if (index < 0) {
+        return -1;
+    }
+
+    memset(dentry, 0, sizeof(dentry_t));
+    strncpy(dentry->file_name, nodes[index].file_name, FILE_NAME_LENGTH);
+    dentry->file_type = file;
+    dentry->inode_num = index;
+    return 0;
+}
+
+/*
+ * tmpfs_create(filename)
+ *
+ * DESCRIPTION: Makes a new empty file, or empties an existing one
+ *
+ * INPUTS: 	filename - full path
+ * OUTPUTS: none
+ *
+ * RETURNS: node index, or -1 if the path is not in the tmpfs or it is full
+ * SIDE EFFECTS: may free frames
+ */
+int32_t tmpfs_create(const int8_t *filename) {
+    const int8_t *name = tmpfs_name(filename);
+    int32_t i;
+
+    if (name == NULL || is_tmpfs_dir(filename)) {
+        return -1;
+    }
+
+    i = find_node(filename);
+    if (i >= 0) {
+        set_length(&nodes[i], 0);
+        return i;
+    }
+
+    for (i = 0; i < TMPFS_MAX_FILES; i++) {
+        if (nodes[i].flags & TMPFS_IN_USE) {
+            continue;
+        }
+
+        strncpy(nodes[i].file_name, name, FILE_NAME_LENGTH);
+        nodes[i].flags = TMPFS_IN_USE;
+        nodes[i].length = 0;
+        nodes[i].open_count = 0;
+        nodes[i].cache.pages = NULL;
+        nodes[i].cache.num_pages = 0;
+        return i;
+    }
+
+    // No free nodes
+    return -1;
+}
+
+/*
+ * tmpfs_unlink(filename)
+ *
+ * DESCRIPTION: Removes a file. Its pages stay around until the last
+ *              open descriptor is closed.
+ *
+ * INPUTS: 	filename - full path
+ * OUTPUTS: none
+ *
+ * RETURNS: -1 on error, 0 otherwise
+ * SIDE EFFECTS: may free frames
+ */
+int32_t tmpfs_unlink(const int8_t *filename) {
+    int32_t i = find_node(filename);
+    if (i < 0) {
+        return -1;
+    }
+
+    if (nodes[i].open_count > 0) {
+        nodes[i].flags |= TMPFS_UNLINKED;
+        return 0;
+    }
+
+    set_length(&nodes[i], 0);
+    nodes[i].flags = 0;
+    return 0;
+}
+
+/*
+ * tmpfs_truncate(filename, length)
+ *
+ * DESCRIPTION: Sets the length of a file, zero filling when it grows
+ *
+ * INPUTS: 	filename - full path
+ *          length - the new length
+ * OUTPUTS: none
+ *
+ * RETURNS: -1 on error, 0 otherwise
+ * SIDE EFFECTS: may free frames
+ */
+int32_t tmpfs_truncate(const int8_t *filename, uint32_t length) {
+    int32_t i = find_node(filename);
+    if (i < 0) {
+        return -1;
+    }
+
+    return set_length(&nodes[i], length);
+}
+
+/*
+ * tmpfs_stat_name(filename, buf)
+ *
+ * DESCRIPTION: Gets file information for a tmpfs path
+ *
+ * INPUTS: 	filename - full path
+ * OUTPUTS: buf - the file information
+ *
+ * RETURNS: -1 on error, 0 otherwise
+ * SIDE EFFECTS: none
+ */
+int32_t tmpfs_stat_name(const int8_t *filename, stat_t *buf) {
+    dentry_t dentry;
+    if (tmpfs_read_dentry(filename, &dentry)) {
+        return -1;
+    }
+
+    buf->file_type = dentry.file_type;
+    buf->inode_num = dentry.inode_num;
+    buf->length = dentry.file_type == file ? nodes[dentry.inode_num].length : 0;
+    buf->num_blocks = dentry.file_type == file ? nodes[dentry.inode_num].cache.num_pages : 0;
+    return 0;
+}
+
+int32_t tmpfs_open(const int8_t *filename) {
+    int32_t i = find_node(filename);
+    if (i < 0) {
+        return -1;
+    }
+
+    nodes[i].open_count++;
+    return 0;
+}
+
+int32_t tmpfs_close(int32_t fd) {
+    if (get_file(fd) == NULL) {
+        return -1;
+    }
+
+    tmpfs_node_t *node = &nodes[get_file(fd)->inode];
+    node->open_count--;
+
+    if (node->open_count == 0 && (node->flags & TMPFS_UNLINKED)) {
+        // Last reference to an unlinked file
+        set_length(node, 0);
+        node->flags = 0;
+    }
+
+    return 0;
+}
+
+int32_t tmpfs_read(int32_t fd, void *buf, int32_t nbytes) {
+    if (get_file(fd) == NULL || nbytes < 0) {
+        return -1;
+    }
+
+    file_t *file = get_file(fd);
+    tmpfs_node_t *node = &nodes[file->inode];
+    uint8_t *byte_buf = (uint8_t *) buf;
+
+    if (file->pos >= node->length) {
+        return 0;
+    }
+
+    if (nbytes > node->length - file->pos) {
+        nbytes = node->length - file->pos;
+    }
+
+    // Copy straight out of the cached pages, holes read as zeros
+    int32_t copied = 0;
+    while (copied < nbytes) {
+        uint32_t pos = file->pos + copied;
+        uint32_t run = PAGE_SIZE - (pos & PAGE_MASK);
+        if (run > nbytes - copied) {
+            run = nbytes - copied;
+        }
+
+        uint8_t *page = page_cache_lookup(&node->cache, pos >> PAGE_SHIFT);
+        if (page == NULL) {
+            memset(byte_buf + copied, 0, run);
+        } else {
+            memcpy(byte_buf + copied, page + (pos & PAGE_MASK), run);
+        }
+        copied += run;
+    }
+
+    file->pos += copied;
+    return copied;
+}
+
+int32_t tmpfs_write(int32_t fd, const void *buf, int32_t nbytes) {
+    if (get_file(fd) == NULL || nbytes < 0) {
+        return -1;
+    }
+
+    file_t *file = get_file(fd);
+    tmpfs_node_t *node = &nodes[file->inode];
+    const uint8_t *byte_buf = (const uint8_t *) buf;
+
+    int32_t copied = 0;
+    while (copied < nbytes) {
+        uint32_t pos = file->pos + copied;
+        uint32_t run = PAGE_SIZE - (pos & PAGE_MASK);
+        if (run > nbytes - copied) {
+            run = nbytes - copied;
+        }
+
+        uint8_t *page = page_cache_grab(&node->cache, pos >> PAGE_SHIFT);
+        if (page == NULL) {
+            // Out of frames or the file is at its size limit
+            break;
+        }
+
+        memcpy(page + (pos & PAGE_MASK), byte_buf + copied, run);
+        copied += run;
+    }
+
+    file->pos += copied;
+    if (file->pos > node->length) {
+        node->length = file->pos;
+    }
+
+    return copied == 0 && nbytes > 0 ? -1 : copied;
+}
+
+int32_t tmpfs_stat(int32_t fd, stat_t *buf) {
+    file_t *file = get_file(fd);
+
+    buf->file_type = file->type;
+    buf->inode_num = file->inode;
+    buf->length = file->type == dir ? 0 : nodes[file->inode].length;
+    buf->num_blocks = file->type == dir ? 0 : nodes[file->inode].cache.num_pages;
+    return 0;
+}
+
+int32_t tmpfs_dir_open(const int8_t *filename) {
+    return is_tmpfs_dir(filename) ? 0 : -1;
+}
+
+int32_t tmpfs_dir_read(int32_t fd, void *buf, int32_t nbytes) {
+    file_t *file = get_file(fd);
+
+    // pos is the next node to look at, skip to one that is linked
+    while (file->pos < TMPFS_MAX_FILES
+           && (nodes[file->pos].flags & (TMPFS_IN_USE | TMPFS_UNLINKED)) != TMPFS_IN_USE) {
+        file->pos++;
+    }
+
+    if (file->pos >= TMPFS_MAX_FILES) {
+        return 0;
+    }
+
+    // Copy number of bytes requested up to max file name length
+    int8_t *name = nodes[file->pos].file_name;
+    int32_t copy_length = nbytes > FILE_NAME_LENGTH ? FILE_NAME_LENGTH : nbytes;
+    strncpy((int8_t *)buf, name, copy_length);
+
+    file->pos++;
+    int32_t bytes_read = strlen(name);
+    return bytes_read > FILE_NAME_LENGTH ? FILE_NAME_LENGTH : bytes_read;
+}
@@ -0,0 +1,37 @@
+#ifndef TMPFS_H_
+#define TMPFS_H_
+
+#include "types.h"
+#include "rofs.h"
+#include "pagecache.h"
+
+#define TMPFS_MAX_FILES     64
+
+// Node flags
+#define TMPFS_IN_USE        0x1
+#define TMPFS_UNLINKED      0x2     // Gone from the directory, freed on last close
+
+typedef struct tmpfs_node {
+    int8_t file_name[FILE_NAME_LENGTH];
+    uint32_t flags;
+    uint32_t length;
+    uint32_t open_count;
+    page_cache_t cache;
+} tmpfs_node_t;
+
+int32_t tmpfs_read_dentry(const int8_t *filename, dentry_t *dentry);
+int32_t tmpfs_create(const int8_t *filename);
+int32_t tmpfs_unlink(const int8_t *filename);
+int32_t tmpfs_truncate(const int8_t *filename, uint32_t length);
+int32_t tmpfs_stat_name(const int8_t *filename, stat_t *buf);
+
+int32_t tmpfs_open(const int8_t *filename);
+int32_t tmpfs_close(int32_t fd);
+int32_t tmpfs_read(int32_t fd, void *buf, int32_t nbytes);
+int32_t tmpfs_write(int32_t fd, const void *buf, int32_t nbytes);
+int32_t tmpfs_stat(int32_t fd, stat_t *buf);
+
+int32_t tmpfs_dir_open(const int8_t *filename);
+int32_t tmpfs_dir_read(int32_t fd, void *buf, int32_t nbytes);
+
+#endif
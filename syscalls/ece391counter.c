@@ -15,6 +15,8 @@ int main ()
         ece391_fdputs(1, (uint8_t*)"Can't read the number from keyboard.\n");
      return 3;
     }
+    if (cnt > 0 && '\n' == buf[cnt - 1])
+        cnt--;
     buf[cnt] = '\0';
 
     if ((ece391_strlen(buf) > 1) || ((ece391_strlen(buf) == 1) && ((buf[0] < '0') || (buf[0] > '2')))) {
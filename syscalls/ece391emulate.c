@@ -58,6 +58,7 @@ _start:                                 \n\
 	MOVL	%ESP,start_esp          \n\
         CALL	main                    \n\
 	PUSHL	%EAX                    \n\
+	CALL	ece391_flush            \n\
 	CALL	ece391_halt             \n\
 ");
 
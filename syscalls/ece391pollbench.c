@@ -0,0 +1,103 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define RTC_FREQ 512
+#define TICKS 512
+#define LINE_SIZE 128
+
+static uint8_t line[LINE_SIZE];
+
+static void print_result (const char* what, uint32_t total, uint32_t worst)
+{
+    ece391_printf ((uint8_t*)"%s%u kcycles mean gap, %u worst\n", what, total / TICKS, worst);
+}
+
+/* Times TICKS gaps between RTC reads that block */
+static int32_t read_pass (int32_t rtc_fd, uint32_t* total, uint32_t* worst)
+{
+    uint32_t i, last, now, garbage;
+
+    ece391_read (rtc_fd, &garbage, 4);
+    last = ece391_kcycles ();
+    for (i = 0; i < TICKS; i++) {
+	if (-1 == ece391_read (rtc_fd, &garbage, 4))
+	    return -1;
+	now = ece391_kcycles ();
+	*total += now - last;
+	if (now - last > *worst)
+	    *worst = now - last;
+	last = now;
+    }
+    return 0;
+}
+
+/* Times TICKS gaps between RTC ticks that poll reports, echoing lines */
+static int32_t poll_pass (int32_t rtc_fd, uint32_t* total, uint32_t* worst)
+{
+    ece391_pollfd_t fds[2];
+    uint32_t i, last, now, garbage;
+    int32_t cnt;
+
+    fds[0].fd = rtc_fd;
+    fds[0].events = ECE391_POLLIN;
+    fds[1].fd = 0;
+    fds[1].events = ECE391_POLLIN;
+
+    ece391_read (rtc_fd, &garbage, 4);
+    last = ece391_kcycles ();
+    for (i = 0; i < TICKS; ) {
+	if (0 >= ece391_poll (fds, 2, -1))
+	    return -1;
+
+	if (fds[0].revents & ECE391_POLLIN) {
+	    now = ece391_kcycles ();
+	    *total += now - last;
+	    if (now - last > *worst)
+		*worst = now - last;
+	    ece391_read (rtc_fd, &garbage, 4);
+	    last = now;
+	    i++;
+	}
+
+	if (fds[1].revents & ECE391_POLLIN) {
+	    if (0 < (cnt = ece391_read (0, line, LINE_SIZE)))
+		ece391_write (1, line, cnt);
+	}
+
+	if ((fds[0].revents | fds[1].revents) & (ECE391_POLLERR | ECE391_POLLNVAL))
+	    return -1;
+    }
+    return 0;
+}
+
+int main ()
+{
+    int32_t rtc_fd, freq = RTC_FREQ;
+    uint32_t total, worst;
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc")) ||
+	-1 == ece391_write (rtc_fd, &freq, 4)) {
+        ece391_fdputs (1, (uint8_t*)"rtc open failed\n");
+	return 2;
+    }
+
+    total = worst = 0;
+    if (-1 == read_pass (rtc_fd, &total, &worst)) {
+        ece391_fdputs (1, (uint8_t*)"rtc read failed\n");
+	return 3;
+    }
+    print_result ("read(): ", total, worst);
+
+    ece391_fdputs (1, (uint8_t*)"polling the rtc and stdin, type lines to echo\n");
+    total = worst = 0;
+    if (-1 == poll_pass (rtc_fd, &total, &worst)) {
+        ece391_fdputs (1, (uint8_t*)"poll failed\n");
+	return 3;
+    }
+    print_result ("poll(): ", total, worst);
+
+    ece391_close (rtc_fd);
+    return 0;
+}
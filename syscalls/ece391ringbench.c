@@ -0,0 +1,171 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NAME_SIZE 33
+#define MAX_NAMES 64
+#define CHUNK 4096
+#define RING_ENTRIES 32
+/* Files open at once, every fd but stdin and stdout */
+#define GROUP 6
+
+static uint8_t names[MAX_NAMES][NAME_SIZE];
+static uint32_t lengths[MAX_NAMES];
+static uint32_t num_names;
+
+static uint8_t bufs[RING_ENTRIES][CHUNK];
+static ece391_io_sqe_t sqes[RING_ENTRIES];
+static ece391_io_cqe_t cqes[RING_ENTRIES];
+static ece391_io_ring_t ring;
+
+static uint32_t calls, bytes;
+
+static void print_result (const char* what, uint32_t elapsed)
+{
+    ece391_printf ((uint8_t*)"%s%u bytes, %u syscalls, %u kcycles\n", what, bytes, calls, elapsed);
+}
+
+/* Collects the regular files in the root directory */
+static int32_t find_files ()
+{
+    int32_t fd, cnt;
+    ece391_stat_t st;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)".")))
+        return -1;
+
+    while (num_names < MAX_NAMES &&
+	   0 < (cnt = ece391_read (fd, names[num_names], NAME_SIZE - 1))) {
+	names[num_names][cnt] = '\0';
+	if (0 == ece391_stat (names[num_names], &st) && FT_FILE == st.file_type) {
+	    lengths[num_names] = st.length;
+	    num_names++;
+	}
+    }
+
+    ece391_close (fd);
+    return 0;
+}
+
+/* Reads every file a chunk per read call */
+static int32_t read_pass ()
+{
+    uint32_t i, left;
+    int32_t fd, cnt;
+
+    for (i = 0; i < num_names; i++) {
+	calls++;
+	if (-1 == (fd = ece391_open (names[i])))
+	    return -1;
+
+	for (left = lengths[i]; left > 0; left -= cnt) {
+	    calls++;
+	    if (0 >= (cnt = ece391_read (fd, bufs[0], CHUNK)))
+		return -1;
+	    bytes += cnt;
+	}
+
+	calls++;
+	ece391_close (fd);
+    }
+    return 0;
+}
+
+/* Hands the kernel everything queued and reaps all of it */
+static int32_t reap ()
+{
+    calls++;
+    if (-1 == ece391_io_enter (ring.sq_tail - ring.cq_head))
+	return -1;
+
+    while (ring.cq_head != ring.cq_tail) {
+	ece391_io_cqe_t* cqe = &cqes[ring.cq_head & (RING_ENTRIES - 1)];
+	if (0 >= cqe->result)
+	    return -1;
+	bytes += cqe->result;
+	ring.cq_head++;
+    }
+    return 0;
+}
+
+/* Reads every file by queueing all of a group's chunks on the ring */
+static int32_t ring_pass ()
+{
+    uint32_t first, i, offset;
+    int32_t fds[GROUP];
+
+    for (first = 0; first < num_names; first += GROUP) {
+	uint32_t count = num_names - first < GROUP ? num_names - first : GROUP;
+
+	for (i = 0; i < count; i++) {
+	    calls++;
+	    if (-1 == (fds[i] = ece391_open (names[first + i])))
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+	    for (offset = 0; offset < lengths[first + i]; offset += CHUNK) {
+		uint32_t slot = ring.sq_tail & (RING_ENTRIES - 1);
+		ece391_io_sqe_t* sqe = &sqes[slot];
+
+		if (RING_ENTRIES == ring.sq_tail - ring.cq_head && -1 == reap ())
+		    return -1;
+
+		sqe->opcode = IO_OP_READ;
+		sqe->fd = fds[i];
+		sqe->buf = bufs[slot];
+		sqe->nbytes = CHUNK;
+		sqe->offset = offset;
+		sqe->user_data = first + i;
+		ring.sq_tail++;
+	    }
+	}
+
+	if (ring.sq_tail != ring.cq_head && -1 == reap ())
+	    return -1;
+
+	for (i = 0; i < count; i++) {
+	    calls++;
+	    ece391_close (fds[i]);
+	}
+    }
+    return 0;
+}
+
+int main ()
+{
+    uint32_t start;
+
+    if (-1 == find_files ()) {
+        ece391_fdputs (1, (uint8_t*)"directory open failed\n");
+	return 2;
+    }
+
+    ring.entries = RING_ENTRIES;
+    ring.sqes = sqes;
+    ring.cqes = cqes;
+    if (-1 == ece391_io_setup (&ring)) {
+        ece391_fdputs (1, (uint8_t*)"ring setup failed\n");
+	return 3;
+    }
+
+    calls = bytes = 0;
+    start = ece391_kcycles ();
+    if (-1 == read_pass ()) {
+        ece391_fdputs (1, (uint8_t*)"read failed\n");
+	return 3;
+    }
+    print_result ("read(): ", ece391_kcycles () - start);
+
+    calls = bytes = 0;
+    start = ece391_kcycles ();
+    if (-1 == ring_pass ()) {
+        ece391_fdputs (1, (uint8_t*)"ring read failed\n");
+	return 3;
+    }
+    print_result ("ring:   ", ece391_kcycles () - start);
+
+    ece391_io_setup (0);
+    return 0;
+}
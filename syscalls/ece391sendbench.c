@@ -0,0 +1,133 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NAME_SIZE 33
+#define CHUNK 1024
+#define PASSES 8
+#define OUT_FILE "tmp/sendbench"
+
+static uint8_t name[NAME_SIZE];
+static uint32_t length;
+static uint8_t buf[CHUNK];
+
+static uint32_t calls, bytes;
+
+static void print_result (const char* what, uint32_t elapsed)
+{
+    ece391_printf ((uint8_t*)"%s%u bytes, %u syscalls, %u kcycles\n", what, bytes, calls, elapsed);
+}
+
+/* Picks the biggest regular file in the root directory */
+static int32_t find_file ()
+{
+    uint8_t entry[NAME_SIZE];
+    int32_t fd, cnt;
+    ece391_stat_t st;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)".")))
+        return -1;
+
+    while (0 < (cnt = ece391_read (fd, entry, NAME_SIZE - 1))) {
+	entry[cnt] = '\0';
+	if (0 == ece391_stat (entry, &st) && FT_FILE == st.file_type &&
+	    st.length > length) {
+	    ece391_strcpy (name, entry);
+	    length = st.length;
+	}
+    }
+
+    ece391_close (fd);
+    return 0 == length ? -1 : 0;
+}
+
+/* Copies the file the way cat used to, through a buffer here */
+static int32_t copy_pass (int32_t out)
+{
+    int32_t in, cnt;
+
+    calls++;
+    if (-1 == (in = ece391_open (name)))
+	return -1;
+
+    while (1) {
+	calls++;
+	if (0 == (cnt = ece391_read (in, buf, CHUNK)))
+	    break;
+	if (-1 == cnt)
+	    return -1;
+	calls++;
+	if (cnt != ece391_write (out, buf, cnt))
+	    return -1;
+	bytes += cnt;
+    }
+
+    calls++;
+    ece391_close (in);
+    return 0;
+}
+
+/* Copies the file with one sendfile */
+static int32_t send_pass (int32_t out)
+{
+    int32_t in, cnt;
+
+    calls++;
+    if (-1 == (in = ece391_open (name)))
+	return -1;
+
+    calls++;
+    if (length != (cnt = ece391_sendfile (out, in, 0, length)))
+	return -1;
+    bytes += cnt;
+
+    calls++;
+    ece391_close (in);
+    return 0;
+}
+
+/* Runs a pass PASSES times into a fresh file under tmp/ */
+static int32_t run (const char* what, int32_t (*pass) (int32_t))
+{
+    uint32_t start, i;
+    int32_t out;
+
+    if (-1 == (out = ece391_create ((uint8_t*)OUT_FILE)))
+	return -1;
+
+    calls = bytes = 0;
+    start = ece391_kcycles ();
+    for (i = 0; i < PASSES; i++) {
+	if (-1 == pass (out))
+	    return -1;
+    }
+    print_result (what, ece391_kcycles () - start);
+
+    ece391_close (out);
+    ece391_unlink ((uint8_t*)OUT_FILE);
+    return 0;
+}
+
+int main ()
+{
+    if (-1 == find_file ()) {
+        ece391_fdputs (1, (uint8_t*)"no file to send\n");
+	return 2;
+    }
+
+    ece391_fdputs (1, name);
+    ece391_fdputs (1, (uint8_t*)"\n");
+
+    if (-1 == run ("read()/write(): ", copy_pass)) {
+        ece391_fdputs (1, (uint8_t*)"copy failed\n");
+	return 3;
+    }
+
+    if (-1 == run ("sendfile():     ", send_pass)) {
+        ece391_fdputs (1, (uint8_t*)"sendfile failed\n");
+	return 3;
+    }
+
+    return 0;
+}
@@ -5,9 +5,87 @@
 
 #define BUFSIZE 1024
 
+/* Checks that every command of a pipeline "a | b | c" has a program */
+static int32_t empty_stage (const uint8_t* buf)
+{
+    int32_t seen = 0, piped = 0;
+
+    for (; '\0' != *buf; buf++) {
+	if ('|' == *buf) {
+	    if (!seen)
+		return 1;
+	    seen = 0;
+	    piped = 1;
+	} else if (' ' != *buf) {
+	    seen = 1;
+	}
+    }
+    return piped && !seen;
+}
+
+/* Closes whatever redirect opened */
+static void close_redirects (int32_t* fds)
+{
+    int32_t i;
+
+    for (i = 0; i < 2; i++) {
+	if (-1 != fds[i])
+	    ece391_close (fds[i]);
+	fds[i] = -1;
+    }
+}
+
+/*
+ * Cuts "< file" and "> file" off a command and opens the files, the
+ * input in fds[0] and the output, emptied first, in fds[1].  Either is
+ * -1 when not given.  Only files under "tmp/" can be created; output
+ * to anything else that exists, such as dev/ttyS0, goes to it as it is.
+ */
+static int32_t redirect (uint8_t* buf, int32_t* fds)
+{
+    uint8_t *p, *name;
+    uint8_t op, next;
+    int32_t fd, which;
+
+    fds[0] = fds[1] = -1;
+    for (p = buf; '\0' != *p; ) {
+	if ('<' != *p && '>' != *p) {
+	    p++;
+	    continue;
+	}
+	op = *p;
+	*p++ = '\0';
+	while (' ' == *p)
+	    p++;
+	for (name = p; '\0' != *p && ' ' != *p && '<' != *p && '>' != *p; p++);
+	if (name == p) {
+	    close_redirects (fds);
+	    return -1;
+	}
+
+	next = *p;
+	*p = '\0';
+	fd = '<' == op ? ece391_open (name) : ece391_create (name);
+	if (-1 == fd && '>' == op)
+	    fd = ece391_open (name);
+	*p = next;
+	if (-1 == fd) {
+	    close_redirects (fds);
+	    return -1;
+	}
+
+	which = '<' == op ? 0 : 1;
+	if (-1 != fds[which])
+	    ece391_close (fds[which]);
+	fds[which] = fd;
+    }
+    return 0;
+}
+
 int main ()
 {
-    int32_t cnt, rval;
+    int32_t cnt, rval, i;
+    int32_t fds[2], saved[2];
     uint8_t buf[BUFSIZE];
     ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
 
@@ -24,7 +102,35 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
+	if (empty_stage (buf)) {
+	    ece391_fdputs (1, (uint8_t*)"missing command in pipeline\n");
+	    continue;
+	}
+	if (-1 == redirect (buf, fds)) {
+	    ece391_fdputs (1, (uint8_t*)"cannot open redirected file\n");
+	    continue;
+	}
+
+	/* The program gets the files as stdin and stdout, the shell's own
+	   come back afterwards */
+	for (i = 0; i < 2; i++) {
+	    saved[i] = -1;
+	    if (-1 != fds[i]) {
+		saved[i] = ece391_dup (i);
+		ece391_dup2 (fds[i], i);
+	    }
+	}
+	close_redirects (fds);
+
 	rval = ece391_execute (buf);
+
+	for (i = 0; i < 2; i++) {
+	    if (-1 != saved[i]) {
+		ece391_dup2 (saved[i], i);
+		ece391_close (saved[i]);
+	    }
+	}
+
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
 	else if (256 == rval)
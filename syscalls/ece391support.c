@@ -2,6 +2,12 @@
 
 #include "ece391support.h"
 #include "ece391syscall.h"
+#include "../student-distrib/format.h"
+
+/* Stdout for ece391_printf, written out a line or a buffer-full at a time */
+static uint8_t out_buf[PRINTF_BUF_SIZE];
+static void flush_stdout (format_buf_t* fb);
+static format_buf_t out = {(char*)out_buf, PRINTF_BUF_SIZE, 0, 0, 1, flush_stdout};
 
 uint32_t ece391_strlen(const uint8_t* s)
 {
@@ -102,3 +108,52 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+
+static void flush_stdout (format_buf_t* fb)
+{
+    if (fb->len > 0)
+        (void)ece391_write (1, fb->buf, fb->len);
+    fb->len = 0;
+}
+
+/*
+ * Formatted output to stdout, with the kernel's printf conversions plus
+ * widths, precisions and padding.  The text collects in a buffer that
+ * goes out in one write at each '\n' or when it fills up.
+ */
+int32_t ece391_printf (const uint8_t* format, ...)
+{
+    va_list args;
+    int32_t length;
+
+    va_start (args, format);
+    length = format_into (&out, (const char*)format, args);
+    va_end (args);
+    return length;
+}
+
+/* Writes whatever ece391_printf has not yet, such as a prompt */
+void ece391_flush ()
+{
+    flush_stdout (&out);
+}
+
+/* Formats into buf like ece391_printf, cutting the text at size - 1 */
+int32_t ece391_snprintf (uint8_t* buf, uint32_t size, const uint8_t* format, ...)
+{
+    va_list args;
+    int32_t length;
+
+    va_start (args, format);
+    length = vsnprintf ((char*)buf, size, (const char*)format, args);
+    va_end (args);
+    return length;
+}
+
+/* Time stamp counter in units of 1024 cycles, for timing benchmarks */
+uint32_t ece391_kcycles ()
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return (hi << 22) | (lo >> 10);
+}
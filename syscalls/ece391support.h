@@ -9,5 +9,20 @@ extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
 
+/* Most output ece391_printf holds before writing it */
+#define PRINTF_BUF_SIZE 1024
+
+/*
+ * printf-style formatting: %d %i %u %x %X %o %p %c %s with '-', '0',
+ * widths and precisions.  ece391_printf holds its output until a '\n' or
+ * a full buffer; ece391_flush writes out the rest, and so does halting.
+ */
+extern int32_t ece391_printf(const uint8_t* format, ...);
+extern void ece391_flush(void);
+extern int32_t ece391_snprintf(uint8_t* buf, uint32_t size, const uint8_t* format, ...);
+
+/* Time stamp counter / 1024, wraps every 2^42 cycles */
+extern uint32_t ece391_kcycles(void);
+
 #endif /* ECE391SUPPORT_H */
 
@@ -5,11 +5,75 @@
 
 /* All calls return >= 0 on success or -1 on failure. */
 
+/* File types reported by stat and fstat */
+enum file_types {
+	FT_RTC = 0,
+	FT_DIR,
+	FT_FILE,
+	FT_TTY,
+	FT_BLOCK,
+	FT_PIPE
+};
+
+/* File information filled in by stat and fstat */
+typedef struct ece391_stat {
+	uint32_t file_type;
+	uint32_t inode_num;
+	uint32_t length;
+	uint32_t num_blocks;
+} ece391_stat_t;
+
+/* Submission and completion ring operations */
+enum io_ops {
+	IO_OP_READ = 0,
+	IO_OP_WRITE
+};
+
+/* Offset for reading or writing wherever the file is, like read and write.
+ * Any other offset works like pread and pwrite: the file's position is
+ * left alone, and the result is -1 unless the fd is a file or a device. */
+#define IO_OFFSET_CURRENT 0xFFFFFFFF
+/* Most entries a ring can have, the count must be a power of two */
+#define IO_MAX_ENTRIES 256
+
+/* A queued read or write, same meaning as the read and write arguments */
+typedef struct ece391_io_sqe {
+	uint32_t opcode;
+	int32_t fd;
+	void* buf;
+	int32_t nbytes;
+	uint32_t offset;
+	uint32_t user_data;
+} ece391_io_sqe_t;
+
+/* The result of one, what read or write would have returned */
+typedef struct ece391_io_cqe {
+	uint32_t user_data;
+	int32_t result;
+} ece391_io_cqe_t;
+
+/*
+ * The ring shared with the kernel.  Heads and tails count up forever and
+ * index the arrays modulo entries.  Fill sqes and advance sq_tail to
+ * queue; the kernel advances sq_head as it takes them and cq_tail as it
+ * adds completions; advance cq_head after reading them.
+ */
+typedef struct ece391_io_ring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	uint32_t entries;
+	ece391_io_sqe_t* sqes;
+	ece391_io_cqe_t* cqes;
+} ece391_io_ring_t;
+
 /*  
  * Note that the system call for halt will have to make sure that only
  * the low byte of EBX (the status argument) is returned to the calling
  * task.  Negative returns from execute indicate that the desired program
- * could not be found.
+ * could not be found.  ece391_halt writes out any ece391_printf output
+ * still buffered first, and returning from main halts through it.
  */ 
 extern int32_t ece391_halt (uint8_t status);
 extern int32_t ece391_execute (const uint8_t* command);
@@ -21,6 +85,90 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_stat (const uint8_t* filename, ece391_stat_t* buf);
+extern int32_t ece391_fstat (int32_t fd, ece391_stat_t* buf);
+
+/* Only files under "tmp/" can be created, written, truncated and unlinked */
+extern int32_t ece391_create (const uint8_t* filename);
+extern int32_t ece391_unlink (const uint8_t* filename);
+extern int32_t ece391_truncate (const uint8_t* filename, uint32_t length);
+
+/*
+ * io_setup registers a ring (NULL drops it); io_enter takes whatever is
+ * queued, then waits until min_complete completions are ready or nothing
+ * more can finish, and returns how many submissions it took.  Reads
+ * that would wait, on the RTC, a terminal or an empty pipe, do not hold
+ * up the rest of the queue.
+ */
+extern int32_t ece391_io_setup (ece391_io_ring_t* ring);
+extern int32_t ece391_io_enter (uint32_t min_complete);
+
+/*
+ * pipe puts a read end in fds[0] and a write end in fds[1].  Reading an
+ * empty pipe and writing a full one wait for the other stages of the
+ * pipeline; execute runs "a | b" as a pipeline with a's output going to
+ * b's input.  A read returns 0 once every write end is closed.
+ */
+extern int32_t ece391_pipe (int32_t* fds);
+
+/*
+ * sendfile copies up to count bytes from in_fd to out_fd without passing
+ * them through the caller, returning how many went (0 at end of file).
+ * With offset NULL it reads from in_fd's position and moves it; otherwise
+ * it starts at *offset, leaves the position alone and updates *offset.
+ */
+extern int32_t ece391_sendfile (int32_t out_fd, int32_t in_fd, uint32_t* offset,
+				int32_t count);
+
+/*
+ * open, dup and pipe hand out the lowest free fds, and a process can have
+ * up to 256 of them.  dup gives another fd for the same open file, sharing
+ * its position; dup2 makes new_fd one, closing what it had first.  A
+ * program starts with its parent's stdin and stdout when the parent
+ * pointed them away from the terminal.  The terminal's last fd cannot be
+ * closed, but dup2 can replace it.
+ */
+extern int32_t ece391_dup (int32_t fd);
+extern int32_t ece391_dup2 (int32_t fd, int32_t new_fd);
+
+/*
+ * Reading the terminal returns a line once enter is pressed, '\n'
+ * included; lines typed before anyone reads wait their turn.  ioctl
+ * changes that for stdin.  IOCTL_NONBLOCK with arg 1 makes reads return
+ * 0 when nothing has been typed instead of waiting (dev/ttyS0 too).
+ * IOCTL_RAW with arg 1 hands over each key as it is pressed, without
+ * echo: enter as '\n', backspace as '\b', ctrl+letter as its control
+ * character and arrows as ESC [ A to ESC [ D.  Raw mode ends when the
+ * program sets it back or halts.
+ */
+#define IOCTL_NONBLOCK 1
+#define IOCTL_RAW      2
+extern int32_t ece391_ioctl (int32_t fd, uint32_t request, uint32_t arg);
+
+/*
+ * poll fills in revents for each fd with the events asked for that hold
+ * now, plus POLLERR, POLLHUP (a pipe's other end is closed) and POLLNVAL
+ * (the fd is not open) whether asked for or not; negative fds are
+ * skipped.  If none is ready it waits up to timeout milliseconds (-1
+ * forever, 0 not at all) for the first one to be.  Returns how many fds
+ * have revents set, 0 on timeout.  POLLIN means a read would not wait:
+ * the RTC has ticked, a line was typed, a pipe has data.
+ */
+#define ECE391_POLLIN   0x0001
+#define ECE391_POLLOUT  0x0004
+#define ECE391_POLLERR  0x0008
+#define ECE391_POLLHUP  0x0010
+#define ECE391_POLLNVAL 0x0020
+/* Most fds one call watches */
+#define ECE391_POLL_MAX 32
+
+typedef struct ece391_pollfd {
+	int32_t fd;
+	int16_t events;
+	int16_t revents;
+} ece391_pollfd_t;
+
+extern int32_t ece391_poll (ece391_pollfd_t* fds, uint32_t nfds, int32_t timeout);
 
 enum signums {
 	DIV_ZERO = 0,
@@ -91,29 +91,31 @@ int err_big_fd(void) {
 
 
 /* TEST 3 err_open_lots
- * calls open correctly seven times
+ * calls open correctly until it fails
  * prints "[TEST_NAME]: PASS" if behavior is EXPECTED
  *     and then returns 0
  * prints "[TEST_NAME]: FAIL" if behavior is UNEXPECTED
  *     and then returns 2
  */
 int err_open_lots(void) {
-    int32_t i, cnt = 0;
+    int32_t fds[300];
+    int32_t i, opened = 0;
 	
-	// fd = 0,1 taken, so we should be able to open 6 files (2,3,4,5,6,7)
-	// the last file open should fail
-    for (i = 0; i < 7; i++) {
-	    if (-1 == ece391_open ((uint8_t*)".")) {
-			cnt++;
+	// the fd table grows past the first 8 slots, so far more than 6
+	// files open, but running out of fds or open files must still fail
+    for (i = 0; i < 300; i++) {
+	    if (-1 == (fds[opened] = ece391_open ((uint8_t*)"."))) {
+			break;
         }
+		opened++;
     }
     //close all fds that were just opened.
-    for(i = 2; i < 8; i++)
+    for(i = 0; i < opened; i++)
     {
-    	ece391_close(i);
+    	ece391_close(fds[i]);
     }
     
-	if (cnt == 1) {
+	if (opened > 6 && opened < 300) {
 		ece391_fdputs(1, (uint8_t*)"err_open_lots: PASS\n");
 		return 0;
 	} else {
@@ -11,5 +11,18 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_STAT    11
+#define SYS_FSTAT   12
+#define SYS_CREATE  13
+#define SYS_UNLINK  14
+#define SYS_TRUNCATE 15
+#define SYS_IO_SETUP 16
+#define SYS_IO_ENTER 17
+#define SYS_PIPE    18
+#define SYS_SENDFILE 19
+#define SYS_DUP     20
+#define SYS_DUP2    21
+#define SYS_IOCTL   22
+#define SYS_POLL    23
 
 #endif /* ECE391SYSNUM_H */